@@ -4,7 +4,7 @@
 #
 #-------------------------------------------------
 
-QT       += core gui widgets
+QT       += core gui widgets network
 
 TARGET = SIMMProgrammer
 TEMPLATE = app
@@ -12,32 +12,79 @@ QMAKE_TARGET_BUNDLE_PREFIX = com.downtowndougbrown
 
 SOURCES += main.cpp\
     3rdparty/fc8-compression.c \
+    appdatapath.cpp \
+    batchprogrammer.cpp \
     chipid.cpp \
+    compressionservice.cpp \
     createblankdiskdialog.cpp \
     droppablegroupbox.cpp \
+    fc8blocksizeselector.cpp \
     fc8compressor.cpp \
+    fc8decoder.cpp \
+    fc8incrementalcompressor.cpp \
+    fc8optimalencoder.cpp \
+    fc8sizeestimator.cpp \
+    firmwarebundle.cpp \
+    jobrunner.cpp \
     labelwithlinks.cpp \
     mainwindow.cpp \
+    pipelinedrombuilder.cpp \
     programmer.cpp \
+    programmerdaemon.cpp \
+    programmertransport.cpp \
+    qextserialtransport.cpp \
     aboutbox.cpp \
-    textbrowserwithlinks.cpp
+    rombuilder.cpp \
+    romwatcher.cpp \
+    romchecksum.cpp \
+    sectorindex.cpp \
+    simmtable.cpp \
+    textbrowserwithlinks.cpp \
+    writejournal.cpp
 
 HEADERS  += mainwindow.h \
     3rdparty/fc8-compression/fc8.h \
+    appdatapath.h \
+    batchprogrammer.h \
+    bigendian.h \
     chipid.h \
+    compressionservice.h \
     createblankdiskdialog.h \
     droppablegroupbox.h \
+    fc8blocksizeselector.h \
     fc8compressor.h \
+    fc8decoder.h \
+    fc8incrementalcompressor.h \
+    fc8optimalencoder.h \
+    fc8sizeestimator.h \
+    fc8tokens.h \
+    firmwarebundle.h \
+    jobrunner.h \
     labelwithlinks.h \
+    pipelinedrombuilder.h \
     programmer.h \
+    programmerdaemon.h \
+    programmertransport.h \
+    qextserialtransport.h \
     aboutbox.h \
-    textbrowserwithlinks.h
+    rombuilder.h \
+    romwatcher.h \
+    romchecksum.h \
+    sectorindex.h \
+    simmtable.h \
+    textbrowserwithlinks.h \
+    writejournal.h
 
 FORMS    += mainwindow.ui \
     aboutbox.ui \
     createblankdiskdialog.ui
 
 linux*:CONFIG += qesp_linux_udev
+linux* {
+    # Native tty transport with low latency tuning
+    SOURCES += linuxserialtransport.cpp
+    HEADERS += linuxserialtransport.h
+}
 include(3rdparty/qextserialport/src/qextserialport.pri)
 
 QMAKE_CXXFLAGS_RELEASE += -DQT_NO_DEBUG_OUTPUT
@@ -68,7 +115,19 @@ win32:QMAKE_TARGET_COPYRIGHT = "Copyright (C) Doug Brown"
 win32:QMAKE_TARGET_PRODUCT = "Mac ROM SIMM Programmer"
 
 DISTFILES += \
-    chipid.txt
+    chipid.txt \
+    tools/chipid_gen.py
 
-RESOURCES += \
-    chipid.qrc
+# The chip database is converted into a table that gets compiled in directly
+isEmpty(PYTHON) {
+    win32:PYTHON = python
+    else:PYTHON = python3
+}
+CHIPID_DATABASES = chipid.txt
+chipid_table.input = CHIPID_DATABASES
+chipid_table.output = chipid_table.h
+chipid_table.commands = $$PYTHON $$PWD/tools/chipid_gen.py ${QMAKE_FILE_IN} ${QMAKE_FILE_OUT}
+chipid_table.depends = $$PWD/tools/chipid_gen.py
+chipid_table.CONFIG += no_link target_predeps
+chipid_table.variable_out = GENERATED_FILES
+QMAKE_EXTRA_COMPILERS += chipid_table
@@ -0,0 +1,24 @@
+#include "appdatapath.h"
+#include <QDir>
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 0, 0))
+#include <QStandardPaths>
+#else
+#include <QDesktopServices>
+#endif
+
+QString appDataFilePath(QString const &fileName)
+{
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 0, 0))
+    QString dirPath = QStandardPaths::writableLocation(QStandardPaths::DataLocation);
+#else
+    QString dirPath = QDesktopServices::storageLocation(QDesktopServices::DataLocation);
+#endif
+
+    QDir dir(dirPath);
+    if (!dir.exists())
+    {
+        dir.mkpath(".");
+    }
+
+    return dir.filePath(fileName);
+}
@@ -0,0 +1,10 @@
+#ifndef APPDATAPATH_H
+#define APPDATAPATH_H
+
+#include <QString>
+
+// Returns the full path of a file in the per-user application data directory,
+// creating the directory if it doesn't exist yet.
+QString appDataFilePath(QString const &fileName);
+
+#endif // APPDATAPATH_H
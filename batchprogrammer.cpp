@@ -0,0 +1,201 @@
+#include "batchprogrammer.h"
+
+// How long to wait between checks for a SIMM. An identification only takes
+// a few milliseconds with the port already open, so this is most of the
+// time it takes to notice a SIMM.
+#define POLL_INTERVAL_MS        250
+
+// A SIMM has to look the same this many times in a row before we believe
+// it, so we don't start programming one that's only halfway in
+#define POLLS_TO_CONFIRM        2
+
+BatchProgrammer::BatchProgrammer(JobRunner *runner, QObject *parent) :
+    QObject(parent),
+    runner(runner),
+    _state(Stopped),
+    pollJobID(-1),
+    unitSequenceID(-1),
+    matchingPolls(0),
+    previousSessionMode(false),
+    previousIdentificationProbe(true),
+    _unitsPassed(0),
+    _unitsFailed(0)
+{
+    pollTimer.setSingleShot(true);
+    pollTimer.setInterval(POLL_INTERVAL_MS);
+    connect(&pollTimer, SIGNAL(timeout()), SLOT(poll()));
+    connect(runner, SIGNAL(jobFinished(int,bool,QString,QByteArray)), SLOT(jobFinished(int,bool,QString,QByteArray)));
+    connect(runner, SIGNAL(sequenceFinished(int,bool,QString)), SLOT(sequenceFinished(int,bool,QString)));
+}
+
+void BatchProgrammer::start(QList<ProgrammerJob> const &jobs)
+{
+    unitJobs = jobs;
+    matchingPolls = 0;
+
+    // Checking for a SIMM is quick, as long as we don't have to open the
+    // port and check the board's state every single time. If it's still
+    // finishing up from before, it's the same run, so the counts stay.
+    if (_state == Stopped)
+    {
+        previousSessionMode = runner->programmer()->sessionMode();
+        _unitsPassed = 0;
+        _unitsFailed = 0;
+    }
+    runner->programmer()->setSessionMode(true);
+
+    // Started again before the last SIMM was done. It can just carry on.
+    if (_state == Stopping)
+    {
+        setState(Programming);
+        return;
+    }
+
+    // If there's already a SIMM in there, it needs to come out first. We
+    // don't know if it's one we already did.
+    setState(WaitingForRemoval);
+    poll();
+}
+
+void BatchProgrammer::stop()
+{
+    pollTimer.stop();
+    if (pollJobID >= 0)
+    {
+        runner->cancel(pollJobID);
+    }
+    pollJobID = -1;
+
+    // Let the SIMM being programmed finish. When its sequence is done, the
+    // job runner restores the session mode it started with, which is ours,
+    // so the user's own setting can only be put back after that.
+    if (unitSequenceID >= 0)
+    {
+        setState(Stopping);
+        return;
+    }
+
+    if (_state != Stopped)
+    {
+        runner->programmer()->setSessionMode(previousSessionMode);
+    }
+    setState(Stopped);
+}
+
+void BatchProgrammer::poll()
+{
+    if (_state != WaitingForInsertion && _state != WaitingForRemoval)
+    {
+        return;
+    }
+
+    ProgrammerJob identify;
+    identify.type = ProgrammerJob::Identify;
+    pollJobID = runner->enqueue(identify);
+}
+
+void BatchProgrammer::jobFinished(int id, bool success, QString message, QByteArray data)
+{
+    Q_UNUSED(message);
+    if (id != pollJobID)
+    {
+        return;
+    }
+    pollJobID = -1;
+
+    // If the identification itself failed, act like nothing is there
+    const bool present = success && simmPresent(data);
+    if ((_state == WaitingForInsertion && present) ||
+        (_state == WaitingForRemoval && !present))
+    {
+        matchingPolls++;
+    }
+    else
+    {
+        matchingPolls = 0;
+    }
+
+    if (matchingPolls >= POLLS_TO_CONFIRM)
+    {
+        matchingPolls = 0;
+        if (_state == WaitingForInsertion)
+        {
+            // The polls that found this SIMM just identified it, so the
+            // write can go by that instead of checking all over again
+            previousIdentificationProbe = runner->programmer()->identificationProbe();
+            runner->programmer()->setIdentificationProbe(false);
+            setState(Programming);
+            unitSequenceID = runner->enqueueSequence(unitJobs);
+            return;
+        }
+        else
+        {
+            // Whatever was identified belonged to the SIMM that just came
+            // out. The next one could be the same kind without being the
+            // same SIMM.
+            runner->programmer()->invalidateIdentification();
+            setState(WaitingForInsertion);
+        }
+    }
+
+    if (_state == WaitingForInsertion || _state == WaitingForRemoval)
+    {
+        pollTimer.start();
+    }
+}
+
+void BatchProgrammer::sequenceFinished(int sequenceID, bool success, QString report)
+{
+    if (sequenceID != unitSequenceID)
+    {
+        return;
+    }
+    unitSequenceID = -1;
+    runner->programmer()->setIdentificationProbe(previousIdentificationProbe);
+
+    if (success)
+    {
+        _unitsPassed++;
+    }
+    else
+    {
+        _unitsFailed++;
+    }
+    emit unitFinished(_unitsPassed + _unitsFailed, success, report);
+
+    if (_state == Stopping)
+    {
+        stop();
+        return;
+    }
+
+    setState(WaitingForRemoval);
+    pollTimer.start();
+}
+
+void BatchProgrammer::setState(State state)
+{
+    if (state != _state)
+    {
+        _state = state;
+        emit stateChanged(_state);
+    }
+}
+
+// Chips that are actually there answer with a real manufacturer ID. With no
+// SIMM, the data bus just floats (or is pulled) to all 0s or all 1s.
+bool BatchProgrammer::simmPresent(QByteArray const &ids)
+{
+    // Four bytes per chip: straight manufacturer and device, then shifted
+    for (int i = 0; i + 3 < ids.size(); i += 4)
+    {
+        const uint8_t manufacturerStraight = static_cast<uint8_t>(ids.at(i));
+        const uint8_t manufacturerShifted = static_cast<uint8_t>(ids.at(i + 2));
+        if ((manufacturerStraight != 0x00 && manufacturerStraight != 0xFF) ||
+            (manufacturerShifted != 0x00 && manufacturerShifted != 0xFF))
+        {
+            return true;
+        }
+    }
+    return false;
+}
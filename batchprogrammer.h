@@ -0,0 +1,67 @@
+#ifndef BATCHPROGRAMMER_H
+#define BATCHPROGRAMMER_H
+
+#include <QObject>
+#include <QList>
+#include <QTimer>
+#include "jobrunner.h"
+
+// Programs SIMM after SIMM without anyone clicking anything. It keeps asking
+// the chips to identify themselves until a SIMM shows up, runs the jobs on
+// it, and then waits for it to be pulled out before doing it all again.
+class BatchProgrammer : public QObject
+{
+    Q_OBJECT
+public:
+    enum State
+    {
+        Stopped,
+        WaitingForInsertion,
+        Programming,
+        WaitingForRemoval,
+        // Told to stop partway through a SIMM; that SIMM gets finished first
+        Stopping
+    };
+
+    explicit BatchProgrammer(JobRunner *runner, QObject *parent = 0);
+
+    // The jobs to run on each SIMM. Any image data in them is shared with
+    // every unit, not copied or reloaded.
+    void start(QList<ProgrammerJob> const &jobs);
+    // Stops right away, unless a SIMM is being programmed. Stopping in the
+    // middle of an erase or write would leave it half done, so that one
+    // finishes before it's really stopped.
+    void stop();
+
+    State state() const { return _state; }
+    bool isActive() const { return _state != Stopped; }
+    int unitsPassed() const { return _unitsPassed; }
+    int unitsFailed() const { return _unitsFailed; }
+
+signals:
+    void stateChanged(BatchProgrammer::State state);
+    void unitFinished(int unitNumber, bool success, QString report);
+
+private slots:
+    void poll();
+    void jobFinished(int id, bool success, QString message, QByteArray data);
+    void sequenceFinished(int sequenceID, bool success, QString report);
+
+private:
+    void setState(State state);
+    static bool simmPresent(QByteArray const &ids);
+
+    JobRunner *runner;
+    QList<ProgrammerJob> unitJobs;
+    QTimer pollTimer;
+    State _state;
+    int pollJobID;
+    int unitSequenceID;
+    int matchingPolls;
+    bool previousSessionMode;
+    bool previousIdentificationProbe;
+    int _unitsPassed;
+    int _unitsFailed;
+};
+
+#endif // BATCHPROGRAMMER_H
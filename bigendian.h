@@ -0,0 +1,25 @@
+#ifndef BIGENDIAN_H
+#define BIGENDIAN_H
+
+#include <stdint.h>
+
+// The 68k is big-endian, so everything that ends up in a ROM or a compressed
+// disk image is stored that way
+
+static inline void putBE32(char *p, uint32_t value)
+{
+    p[0] = (value >> 24) & 0xFF;
+    p[1] = (value >> 16) & 0xFF;
+    p[2] = (value >> 8) & 0xFF;
+    p[3] = (value >> 0) & 0xFF;
+}
+
+static inline uint32_t readBE32(const uint8_t *p)
+{
+    return static_cast<uint32_t>(p[0]) << 24 |
+           static_cast<uint32_t>(p[1]) << 16 |
+           static_cast<uint32_t>(p[2]) << 8 |
+           static_cast<uint32_t>(p[3]) << 0;
+}
+
+#endif // BIGENDIAN_H
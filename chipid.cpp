@@ -1,7 +1,9 @@
 #include "chipid.h"
+#include "appdatapath.h"
 #include <QFile>
 #include <QRegExp>
 #include <QStringList>
+#include <algorithm>
 
 #if (QT_VERSION >= QT_VERSION_CHECK(5, 0, 0))
 #define MySkipEmptyParts Qt::SkipEmptyParts
@@ -9,13 +11,47 @@
 #define MySkipEmptyParts QString::SkipEmptyParts
 #endif
 
-ChipID::ChipID(QString filePath, QObject *parent) : QObject(parent)
+// Layout of the built-in chip table generated from chipid.txt at build time
+struct ChipSectorRun
 {
-    QFile f(filePath);
-    if (f.open(QFile::ReadOnly))
+    uint16_t count;
+    uint32_t size;
+};
+
+struct BuiltinChip
+{
+    uint16_t manufacturerID;
+    uint16_t productID;
+    uint8_t width;
+    bool unlockShifted;
+    const char *manufacturer;
+    const char *product;
+    uint32_t capacity;
+    uint16_t firstSectorRun;
+    uint16_t numSectorRuns;
+};
+
+#include "chipid_table.h"
+
+// Sort order of the built-in table, which the generator guarantees
+static bool builtinChipLessThan(BuiltinChip const &a, BuiltinChip const &b)
+{
+    if (a.manufacturerID != b.manufacturerID) { return a.manufacturerID < b.manufacturerID; }
+    if (a.productID != b.productID) { return a.productID < b.productID; }
+    if (a.width != b.width) { return a.width < b.width; }
+    return a.unlockShifted < b.unlockShifted;
+}
+
+ChipID::ChipID(QString overlayFilePath, QObject *parent) : QObject(parent)
+{
+    if (!overlayFilePath.isEmpty())
     {
-        loadChips(f);
-        f.close();
+        QFile f(overlayFilePath);
+        if (f.open(QFile::ReadOnly))
+        {
+            loadChips(f);
+            f.close();
+        }
     }
 
     dummyChipInfo.manufacturer = "Unknown";
@@ -61,44 +97,23 @@ bool ChipID::findChips(QList<uint8_t> manufacturersStraight, QList<uint8_t> devi
             chipInfo16Bit[i] = NULL;
         }
 
-        foreach (ChipInfo const &ci, allChips)
+        ChipInfo found16Bit[2];
+        for (int i = 0; i < 2; i++)
         {
-            // Only look for 16-bit chips that match the shift type we're currently looking at
-            if (ci.width != 16 || ci.unlockShifted != shifted) { continue; }
-
-            for (int i = 0; i < 2; i++)
+            if (lookupChip(manufacturers16Bit[i], devices16Bit[i], 16, shifted, found16Bit[i]))
             {
-                // If we already found a match for this chip, skip it
-                if (chipInfo16Bit[i]) { continue; }
-
-                if (ci.manufacturerID == manufacturers16Bit[i] &&
-                    ci.productID == devices16Bit[i])
-                {
-                    chipInfo16Bit[i] = &ci;
-                }
+                chipInfo16Bit[i] = &found16Bit[i];
             }
         }
 
         // Now let's try a 4-chip SIMM
+        ChipInfo found8Bit[4];
         for (int i = 0; i < 4; i++)
         {
             chipInfo8Bit[i] = NULL;
-        }
-
-        foreach (ChipInfo const &ci, allChips)
-        {
-            if (ci.width != 8 || ci.unlockShifted != shifted) { continue; }
-
-            for (int i = 0; i < 4; i++)
+            if (lookupChip(manufacturers[i], devices[i], 8, shifted, found8Bit[i]))
             {
-                // If we already found a match for this chip, skip it
-                if (chipInfo8Bit[i]) { continue; }
-
-                if (ci.manufacturerID == manufacturers[i] &&
-                    ci.productID == devices[i])
-                {
-                    chipInfo8Bit[i] = &ci;
-                }
+                chipInfo8Bit[i] = &found8Bit[i];
             }
         }
 
@@ -163,6 +178,61 @@ bool ChipID::findChips(QList<uint8_t> manufacturersStraight, QList<uint8_t> devi
     return false;
 }
 
+bool ChipID::lookupChip(uint16_t manufacturerID, uint16_t productID, uint8_t width, bool unlockShifted, ChipInfo &info) const
+{
+    // User-supplied chips take priority over the built-in ones
+    QHash<quint64, ChipInfo>::const_iterator overlayIt =
+            overlayChips.constFind(chipKey(manufacturerID, productID, width, unlockShifted));
+    if (overlayIt != overlayChips.constEnd())
+    {
+        info = overlayIt.value();
+        return true;
+    }
+
+    BuiltinChip key;
+    key.manufacturerID = manufacturerID;
+    key.productID = productID;
+    key.width = width;
+    key.unlockShifted = unlockShifted;
+
+    const BuiltinChip *begin = builtinChips;
+    const BuiltinChip *end = builtinChips + sizeof(builtinChips) / sizeof(builtinChips[0]);
+    const BuiltinChip *chip = std::lower_bound(begin, end, key, builtinChipLessThan);
+    if (chip == end || builtinChipLessThan(key, *chip))
+    {
+        return false;
+    }
+
+    info.manufacturer = QString::fromLatin1(chip->manufacturer);
+    info.manufacturerID = chip->manufacturerID;
+    info.product = QString::fromLatin1(chip->product);
+    info.productID = chip->productID;
+    info.width = chip->width;
+    info.capacity = chip->capacity;
+    info.unlockShifted = chip->unlockShifted;
+    info.sectors.clear();
+    for (int i = 0; i < chip->numSectorRuns; i++)
+    {
+        ChipSectorRun const &run = builtinSectorRuns[chip->firstSectorRun + i];
+        info.sectors << qMakePair(run.count, run.size);
+    }
+
+    return true;
+}
+
+QString ChipID::defaultOverlayFilePath()
+{
+    return appDataFilePath("chipid.txt");
+}
+
+quint64 ChipID::chipKey(uint16_t manufacturerID, uint16_t productID, uint8_t width, bool unlockShifted)
+{
+    return (static_cast<quint64>(manufacturerID) << 32) |
+           (static_cast<quint64>(productID) << 16) |
+           (static_cast<quint64>(width) << 8) |
+           (unlockShifted ? 1 : 0);
+}
+
 void ChipID::loadChips(QIODevice &file)
 {
     QRegExp whitespace("\\s+");
@@ -235,7 +305,7 @@ void ChipID::loadChips(QIODevice &file)
         info.manufacturerID = components[5].toUInt(NULL, 16);
         info.productID = components[6].toUInt(NULL, 16);
         info.unlockShifted = components[7].toUpper() == "YES";
-        allChips.append(info);
+        overlayChips.insert(chipKey(info.manufacturerID, info.productID, info.width, info.unlockShifted), info);
     }
 }
 
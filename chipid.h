@@ -4,6 +4,7 @@
 #include <QObject>
 #include <QIODevice>
 #include <QPair>
+#include <QHash>
 #include <stdint.h>
 
 class ChipID : public QObject
@@ -23,16 +24,22 @@ public:
         bool unlockShifted;
     };
 
-    explicit ChipID(QString filePath, QObject *parent = NULL);
+    // The chip database is built into the program. The optional overlay file
+    // uses the same format as chipid.txt and can add or override chips.
+    explicit ChipID(QString overlayFilePath = QString(), QObject *parent = NULL);
 
     bool findChips(QList<uint8_t> manufacturersStraight, QList<uint8_t> devicesStraight, QList<uint8_t> manufacturersShifted, QList<uint8_t> devicesShifted, QList<ChipInfo> &info);
+    bool lookupChip(uint16_t manufacturerID, uint16_t productID, uint8_t width, bool unlockShifted, ChipInfo &info) const;
+
+    static QString defaultOverlayFilePath();
 
 private:
     void loadChips(QIODevice &file);
     static uint32_t decodeSectorSize(QString sizeString);
+    static quint64 chipKey(uint16_t manufacturerID, uint16_t productID, uint8_t width, bool unlockShifted);
 
     ChipInfo dummyChipInfo;
-    QList<ChipInfo> allChips;
+    QHash<quint64, ChipInfo> overlayChips;
 };
 
 #endif // CHIPID_H
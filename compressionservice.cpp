@@ -0,0 +1,188 @@
+#include "compressionservice.h"
+#include "fc8blocksizeselector.h"
+#include <QEventLoop>
+#include <QThread>
+
+// How many finished jobs to hang on to, so flipping a setting back and forth
+// doesn't mean compressing the same image over again
+#define MAX_FINISHED_JOBS   2
+
+CompressionJob::CompressionJob(const QByteArray &key, const QByteArray &hashOfOriginal, QObject *parent) :
+    QObject(parent),
+    _key(key),
+    _hashOfOriginal(hashOfOriginal),
+    _worker(NULL),
+    _workerDone(false),
+    _finished(false),
+    _cancelled(false),
+    _progressValue(0),
+    _progressMaximum(0)
+{
+
+}
+
+void CompressionJob::start(QObject *worker)
+{
+    // Set up a thread to do the compression in the background. It can take a few seconds.
+    QThread *thread = new QThread();
+    _worker = worker;
+    worker->moveToThread(thread);
+
+    connect(worker, SIGNAL(compressionFinished(QByteArray,QByteArray)), this, SLOT(workerFinished(QByteArray,QByteArray)));
+    if (qobject_cast<FC8Compressor *>(worker))
+    {
+        connect(worker, SIGNAL(progressChanged(int,int)), this, SLOT(workerProgressChanged(int,int)));
+    }
+    else
+    {
+        connect(worker, SIGNAL(candidatesEvaluated(QString)), this, SLOT(workerCandidatesEvaluated(QString)));
+    }
+    // The worker gets deleted once we've heard back from it. When that
+    // happens, stop the thread, which then deletes itself.
+    connect(worker, SIGNAL(destroyed()), thread, SLOT(quit()));
+    connect(thread, SIGNAL(started()), worker, SLOT(doCompression()));
+    connect(thread, SIGNAL(finished()), thread, SLOT(deleteLater()));
+
+    thread->start();
+}
+
+void CompressionJob::cancel()
+{
+    if (_finished)
+    {
+        return;
+    }
+
+    FC8Compressor *compressor = qobject_cast<FC8Compressor *>(_worker);
+    FC8BlockSizeSelector *selector = qobject_cast<FC8BlockSizeSelector *>(_worker);
+    if (compressor)
+    {
+        compressor->cancel();
+    }
+    else if (selector)
+    {
+        selector->cancel();
+    }
+
+    _cancelled = true;
+    _finished = true;
+    emit finished();
+}
+
+void CompressionJob::waitForFinished()
+{
+    if (_finished)
+    {
+        return;
+    }
+
+    QEventLoop loop;
+    connect(this, SIGNAL(finished()), &loop, SLOT(quit()));
+    loop.exec();
+}
+
+void CompressionJob::workerProgressChanged(int value, int maximum)
+{
+    if (_finished)
+    {
+        return;
+    }
+
+    _progressValue = value;
+    _progressMaximum = maximum;
+    emit progressChanged(value, maximum);
+}
+
+void CompressionJob::workerCandidatesEvaluated(QString summary)
+{
+    _candidatesSummary = summary;
+}
+
+void CompressionJob::workerFinished(QByteArray hashOfOriginal, QByteArray compressedData)
+{
+    // We already know the hash; it was the key
+    Q_UNUSED(hashOfOriginal);
+
+    _worker->deleteLater();
+    _worker = NULL;
+    _workerDone = true;
+
+    // If it was cancelled, everyone has already been told
+    if (_finished)
+    {
+        return;
+    }
+
+    _result = compressedData;
+    _finished = true;
+    emit finished();
+}
+
+CompressionService::CompressionService(QObject *parent) :
+    QObject(parent)
+{
+
+}
+
+CompressionJob *CompressionService::compress(const QByteArray &data, int blockSize, FC8Compressor::Mode mode,
+                                             qint64 availableSpace, const QByteArray &hashOfData)
+{
+    // The input never gets hashed more than this once
+    const QByteArray hash = hashOfData.isEmpty() ? FC8Compressor::hashOf(data) : hashOfData;
+    QByteArray key = hash;
+    key += ":" + QByteArray::number(blockSize) + ":" + QByteArray::number(static_cast<int>(mode));
+    if (blockSize == AutomaticBlockSize)
+    {
+        // Which candidate wins depends on how much room there is
+        key += ":" + QByteArray::number(availableSpace);
+    }
+
+    foreach (CompressionJob *job, _jobs)
+    {
+        // Failed and cancelled ones get another try
+        if (job->key() == key && !job->isCancelled() &&
+            (!job->isFinished() || job->succeeded()))
+        {
+            return job;
+        }
+    }
+
+    pruneFinishedJobs();
+
+    QObject *worker;
+    if (blockSize == AutomaticBlockSize)
+    {
+        worker = new FC8BlockSizeSelector(data, mode, availableSpace, FC8BlockSizeSelector::FastestBoot);
+    }
+    else
+    {
+        worker = new FC8Compressor(data, blockSize, mode);
+    }
+
+    CompressionJob *job = new CompressionJob(key, hash, this);
+    _jobs.append(job);
+    job->start(worker);
+    return job;
+}
+
+void CompressionService::pruneFinishedJobs()
+{
+    // Keep the newest few that worked. Anything with a worker still running
+    // has to stay until it reports back, or nothing would clean up after it.
+    int kept = 0;
+    for (int i = _jobs.count() - 1; i >= 0; i--)
+    {
+        CompressionJob *job = _jobs.at(i);
+        if (!job->isFinished() || !job->_workerDone)
+        {
+            continue;
+        }
+        if (job->succeeded() && kept < MAX_FINISHED_JOBS)
+        {
+            kept++;
+            continue;
+        }
+        _jobs.removeAt(i);
+        job->deleteLater();
+    }
+}
@@ -0,0 +1,97 @@
+#ifndef COMPRESSIONSERVICE_H
+#define COMPRESSIONSERVICE_H
+
+#include <QObject>
+#include <QList>
+#include "fc8compressor.h"
+
+class CompressionService;
+
+// A handle to a disk image compression running in the background, a bit like
+// a QFuture. Jobs belong to the CompressionService that started them and may
+// be shared by several callers that asked for the same thing, so hold on to
+// them with a QPointer.
+class CompressionJob : public QObject
+{
+    Q_OBJECT
+public:
+    // Identifies the input and the settings it's being compressed with
+    QByteArray key() const { return _key; }
+    QByteArray hashOfOriginal() const { return _hashOfOriginal; }
+
+    bool isFinished() const { return _finished; }
+    bool isCancelled() const { return _cancelled; }
+    // Finished, not cancelled, and the compression worked
+    bool succeeded() const { return _finished && !_cancelled && !_result.isEmpty(); }
+    QByteArray result() const { return _result; }
+    // Filled in when the block size is picked automatically
+    QString candidatesSummary() const { return _candidatesSummary; }
+
+    // The maximum is 0 until the first progress report comes in
+    int progressValue() const { return _progressValue; }
+    int progressMaximum() const { return _progressMaximum; }
+
+    // Cancels it for everyone sharing the job. finished() is sent right away;
+    // the worker thread winds down on its own.
+    void cancel();
+
+    // Runs an event loop until the job is finished. Sleeps while waiting
+    // rather than polling.
+    void waitForFinished();
+
+signals:
+    void progressChanged(int value, int maximum);
+    void finished();
+
+private slots:
+    void workerProgressChanged(int value, int maximum);
+    void workerCandidatesEvaluated(QString summary);
+    void workerFinished(QByteArray hashOfOriginal, QByteArray compressedData);
+
+private:
+    friend class CompressionService;
+    CompressionJob(QByteArray const &key, QByteArray const &hashOfOriginal, QObject *parent);
+    void start(QObject *worker);
+
+    QByteArray _key;
+    QByteArray _hashOfOriginal;
+    // Lives in the worker thread; only cancel() is called on it from here.
+    // It stays around until it reports back, even if the job was cancelled.
+    QObject *_worker;
+    bool _workerDone;
+    bool _finished;
+    bool _cancelled;
+    QByteArray _result;
+    QString _candidatesSummary;
+    int _progressValue;
+    int _progressMaximum;
+};
+
+// Hands out compression jobs. The input is hashed once when it's requested;
+// asking again for the same input and settings while it's still compressing
+// (or shortly after) gives back the same job instead of starting another.
+class CompressionService : public QObject
+{
+    Q_OBJECT
+public:
+    enum
+    {
+        // Try each of FC8BlockSizeSelector's candidates
+        AutomaticBlockSize = -1
+    };
+
+    explicit CompressionService(QObject *parent = NULL);
+
+    // availableSpace is only used with AutomaticBlockSize. If the caller
+    // already has FC8Compressor::hashOf(data), passing it in saves hashing
+    // the data again.
+    CompressionJob *compress(QByteArray const &data, int blockSize, FC8Compressor::Mode mode,
+                             qint64 availableSpace = 0, QByteArray const &hashOfData = QByteArray());
+
+private:
+    void pruneFinishedJobs();
+
+    QList<CompressionJob *> _jobs;
+};
+
+#endif // COMPRESSIONSERVICE_H
@@ -0,0 +1,189 @@
+#include "fc8blocksizeselector.h"
+#include "fc8decoder.h"
+#include <QLocale>
+#include <QRunnable>
+#include <QStringList>
+#include <QThreadPool>
+
+namespace
+{
+// Compresses the image with one block size on a pool thread
+class CandidateCompression : public QRunnable
+{
+public:
+    CandidateCompression(QByteArray const &data, int blockSize, FC8Compressor::Mode mode) :
+        data(data),
+        blockSize(blockSize),
+        compressor(data, blockSize, mode),
+        blockDecodeMicroseconds(-1)
+    {
+        setAutoDelete(false);
+    }
+
+    void run()
+    {
+        result = compressor.compress();
+
+        QList<FC8Decoder::BlockStats> stats;
+        if (!result.isEmpty() && FC8Decoder::roundTrip(result, data, &stats) && !stats.isEmpty())
+        {
+            double total = 0;
+            foreach (FC8Decoder::BlockStats const &s, stats)
+            {
+                total += FC8Decoder::estimateMicroseconds(s, FC8Decoder::mc68030_16MHz);
+            }
+            blockDecodeMicroseconds = total / stats.count();
+        }
+    }
+
+    QByteArray data;
+    int blockSize;
+    FC8Compressor compressor;
+    QByteArray result;
+    double blockDecodeMicroseconds;
+};
+}
+
+FC8BlockSizeSelector::FC8BlockSizeSelector(const QByteArray &data, FC8Compressor::Mode mode,
+                                           qint64 availableSpace, Policy policy, QObject *parent) :
+    QObject(parent),
+    _data(data),
+    _mode(mode),
+    _availableSpace(availableSpace),
+    _policy(policy),
+    _cancelled(false)
+{
+
+}
+
+QList<int> FC8BlockSizeSelector::candidateBlockSizes()
+{
+    // Nothing bigger than the 64 KB the ROM creator has always used, since
+    // that's what the patched ROMs are known to handle
+    QList<int> sizes;
+    sizes << 16384 << 32768 << 65536;
+    return sizes;
+}
+
+void FC8BlockSizeSelector::cancel()
+{
+    QMutexLocker locker(&_cancelMutex);
+    _cancelled = true;
+    foreach (FC8Compressor *compressor, _running)
+    {
+        compressor->cancel();
+    }
+}
+
+void FC8BlockSizeSelector::doCompression()
+{
+    QThreadPool pool;
+    QList<CandidateCompression *> jobs;
+    {
+        QMutexLocker locker(&_cancelMutex);
+        foreach (int blockSize, candidateBlockSizes())
+        {
+            CandidateCompression *job = new CandidateCompression(_data, blockSize, _mode);
+            if (_cancelled)
+            {
+                job->compressor.cancel();
+            }
+            jobs.append(job);
+            _running.append(&job->compressor);
+            pool.start(job);
+        }
+    }
+    pool.waitForDone();
+
+    {
+        QMutexLocker locker(&_cancelMutex);
+        _running.clear();
+    }
+
+    QList<Candidate> candidates;
+    foreach (CandidateCompression *job, jobs)
+    {
+        // An empty result means that block size failed to encode
+        if (!job->result.isEmpty())
+        {
+            Candidate c;
+            c.blockSize = job->blockSize;
+            c.compressedData = job->result;
+            c.blockDecodeMicroseconds = job->blockDecodeMicroseconds;
+            candidates.append(c);
+        }
+        delete job;
+    }
+
+    const int chosen = chooseCandidate(candidates);
+
+    QStringList lines;
+    const QLocale locale(QLocale::English);
+    for (int i = 0; i < candidates.count(); i++)
+    {
+        Candidate const &c = candidates.at(i);
+        QString line = QString("%1 KB blocks: %2 bytes")
+                .arg(c.blockSize / 1024)
+                .arg(locale.toString(c.compressedData.length()));
+        if (c.blockDecodeMicroseconds >= 0)
+        {
+            line += QString(", about %1 ms per block on a %2")
+                    .arg(c.blockDecodeMicroseconds / 1000.0, 0, 'f', 1)
+                    .arg(FC8Decoder::mc68030_16MHz.name);
+        }
+        if (c.compressedData.length() > _availableSpace)
+        {
+            line += " (doesn't fit)";
+        }
+        if (i == chosen)
+        {
+            line += " (chosen)";
+        }
+        lines.append(line);
+    }
+    emit candidatesEvaluated(lines.join("\n"));
+
+    QByteArray compressedData;
+    if (chosen >= 0)
+    {
+        compressedData = candidates.at(chosen).compressedData;
+    }
+    emit compressionFinished(FC8Compressor::hashOf(_data), compressedData);
+}
+
+bool FC8BlockSizeSelector::decodesFaster(const Candidate &a, const Candidate &b)
+{
+    // Go by the cycle model when we have it for both, otherwise assume the
+    // smaller block is quicker
+    if (a.blockDecodeMicroseconds >= 0 && b.blockDecodeMicroseconds >= 0)
+    {
+        return a.blockDecodeMicroseconds < b.blockDecodeMicroseconds;
+    }
+    return a.blockSize < b.blockSize;
+}
+
+int FC8BlockSizeSelector::chooseCandidate(const QList<Candidate> &candidates) const
+{
+    int smallest = -1;
+    int fastestFitting = -1;
+    for (int i = 0; i < candidates.count(); i++)
+    {
+        const int len = candidates.at(i).compressedData.length();
+        if (smallest < 0 || len < candidates.at(smallest).compressedData.length())
+        {
+            smallest = i;
+        }
+        if (len <= _availableSpace &&
+            (fastestFitting < 0 || decodesFaster(candidates.at(i), candidates.at(fastestFitting))))
+        {
+            fastestFitting = i;
+        }
+    }
+
+    // If nothing fits, the smallest one at least shows how far off it is
+    if (_policy == FastestBoot && fastestFitting >= 0)
+    {
+        return fastestFitting;
+    }
+    return smallest;
+}
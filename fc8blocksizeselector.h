@@ -0,0 +1,67 @@
+#ifndef FC8BLOCKSIZESELECTOR_H
+#define FC8BLOCKSIZESELECTOR_H
+
+#include <QObject>
+#include <QList>
+#include <QMutex>
+#include "fc8compressor.h"
+
+// Compresses an image with each of the candidate FC8 block sizes at the same
+// time and keeps the one that suits best. Smaller blocks mean less to
+// decompress for every disk read at boot, bigger blocks compress better.
+// How long a block takes to decompress is estimated with FC8Decoder's
+// cycle model for the slowest Macs these ROMs go in.
+class FC8BlockSizeSelector : public QObject
+{
+    Q_OBJECT
+public:
+    enum Policy
+    {
+        // The smallest output, regardless of block size
+        SmallestOutput,
+        // The quickest to decompress per block, out of the ones that fit
+        FastestBoot
+    };
+
+    struct Candidate
+    {
+        int blockSize;
+        QByteArray compressedData;
+        // Average time to decompress one block, or a negative number if
+        // the host decoder couldn't make sense of the output
+        double blockDecodeMicroseconds;
+    };
+
+    explicit FC8BlockSizeSelector(QByteArray const &data, FC8Compressor::Mode mode,
+                                  qint64 availableSpace, Policy policy, QObject *parent = NULL);
+
+    static QList<int> candidateBlockSizes();
+
+    // Safe to call from any thread. Stops all of the candidates, which makes
+    // the compression fail.
+    void cancel();
+
+public slots:
+    void doCompression();
+
+signals:
+    // Describes each candidate and which one was picked; sent just before
+    // compressionFinished
+    void candidatesEvaluated(QString summary);
+    void compressionFinished(QByteArray hashOfOriginal, QByteArray compressedData);
+
+private:
+    int chooseCandidate(QList<Candidate> const &candidates) const;
+    static bool decodesFaster(Candidate const &a, Candidate const &b);
+
+    QByteArray _data;
+    FC8Compressor::Mode _mode;
+    qint64 _availableSpace;
+    Policy _policy;
+
+    QMutex _cancelMutex;
+    bool _cancelled;
+    QList<FC8Compressor *> _running;
+};
+
+#endif // FC8BLOCKSIZESELECTOR_H
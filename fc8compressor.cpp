@@ -1,6 +1,12 @@
 #include "fc8compressor.h"
+#include "bigendian.h"
+#include "fc8optimalencoder.h"
+#include <QBuffer>
 #include <QCryptographicHash>
+#include <QHash>
+#include <QPair>
 #include <stdint.h>
+#include <string.h>
 namespace fc8 {
 extern "C" {
 #include "3rdparty/fc8-compression/fc8.h"
@@ -17,91 +23,257 @@ static QCryptographicHash::Algorithm hashAlgorithm()
 #endif
 }
 
-FC8Compressor::FC8Compressor(const QByteArray &data, int blockSize, QObject *parent) :
+FC8Compressor::FC8Compressor(const QByteArray &data, int blockSize, Mode mode, QObject *parent) :
     QObject(parent),
     _data(data),
-    _blockSize(blockSize)
+    _blockSize(blockSize),
+    _mode(mode),
+    _reusedBlocks(0),
+    _cancelled(0)
 {
 
 }
 
 void FC8Compressor::doCompression()
 {
-    QByteArray compressedData(2 * _data.length(), static_cast<char>(0));
+    QByteArray compressedData = compress();
+
+    // The signature of the original file lets us associate the compressed
+    // version with the original. It was calculated along the way.
+    emit compressionFinished(_hashOfOriginal, compressedData);
+}
+
+QByteArray FC8Compressor::compress()
+{
     if (_blockSize == 0)
     {
-        uint32_t len = fc8::Encode(reinterpret_cast<const uint8_t *>(_data.constData()), _data.length(),
+        // The whole image is one FC8 stream, so it can't be done in pieces
+        QByteArray compressedData(2 * _data.length(), static_cast<char>(0));
+        uint32_t len = encode(reinterpret_cast<const uint8_t *>(_data.constData()), _data.length(),
                 reinterpret_cast<uint8_t *>(compressedData.data()), compressedData.length());
         // the encode routine returns the compressed length, or 0 if there's an error
         compressedData.truncate(len);
+        _hashOfOriginal = hashOf(_data);
+        return compressedData;
+    }
+
+    // QBuffer shares the data rather than copying it
+    QBuffer input;
+    input.setData(_data);
+    input.open(QIODevice::ReadOnly);
+
+    QByteArray compressedData;
+    QBuffer output(&compressedData);
+    output.open(QIODevice::ReadWrite);
+
+    if (!compressStream(&input, &output, &_hashOfOriginal))
+    {
+        // Signal an error with an empty QByteArray
+        _hashOfOriginal = hashOf(_data);
+        return QByteArray();
+    }
+
+    output.close();
+    return compressedData;
+}
+
+static bool readFully(QIODevice *device, char *data, qint64 len)
+{
+    while (len > 0)
+    {
+        const qint64 got = device->read(data, len);
+        if (got <= 0)
+        {
+            return false;
+        }
+        data += got;
+        len -= got;
+    }
+    return true;
+}
+
+bool FC8Compressor::compressStream(QIODevice *input, QIODevice *output, QByteArray *hashOfOriginal)
+{
+    _reusedBlocks = 0;
+    if (_blockSize <= 0 || output->isSequential() || !output->isReadable())
+    {
+        return false;
+    }
+
+    const qint64 inputLength = input->size() - input->pos();
+    if (inputLength <= 0 || inputLength > 0xFFFFFFFFLL)
+    {
+        return false;
     }
-    else
+    const int numBlocks = static_cast<int>((inputLength - 1) / _blockSize + 1);
+
+    // Write the header and a placeholder block table. The table gets filled
+    // in as blocks are written, and goes back over the placeholder at the end.
+    QByteArray header(FC8_BLOCK_HEADER_SIZE, static_cast<char>(0));
+    memcpy(header.data(), "FC8b", 4);
+    putBE32(header.data() + FC8_DECODED_SIZE_OFFSET, static_cast<uint32_t>(inputLength));
+    putBE32(header.data() + FC8_BLOCK_SIZE_OFFSET, _blockSize);
+    QByteArray blockTable(4 * numBlocks, static_cast<char>(0));
+
+    const qint64 outputStart = output->pos();
+    if (output->write(header) != header.length() ||
+        output->write(blockTable) != blockTable.length())
     {
-        int numBlocks = (_data.length() - 1) / _blockSize + 1;
-        // If the input data isn't a multiple of the block size, make sure we've
-        // reserved enough room in the compression buffer
-        if (numBlocks * _blockSize > _data.length())
+        return false;
+    }
+
+    // Blank or mostly empty disk images are full of identical blocks
+    // (usually all zeros). Each distinct block only gets encoded once;
+    // repeats copy the earlier encoded bytes back out of the output. Only
+    // where each one is gets remembered, so memory use goes by the number
+    // of blocks rather than their size.
+    QHash<QByteArray, QPair<uint32_t, int> > encodedBlocks;
+
+    QCryptographicHash hash(hashAlgorithm());
+    QByteArray block(_blockSize, static_cast<char>(0));
+    QByteArray encoded(2 * _blockSize, static_cast<char>(0));
+    uint32_t pos = FC8_BLOCK_HEADER_SIZE + blockTable.length();
+    for (int i = 0; i < numBlocks; i++)
+    {
+        if (isCancelled())
         {
-            const int extraBytes = numBlocks * _blockSize - _data.length();
-            compressedData.append(QByteArray(2 * extraBytes, static_cast<char>(0)));
+            return false;
         }
 
-        // Fill out the header
-        compressedData.replace(0, 4, "FC8b", 4);
-        compressedData[FC8_DECODED_SIZE_OFFSET + 0] = (_data.length() >> 24) & 0xFF;
-        compressedData[FC8_DECODED_SIZE_OFFSET + 1] = (_data.length() >> 16) & 0xFF;
-        compressedData[FC8_DECODED_SIZE_OFFSET + 2] = (_data.length() >> 8) & 0xFF;
-        compressedData[FC8_DECODED_SIZE_OFFSET + 3] = (_data.length() >> 0) & 0xFF;
-        compressedData[FC8_BLOCK_SIZE_OFFSET + 0] = (_blockSize >> 24) & 0xFF;
-        compressedData[FC8_BLOCK_SIZE_OFFSET + 1] = (_blockSize >> 16) & 0xFF;
-        compressedData[FC8_BLOCK_SIZE_OFFSET + 2] = (_blockSize >> 8) & 0xFF;
-        compressedData[FC8_BLOCK_SIZE_OFFSET + 3] = (_blockSize >> 0) & 0xFF;
-
-        int blockpos = FC8_BLOCK_HEADER_SIZE;
-        int pos = FC8_BLOCK_HEADER_SIZE + (4 * numBlocks);
-        for (int i = 0; i < numBlocks; i++)
+        // Grab another block to write out. Pad it with zeros to the block size if
+        // it's the last block and the input data wasn't a multiple of the block size.
+        const int chunkLen = static_cast<int>(qMin(static_cast<qint64>(_blockSize),
+                                                   inputLength - static_cast<qint64>(i) * _blockSize));
+        if (!readFully(input, block.data(), chunkLen))
         {
-            // Grab another block to write out. Pad it with zeros to the block size if
-            // it's the last block and the input data wasn't a multiple of the block size.
-            int chunkLen = qMin(_blockSize, _data.length() - (i * _blockSize));
-            QByteArray block = QByteArray::fromRawData(_data.constData() + i * _blockSize, chunkLen);
-            if (chunkLen < _blockSize)
+            return false;
+        }
+        if (chunkLen < _blockSize)
+        {
+            memset(block.data() + chunkLen, 0, _blockSize - chunkLen);
+        }
+        hash.addData(block.constData(), chunkLen);
+
+        // Compress this block, unless we've already seen one just like it
+        const QByteArray blockHash = QCryptographicHash::hash(block, hashAlgorithm());
+        QHash<QByteArray, QPair<uint32_t, int> >::const_iterator earlier = encodedBlocks.constFind(blockHash);
+        QByteArray payload;
+        if (earlier != encodedBlocks.constEnd())
+        {
+            payload.resize(earlier.value().second);
+            if (!output->seek(outputStart + earlier.value().first) ||
+                !readFully(output, payload.data(), payload.length()) ||
+                !output->seek(outputStart + pos))
             {
-                block.append(QByteArray(_blockSize - chunkLen, static_cast<char>(0)));
+                return false;
             }
-
-            // Compress this block
-            uint32_t len = fc8::Encode(reinterpret_cast<const uint8_t *>(block.constData()), _blockSize,
-                    reinterpret_cast<uint8_t *>(compressedData.data() + pos), compressedData.length() - pos);
+            _reusedBlocks++;
+        }
+        else
+        {
+            uint32_t len = encode(reinterpret_cast<const uint8_t *>(block.constData()), _blockSize,
+                    reinterpret_cast<uint8_t *>(encoded.data()), encoded.length());
             if (len == 0)
             {
-                // Error occurred during encoding. Signal with an empty QByteArray to signal an error
-                compressedData.clear();
-                break;
+                // Error occurred during encoding
+                return false;
             }
+            payload = QByteArray(encoded.constData(), len);
+            encodedBlocks.insert(blockHash, qMakePair(pos, static_cast<int>(len)));
+        }
 
-            // Save the start location of this block in the block table
-            compressedData[blockpos + 0] = (pos >> 24) & 0xFF;
-            compressedData[blockpos + 1] = (pos >> 16) & 0xFF;
-            compressedData[blockpos + 2] = (pos >> 8) & 0xFF;
-            compressedData[blockpos + 3] = (pos >> 0) & 0xFF;
-
-            // Move forward
-            blockpos += 4;
-            pos += len;
+        if (output->write(payload) != payload.length())
+        {
+            return false;
         }
 
-        // All done; now truncate the compressed array to where we left off
-        compressedData.truncate(pos);
+        // Save the start location of this block in the block table, and move forward
+        putBE32(blockTable.data() + 4 * i, pos);
+        pos += payload.length();
+
+        emit progressChanged(i + 1, numBlocks);
     }
 
-    // Calculate a signature of the original file so we can associate the compressed version
-    // with the original.
-    QByteArray hashOfOriginal = QCryptographicHash::hash(_data, hashAlgorithm());
-    emit compressionFinished(hashOfOriginal, compressedData);
+    // Now go back and fill in the real block table
+    if (!output->seek(outputStart + FC8_BLOCK_HEADER_SIZE) ||
+        output->write(blockTable) != blockTable.length() ||
+        !output->seek(outputStart + pos))
+    {
+        return false;
+    }
+
+    if (hashOfOriginal)
+    {
+        *hashOfOriginal = hash.result();
+    }
+    return true;
+}
+
+QByteArray FC8Compressor::encodeBlock(const char *data, int len)
+{
+    if (_blockSize <= 0 || len > _blockSize)
+    {
+        return QByteArray();
+    }
+
+    QByteArray block(_blockSize, static_cast<char>(0));
+    memcpy(block.data(), data, len);
+    QByteArray encoded(2 * _blockSize, static_cast<char>(0));
+    uint32_t encodedLen = encode(reinterpret_cast<const uint8_t *>(block.constData()), _blockSize,
+            reinterpret_cast<uint8_t *>(encoded.data()), encoded.length());
+    encoded.truncate(encodedLen);
+    return encoded;
+}
+
+uint32_t FC8Compressor::encode(const uint8_t *in, uint32_t inLen, uint8_t *out, uint32_t outLen)
+{
+    uint32_t len = fc8::Encode(in, inLen, out, outLen);
+    if (_mode == FastMode || len == 0)
+    {
+        return len;
+    }
+
+    // Try the optimal-parse encoder too. Only use its output if it's smaller
+    // and the reference decoder gives back exactly what went in, so the worst
+    // case is the same as fast mode. The decode buffer has some slack in case
+    // a bad stream runs past the end.
+    QByteArray optimal(outLen, static_cast<char>(0));
+    uint32_t optimalLen = FC8OptimalEncoder::encode(in, inLen,
+            reinterpret_cast<uint8_t *>(optimal.data()), optimal.length());
+    if (optimalLen == 0 || optimalLen >= len)
+    {
+        return len;
+    }
+
+    QByteArray decoded(inLen + 1024, static_cast<char>(0));
+    if (!fc8::Decode(reinterpret_cast<const uint8_t *>(optimal.constData()),
+                     reinterpret_cast<uint8_t *>(decoded.data()), inLen) ||
+        memcmp(decoded.constData(), in, inLen) != 0)
+    {
+        return len;
+    }
+
+    memcpy(out, optimal.constData(), optimalLen);
+    return optimalLen;
+}
+
+void FC8Compressor::cancel()
+{
+    _cancelled.fetchAndStoreOrdered(1);
+}
+
+bool FC8Compressor::isCancelled() const
+{
+    // fetchAndAdd isn't const, but adding zero doesn't change anything
+    return const_cast<QAtomicInt &>(_cancelled).fetchAndAddOrdered(0) != 0;
+}
+
+QByteArray FC8Compressor::hashOf(const QByteArray &file)
+{
+    return QCryptographicHash::hash(file, hashAlgorithm());
 }
 
 bool FC8Compressor::hashMatchesFile(const QByteArray &hash, const QByteArray &file)
 {
-    return QCryptographicHash::hash(file, hashAlgorithm()) == hash;
+    return hashOf(file) == hash;
 }
@@ -2,13 +2,51 @@
 #define FC8COMPRESSOR_H
 
 #include <QObject>
+#include <QAtomicInt>
 #include <stdint.h>
 
+class QIODevice;
+
 class FC8Compressor : public QObject
 {
     Q_OBJECT
 public:
-    explicit FC8Compressor(QByteArray const &data, int blockSize, QObject *parent = NULL);
+    enum Mode
+    {
+        // The stock greedy encoder; quick enough for trying things out
+        FastMode,
+        // Also runs the optimal-parse encoder and keeps whichever output is
+        // smaller. Several times slower.
+        HighRatioMode
+    };
+
+    explicit FC8Compressor(QByteArray const &data, int blockSize, Mode mode = FastMode, QObject *parent = NULL);
+
+    QByteArray compress();
+
+    // Block mode only. Reads the input a block at a time and writes each
+    // compressed block out as soon as it's done, so memory use doesn't
+    // depend on the size of the image. The output has to be seekable and
+    // readable, since the block table is filled in at the end and repeated
+    // blocks are copied from earlier in the output. The hash of the original
+    // is calculated along the way. Doesn't use the data passed to the
+    // constructor.
+    bool compressStream(QIODevice *input, QIODevice *output, QByteArray *hashOfOriginal = NULL);
+
+    // Block mode only. Compresses a single block, padded with zeros if it's
+    // short, and returns its payload as it would appear in the block-mode
+    // output. Empty if it couldn't be encoded.
+    QByteArray encodeBlock(const char *data, int len);
+
+    static QByteArray hashOf(QByteArray const &file);
+
+    // How many blocks in the last compression were copies of an earlier block
+    int reusedBlockCount() const { return _reusedBlocks; }
+
+    // Safe to call from any thread. Block mode stops before the next block
+    // and fails the compression; whole-image mode can't be interrupted.
+    void cancel();
+    bool isCancelled() const;
 
 public slots:
     void doCompression();
@@ -16,10 +54,18 @@ public slots:
 
 signals:
     void compressionFinished(QByteArray hashOfOriginal, QByteArray compressedData);
+    // Block mode only; sent from the compressing thread after each block
+    void progressChanged(int blocksDone, int totalBlocks);
 
 private:
+    uint32_t encode(const uint8_t *in, uint32_t inLen, uint8_t *out, uint32_t outLen);
+
     QByteArray _data;
     int _blockSize;
+    Mode _mode;
+    int _reusedBlocks;
+    QByteArray _hashOfOriginal;
+    QAtomicInt _cancelled;
 };
 
 #endif // FC8COMPRESSOR_H
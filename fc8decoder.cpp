@@ -0,0 +1,201 @@
+#include "fc8decoder.h"
+#include "bigendian.h"
+#include "fc8tokens.h"
+#include <string.h>
+namespace fc8 {
+extern "C" {
+#include "3rdparty/fc8-compression/fc8.h"
+}
+}
+
+// Token dispatch is a handful of shifts and masks plus a jump; the copy
+// loops are a move.b and a dbra per byte, which the 68020 and 68030 can run
+// from the instruction cache. The 68030's data cache helps backref copies a
+// little since they read recently written bytes.
+const FC8Decoder::CycleModel FC8Decoder::mc68020_16MHz = { "16 MHz 68020", 16.0, 24, 6, 8, 10 };
+const FC8Decoder::CycleModel FC8Decoder::mc68030_16MHz = { "16 MHz 68030", 16.0, 22, 6, 8, 8 };
+const FC8Decoder::CycleModel FC8Decoder::mc68030_25MHz = { "25 MHz 68030", 25.0, 22, 6, 8, 8 };
+
+bool FC8Decoder::decodeStream(const uint8_t *in, uint32_t inLen, uint8_t *out, uint32_t outLen,
+                              BlockStats &stats)
+{
+    memset(&stats, 0, sizeof(stats));
+
+    if (inLen < STREAM_HEADER_SIZE || memcmp(in, "FC8_", 4) != 0)
+    {
+        return false;
+    }
+
+    const uint32_t decodedLen = readBE32(in + FC8_DECODED_SIZE_OFFSET);
+    if (decodedLen > outLen)
+    {
+        return false;
+    }
+
+    uint32_t inPos = STREAM_HEADER_SIZE;
+    uint32_t outPos = 0;
+    while (inPos < inLen)
+    {
+        const uint8_t token = in[inPos++];
+        uint32_t len;
+        uint32_t dist;
+
+        if ((token & TOKEN_TYPE_MASK) == TOKEN_LIT)
+        {
+            len = (token & 0x3F) + 1;
+            if (inPos + len > inLen || outPos + len > decodedLen)
+            {
+                return false;
+            }
+            memcpy(out + outPos, in + inPos, len);
+            inPos += len;
+            outPos += len;
+            stats.literalTokens++;
+            stats.literalBytes += len;
+            continue;
+        }
+        else if ((token & TOKEN_TYPE_MASK) == TOKEN_BR0)
+        {
+            dist = token & 0x1F;
+            if (dist == 0)
+            {
+                // EOF
+                return outPos == decodedLen;
+            }
+            len = ((token >> 5) & 0x01) + MIN_MATCH;
+            stats.shortBackrefs++;
+        }
+        else if ((token & TOKEN_TYPE_MASK) == TOKEN_BR1)
+        {
+            if (inPos + 1 > inLen)
+            {
+                return false;
+            }
+            len = ((token >> 3) & 0x07) + MIN_MATCH;
+            dist = (static_cast<uint32_t>(token & 0x07) << 8) | in[inPos];
+            inPos += 1;
+            stats.mediumBackrefs++;
+        }
+        else
+        {
+            if (inPos + 2 > inLen)
+            {
+                return false;
+            }
+            len = br2LengthTable[(token >> 1) & 0x1F];
+            dist = (static_cast<uint32_t>(token & 0x01) << 16) |
+                   (static_cast<uint32_t>(in[inPos]) << 8) | in[inPos + 1];
+            inPos += 2;
+            stats.longBackrefs++;
+        }
+
+        if (dist == 0 || dist > outPos || outPos + len > decodedLen)
+        {
+            return false;
+        }
+
+        // Byte at a time, since the source can overlap what's being written
+        for (uint32_t i = 0; i < len; i++, outPos++)
+        {
+            out[outPos] = out[outPos - dist];
+        }
+        stats.copiedBytes += len;
+    }
+
+    // Ran off the end without seeing EOF
+    return false;
+}
+
+bool FC8Decoder::decode(const QByteArray &compressed, QByteArray &decoded, QList<BlockStats> *blockStats)
+{
+    const uint8_t *in = reinterpret_cast<const uint8_t *>(compressed.constData());
+    const uint32_t inLen = compressed.length();
+    BlockStats stats;
+
+    if (blockStats)
+    {
+        blockStats->clear();
+    }
+
+    if (inLen >= STREAM_HEADER_SIZE && memcmp(in, "FC8_", 4) == 0)
+    {
+        decoded.fill(static_cast<char>(0), readBE32(in + FC8_DECODED_SIZE_OFFSET));
+        if (!decodeStream(in, inLen, reinterpret_cast<uint8_t *>(decoded.data()), decoded.length(), stats))
+        {
+            return false;
+        }
+        if (blockStats)
+        {
+            blockStats->append(stats);
+        }
+        return true;
+    }
+
+    if (inLen < FC8_BLOCK_HEADER_SIZE || memcmp(in, "FC8b", 4) != 0)
+    {
+        return false;
+    }
+
+    const uint32_t totalLen = readBE32(in + FC8_DECODED_SIZE_OFFSET);
+    const uint32_t blockSize = readBE32(in + FC8_BLOCK_SIZE_OFFSET);
+    if (blockSize == 0)
+    {
+        return false;
+    }
+
+    const uint32_t numBlocks = totalLen ? (totalLen - 1) / blockSize + 1 : 0;
+    if (FC8_BLOCK_HEADER_SIZE + 4 * static_cast<uint64_t>(numBlocks) > inLen)
+    {
+        return false;
+    }
+
+    // Every block decodes to a full block, even the last one
+    decoded.fill(static_cast<char>(0), numBlocks * blockSize);
+    for (uint32_t i = 0; i < numBlocks; i++)
+    {
+        const uint32_t start = readBE32(in + FC8_BLOCK_HEADER_SIZE + 4 * i);
+        const uint32_t end = (i + 1 < numBlocks) ?
+                    readBE32(in + FC8_BLOCK_HEADER_SIZE + 4 * (i + 1)) : inLen;
+        if (start > end || end > inLen)
+        {
+            return false;
+        }
+
+        uint8_t *out = reinterpret_cast<uint8_t *>(decoded.data()) + i * blockSize;
+        if (!decodeStream(in + start, end - start, out, blockSize, stats) ||
+            readBE32(in + start + FC8_DECODED_SIZE_OFFSET) != blockSize)
+        {
+            return false;
+        }
+        if (blockStats)
+        {
+            blockStats->append(stats);
+        }
+    }
+
+    decoded.truncate(totalLen);
+    return true;
+}
+
+bool FC8Decoder::roundTrip(const QByteArray &compressed, const QByteArray &original, QList<BlockStats> *blockStats)
+{
+    QByteArray decoded;
+    return decode(compressed, decoded, blockStats) && decoded == original;
+}
+
+uint64_t FC8Decoder::estimateCycles(const BlockStats &stats, const CycleModel &model)
+{
+    const uint32_t tokens = stats.literalTokens + stats.shortBackrefs +
+            stats.mediumBackrefs + stats.longBackrefs;
+    const uint32_t operandBytes = stats.mediumBackrefs + 2 * stats.longBackrefs;
+
+    return static_cast<uint64_t>(tokens) * model.cyclesPerToken +
+           static_cast<uint64_t>(operandBytes) * model.cyclesPerOperandByte +
+           static_cast<uint64_t>(stats.literalBytes) * model.cyclesPerLiteralByte +
+           static_cast<uint64_t>(stats.copiedBytes) * model.cyclesPerCopiedByte;
+}
+
+double FC8Decoder::estimateMicroseconds(const BlockStats &stats, const CycleModel &model)
+{
+    return estimateCycles(stats, model) / model.clockMHz;
+}
@@ -0,0 +1,59 @@
+#ifndef FC8DECODER_H
+#define FC8DECODER_H
+
+#include <QByteArray>
+#include <QList>
+#include <stdint.h>
+
+// Decodes FC8_ and FC8b images on the host, counting what the decoder has
+// to do along the way. The counts, fed through a rough cycle model of the
+// ROM's 68k decompressor, give an idea of how much a given image will slow
+// down reads from the ROM disk without having to flash it and time a boot.
+class FC8Decoder
+{
+public:
+    struct BlockStats
+    {
+        uint32_t literalTokens;
+        uint32_t literalBytes;
+        uint32_t shortBackrefs;     // BR0
+        uint32_t mediumBackrefs;    // BR1
+        uint32_t longBackrefs;      // BR2
+        uint32_t copiedBytes;
+    };
+
+    // Cycle costs of the decompressor's inner loops on a particular CPU.
+    // These are estimates from instruction timings, not measurements.
+    struct CycleModel
+    {
+        const char *name;
+        double clockMHz;
+        uint32_t cyclesPerToken;
+        uint32_t cyclesPerOperandByte;
+        uint32_t cyclesPerLiteralByte;
+        uint32_t cyclesPerCopiedByte;
+    };
+
+    static const CycleModel mc68020_16MHz;
+    static const CycleModel mc68030_16MHz;
+    static const CycleModel mc68030_25MHz;
+
+    // Decodes a whole image (either format). An FC8_ image counts as one
+    // block. Returns false if the image is malformed.
+    static bool decode(QByteArray const &compressed, QByteArray &decoded,
+                       QList<BlockStats> *blockStats = NULL);
+
+    // Decodes the image and checks that it gives back original. Block mode
+    // images are padded out to a whole block, so that's ignored.
+    static bool roundTrip(QByteArray const &compressed, QByteArray const &original,
+                          QList<BlockStats> *blockStats = NULL);
+
+    static uint64_t estimateCycles(BlockStats const &stats, CycleModel const &model);
+    static double estimateMicroseconds(BlockStats const &stats, CycleModel const &model);
+
+private:
+    static bool decodeStream(const uint8_t *in, uint32_t inLen, uint8_t *out, uint32_t outLen,
+                             BlockStats &stats);
+};
+
+#endif // FC8DECODER_H
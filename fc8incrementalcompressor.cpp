@@ -0,0 +1,87 @@
+#include "fc8incrementalcompressor.h"
+#include "bigendian.h"
+#include <string.h>
+namespace fc8 {
+extern "C" {
+#include "3rdparty/fc8-compression/fc8.h"
+}
+}
+
+FC8IncrementalCompressor::FC8IncrementalCompressor(int blockSize, FC8Compressor::Mode mode) :
+    _blockSize(blockSize),
+    _mode(mode),
+    _compressedBlocks(0)
+{
+
+}
+
+void FC8IncrementalCompressor::reset()
+{
+    _previousImage.clear();
+    _payloads.clear();
+    _compressedBlocks = 0;
+}
+
+QByteArray FC8IncrementalCompressor::compress(const QByteArray &image)
+{
+    _compressedBlocks = 0;
+    if (_blockSize <= 0 || image.isEmpty())
+    {
+        reset();
+        return QByteArray();
+    }
+
+    const int numBlocks = (image.length() - 1) / _blockSize + 1;
+    QVector<QByteArray> payloads(numBlocks);
+    FC8Compressor compressor(QByteArray(), _blockSize, _mode);
+    int payloadsLength = 0;
+    for (int i = 0; i < numBlocks; i++)
+    {
+        const int start = i * _blockSize;
+        const int len = qMin(_blockSize, image.length() - start);
+
+        // A block can only be reused if it's the same length as before too,
+        // since the last one gets padded
+        const bool unchanged = i < _payloads.count() &&
+                start + len <= _previousImage.length() &&
+                (i + 1 < numBlocks || image.length() == _previousImage.length()) &&
+                memcmp(image.constData() + start, _previousImage.constData() + start, len) == 0;
+        if (unchanged)
+        {
+            payloads[i] = _payloads.at(i);
+        }
+        else
+        {
+            payloads[i] = compressor.encodeBlock(image.constData() + start, len);
+            _compressedBlocks++;
+            if (payloads.at(i).isEmpty())
+            {
+                // Error occurred during encoding
+                reset();
+                return QByteArray();
+            }
+        }
+        payloadsLength += payloads.at(i).length();
+    }
+
+    // Lay it out just like FC8Compressor: header, block table, then blocks
+    const int tableLength = 4 * numBlocks;
+    QByteArray output;
+    output.resize(FC8_BLOCK_HEADER_SIZE + tableLength + payloadsLength);
+    memset(output.data(), 0, FC8_BLOCK_HEADER_SIZE);
+    memcpy(output.data(), "FC8b", 4);
+    putBE32(output.data() + FC8_DECODED_SIZE_OFFSET, image.length());
+    putBE32(output.data() + FC8_BLOCK_SIZE_OFFSET, _blockSize);
+
+    uint32_t pos = FC8_BLOCK_HEADER_SIZE + tableLength;
+    for (int i = 0; i < numBlocks; i++)
+    {
+        putBE32(output.data() + FC8_BLOCK_HEADER_SIZE + 4 * i, pos);
+        memcpy(output.data() + pos, payloads.at(i).constData(), payloads.at(i).length());
+        pos += payloads.at(i).length();
+    }
+
+    _previousImage = image;
+    _payloads = payloads;
+    return output;
+}
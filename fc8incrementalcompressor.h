@@ -0,0 +1,39 @@
+#ifndef FC8INCREMENTALCOMPRESSOR_H
+#define FC8INCREMENTALCOMPRESSOR_H
+
+#include <QByteArray>
+#include <QVector>
+#include "fc8compressor.h"
+
+// Compresses successive versions of the same disk image in FC8 block mode.
+// It remembers the previous version and its compressed blocks, and only
+// compresses blocks that changed since then. The output is the same as
+// FC8Compressor would produce (apart from which identical blocks share
+// encoded bytes, which doesn't change the size or layout).
+//
+// A block that compresses to a different size moves every block after it,
+// so the output after a change can still differ from the previous output
+// all the way to the end.
+class FC8IncrementalCompressor
+{
+public:
+    FC8IncrementalCompressor(int blockSize, FC8Compressor::Mode mode = FC8Compressor::FastMode);
+
+    QByteArray compress(QByteArray const &image);
+
+    // Forgets everything, so the next compress() does the whole image
+    void reset();
+
+    // How many blocks the last compress() actually had to compress
+    int compressedBlockCount() const { return _compressedBlocks; }
+    int totalBlockCount() const { return _payloads.count(); }
+
+private:
+    int _blockSize;
+    FC8Compressor::Mode _mode;
+    QByteArray _previousImage;
+    QVector<QByteArray> _payloads;
+    int _compressedBlocks;
+};
+
+#endif // FC8INCREMENTALCOMPRESSOR_H
@@ -0,0 +1,225 @@
+#include "fc8optimalencoder.h"
+#include "bigendian.h"
+#include "fc8tokens.h"
+#include <QVector>
+#include <string.h>
+namespace fc8 {
+extern "C" {
+#include "3rdparty/fc8-compression/fc8.h"
+}
+}
+
+// Match finder tuning. Deeper chains find slightly better matches but
+// get slow on repetitive data.
+#define HASH_BITS           16
+#define MAX_CHAIN_LENGTH    128
+
+static inline uint32_t hash3(const uint8_t *p)
+{
+    const uint32_t v = (static_cast<uint32_t>(p[0]) << 16) |
+                       (static_cast<uint32_t>(p[1]) << 8) |
+                       static_cast<uint32_t>(p[2]);
+    return static_cast<uint32_t>(v * 2654435761U) >> (32 - HASH_BITS);
+}
+
+static int br2LengthCode(uint32_t len)
+{
+    for (size_t i = 0; i < NUM_BR2_LENGTHS; i++)
+    {
+        if (br2LengthTable[i] == len)
+        {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+// How many bytes a backref of this length and distance takes. The length
+// has to come from br2LengthTable.
+static inline uint32_t backrefCost(uint32_t len, uint32_t dist)
+{
+    if (dist <= BR0_MAX_DISTANCE && len <= BR0_MAX_LENGTH)
+    {
+        return 1;
+    }
+    else if (dist <= BR1_MAX_DISTANCE && len <= BR1_MAX_LENGTH)
+    {
+        return 2;
+    }
+    return 3;
+}
+
+uint32_t FC8OptimalEncoder::encode(const uint8_t *in, uint32_t inLen, uint8_t *out, uint32_t outLen)
+{
+    if (outLen < STREAM_HEADER_SIZE + 1)
+    {
+        return 0;
+    }
+
+    // cost[i] is the cheapest way found so far to encode the first i bytes.
+    // matchLen/matchDist say how we got there (a length of 0 is a literal),
+    // and literalRun tracks how long the literal run is at that point so we
+    // know when another LIT token has to be started.
+    const uint32_t infinity = 0xFFFFFFFFUL;
+    QVector<uint32_t> cost(inLen + 1, infinity);
+    QVector<uint16_t> matchLen(inLen + 1, 0);
+    QVector<uint32_t> matchDist(inLen + 1, 0);
+    QVector<uint32_t> literalRun(inLen + 1, 0);
+    QVector<int32_t> head(1 << HASH_BITS, -1);
+    QVector<int32_t> prev(inLen, -1);
+    cost[0] = 0;
+
+    for (uint32_t i = 0; i < inLen; i++)
+    {
+        // Extending with a literal
+        const uint32_t litCost = cost[i] + 1 + ((literalRun[i] % MAX_LITERAL_RUN) == 0 ? 1 : 0);
+        if (litCost < cost[i + 1])
+        {
+            cost[i + 1] = litCost;
+            matchLen[i + 1] = 0;
+            literalRun[i + 1] = literalRun[i] + 1;
+        }
+
+        if (i + MIN_MATCH > inLen)
+        {
+            continue;
+        }
+
+        // Walk the chain, nearest candidates first. A farther match is only
+        // interesting if it's longer, since it never costs less to encode.
+        const uint32_t h = hash3(in + i);
+        const uint32_t maxLen = qMin(static_cast<uint32_t>(MAX_MATCH), inLen - i);
+        uint32_t bestLen = MIN_MATCH - 1;
+        int chain = 0;
+        for (int32_t cand = head[h]; cand >= 0 && chain < MAX_CHAIN_LENGTH; cand = prev[cand], chain++)
+        {
+            const uint32_t dist = i - cand;
+            if (dist > BR2_MAX_DISTANCE)
+            {
+                break;
+            }
+
+            uint32_t len = 0;
+            while (len < maxLen && in[cand + len] == in[i + len])
+            {
+                len++;
+            }
+
+            if (len <= bestLen)
+            {
+                continue;
+            }
+
+            for (size_t l = 0; l < NUM_BR2_LENGTHS; l++)
+            {
+                const uint32_t tryLen = br2LengthTable[l];
+                if (tryLen <= bestLen)
+                {
+                    continue;
+                }
+                if (tryLen > len)
+                {
+                    break;
+                }
+
+                const uint32_t tokenCost = backrefCost(tryLen, dist);
+                if (cost[i] + tokenCost < cost[i + tryLen])
+                {
+                    cost[i + tryLen] = cost[i] + tokenCost;
+                    matchLen[i + tryLen] = tryLen;
+                    matchDist[i + tryLen] = dist;
+                    literalRun[i + tryLen] = 0;
+                }
+            }
+
+            bestLen = len;
+            if (bestLen == maxLen)
+            {
+                break;
+            }
+        }
+
+        prev[i] = head[h];
+        head[h] = i;
+    }
+
+    // Walk back from the end to recover the chosen steps
+    QVector<uint32_t> steps;
+    for (uint32_t pos = inLen; pos > 0; )
+    {
+        steps.append(pos);
+        pos -= matchLen[pos] ? matchLen[pos] : 1;
+    }
+
+    memcpy(out, "FC8_", 4);
+    putBE32(reinterpret_cast<char *>(out) + FC8_DECODED_SIZE_OFFSET, inLen);
+
+    uint32_t outPos = STREAM_HEADER_SIZE;
+    uint32_t literalStart = 0;
+    uint32_t literalCount = 0;
+    for (int s = steps.count() - 1; s >= -1; s--)
+    {
+        const bool isMatch = s >= 0 && matchLen[steps[s]] != 0;
+        if (s >= 0 && !isMatch)
+        {
+            if (literalCount == 0)
+            {
+                literalStart = steps[s] - 1;
+            }
+            literalCount++;
+            continue;
+        }
+
+        // A match (or the end) flushes any pending literals first
+        while (literalCount > 0)
+        {
+            const uint32_t run = qMin(literalCount, static_cast<uint32_t>(MAX_LITERAL_RUN));
+            if (outPos + 1 + run > outLen)
+            {
+                return 0;
+            }
+            out[outPos++] = TOKEN_LIT | (run - 1);
+            memcpy(out + outPos, in + literalStart, run);
+            outPos += run;
+            literalStart += run;
+            literalCount -= run;
+        }
+
+        if (!isMatch)
+        {
+            break;
+        }
+
+        const uint32_t len = matchLen[steps[s]];
+        const uint32_t dist = matchDist[steps[s]];
+        const uint32_t tokenCost = backrefCost(len, dist);
+        if (outPos + tokenCost > outLen)
+        {
+            return 0;
+        }
+
+        if (tokenCost == 1)
+        {
+            out[outPos++] = TOKEN_BR0 | ((len - MIN_MATCH) << 5) | dist;
+        }
+        else if (tokenCost == 2)
+        {
+            out[outPos++] = TOKEN_BR1 | ((len - MIN_MATCH) << 3) | (dist >> 8);
+            out[outPos++] = dist & 0xFF;
+        }
+        else
+        {
+            out[outPos++] = TOKEN_BR2 | (br2LengthCode(len) << 1) | (dist >> 16);
+            out[outPos++] = (dist >> 8) & 0xFF;
+            out[outPos++] = dist & 0xFF;
+        }
+    }
+
+    if (outPos + 1 > outLen)
+    {
+        return 0;
+    }
+    out[outPos++] = TOKEN_EOF;
+
+    return outPos;
+}
@@ -0,0 +1,18 @@
+#ifndef FC8OPTIMALENCODER_H
+#define FC8OPTIMALENCODER_H
+
+#include <stdint.h>
+
+// A slower alternative to the stock greedy fc8::Encode. It finds matches
+// with a hash chain and then picks the cheapest sequence of literals and
+// backrefs for the whole input (a shortest path over the token costs)
+// instead of always taking the longest match at each position. The output
+// is a regular FC8_ stream, with the same header as fc8::Encode writes.
+class FC8OptimalEncoder
+{
+public:
+    // Returns the encoded length, or 0 if it didn't fit in outLen
+    static uint32_t encode(const uint8_t *in, uint32_t inLen, uint8_t *out, uint32_t outLen);
+};
+
+#endif // FC8OPTIMALENCODER_H
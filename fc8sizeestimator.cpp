@@ -0,0 +1,127 @@
+#include "fc8sizeestimator.h"
+#include <QList>
+#include <QRunnable>
+#include <QThread>
+#include <QThreadPool>
+#include <math.h>
+namespace fc8 {
+extern "C" {
+#include "3rdparty/fc8-compression/fc8.h"
+}
+}
+
+namespace
+{
+// Compresses one sample block on a pool thread
+class SampleCompression : public QRunnable
+{
+public:
+    SampleCompression(QByteArray const &block, FC8Compressor::Mode mode) :
+        block(block),
+        mode(mode),
+        compressedSize(0)
+    {
+        setAutoDelete(false);
+    }
+
+    void run()
+    {
+        FC8Compressor compressor(QByteArray(), block.length(), mode);
+        compressedSize = compressor.encodeBlock(block.constData(), block.length()).length();
+    }
+
+    QByteArray block;
+    FC8Compressor::Mode mode;
+    uint32_t compressedSize;
+};
+}
+
+FC8SizeEstimator::Estimate FC8SizeEstimator::estimate(const QByteArray &data, int blockSize,
+                                                      FC8Compressor::Mode mode, int maxSamples)
+{
+    Estimate result;
+    result.size = 0;
+    result.margin = 0;
+    result.sampledBlocks = 0;
+    result.totalBlocks = data.isEmpty() ? 0 : (data.length() - 1) / blockSize + 1;
+    if (result.totalBlocks == 0 || maxSamples <= 0)
+    {
+        return result;
+    }
+
+    // Spread the samples evenly over the image. Disk images tend to have
+    // their files near the start and free space at the end, so just taking
+    // the first few blocks would be badly skewed.
+    const int samples = qMin(maxSamples, result.totalBlocks);
+    QThreadPool pool;
+    QList<SampleCompression *> jobs;
+    for (int i = 0; i < samples; i++)
+    {
+        const int blockIndex = static_cast<int>(static_cast<qint64>(i) * result.totalBlocks / samples);
+        const int offset = blockIndex * blockSize;
+        QByteArray block = data.mid(offset, blockSize);
+        if (block.length() < blockSize)
+        {
+            block.append(QByteArray(blockSize - block.length(), static_cast<char>(0)));
+        }
+
+        SampleCompression *job = new SampleCompression(block, mode);
+        jobs.append(job);
+        pool.start(job);
+    }
+    pool.waitForDone();
+
+    double sum = 0;
+    double sumSquares = 0;
+    foreach (SampleCompression *job, jobs)
+    {
+        // A failed encode shouldn't make the estimate look better than it is
+        const double len = job->compressedSize ? job->compressedSize : 2.0 * blockSize;
+        sum += len;
+        sumSquares += len * len;
+        delete job;
+    }
+
+    const double mean = sum / samples;
+    const double variance = samples > 1 ? qMax(0.0, (sumSquares - samples * mean * mean) / (samples - 1)) : 0.0;
+
+    // Standard error of the total, with the finite population correction
+    // since we're sampling without replacement
+    const double n = samples;
+    const double N = result.totalBlocks;
+    const double stdError = N * sqrt(variance / n) * sqrt((N - n) / N);
+
+    result.sampledBlocks = samples;
+    result.size = FC8_BLOCK_HEADER_SIZE + 4 * static_cast<qint64>(result.totalBlocks) +
+            static_cast<qint64>(mean * N + 0.5);
+    result.margin = static_cast<qint64>(1.96 * stdError + 0.5);
+    return result;
+}
+
+FC8SizeEstimateWorker::FC8SizeEstimateWorker(const QByteArray &key, const QByteArray &data, int blockSize,
+                                             FC8Compressor::Mode mode, QObject *parent) :
+    QObject(parent),
+    _key(key),
+    _data(data),
+    _blockSize(blockSize),
+    _mode(mode)
+{
+
+}
+
+void FC8SizeEstimateWorker::start()
+{
+    QThread *thread = new QThread();
+    moveToThread(thread);
+    connect(thread, SIGNAL(started()), this, SLOT(doEstimate()));
+    connect(this, SIGNAL(destroyed()), thread, SLOT(quit()));
+    connect(thread, SIGNAL(finished()), thread, SLOT(deleteLater()));
+    thread->start();
+}
+
+void FC8SizeEstimateWorker::doEstimate()
+{
+    const FC8SizeEstimator::Estimate estimate = FC8SizeEstimator::estimate(_data, _blockSize, _mode);
+    emit estimateFinished(_key, estimate.size, estimate.margin);
+    deleteLater();
+}
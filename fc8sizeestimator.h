@@ -0,0 +1,59 @@
+#ifndef FC8SIZEESTIMATOR_H
+#define FC8SIZEESTIMATOR_H
+
+#include <QByteArray>
+#include <QObject>
+#include <stdint.h>
+#include "fc8compressor.h"
+
+// Guesses how big an FC8 block-compressed image will be without
+// compressing the whole thing. It compresses an evenly spaced sample of
+// blocks in parallel and scales the result up to the full image, so the
+// UI can say whether it'll fit long before the real compression is done.
+class FC8SizeEstimator
+{
+public:
+    struct Estimate
+    {
+        // Best guess of the compressed size, including the FC8b header and
+        // block table
+        qint64 size;
+        // Half the width of a 95% confidence band around size. It's 0 when
+        // every block was sampled.
+        qint64 margin;
+        int sampledBlocks;
+        int totalBlocks;
+    };
+
+    // The samples are compressed the same way mode would compress them
+    static Estimate estimate(QByteArray const &data, int blockSize, FC8Compressor::Mode mode,
+                             int maxSamples = 32);
+};
+
+// Works out an estimate on its own thread, the same way CompressionJob runs
+// a compressor. The key is whatever the caller uses to tell estimates apart;
+// it just comes back with the result. Deletes itself once it's sent it.
+class FC8SizeEstimateWorker : public QObject
+{
+    Q_OBJECT
+public:
+    FC8SizeEstimateWorker(QByteArray const &key, QByteArray const &data, int blockSize,
+                          FC8Compressor::Mode mode, QObject *parent = NULL);
+
+    // Starts it on a new thread that goes away when it's done
+    void start();
+
+public slots:
+    void doEstimate();
+
+signals:
+    void estimateFinished(QByteArray key, qint64 size, qint64 margin);
+
+private:
+    QByteArray _key;
+    QByteArray _data;
+    int _blockSize;
+    FC8Compressor::Mode _mode;
+};
+
+#endif // FC8SIZEESTIMATOR_H
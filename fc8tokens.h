@@ -0,0 +1,44 @@
+#ifndef FC8TOKENS_H
+#define FC8TOKENS_H
+
+#include <stdint.h>
+
+// The FC8 stream format, as far as our own encoder and decoder need to know
+// it. The reference encoder and decoder in 3rdparty/fc8-compression keep
+// theirs to themselves. FC8_DECODED_SIZE_OFFSET comes from fc8.h.
+//
+// FC8 tokens:
+//   LIT  00aaaaaa                       a+1 literal bytes follow (1-64)
+//   BR0  01baaaaa                       copy b+3 bytes (3-4) from a bytes back (1-31)
+//   BR1  10bbbaaa aaaaaaaa              copy b+3 bytes (3-10) from a bytes back (1-2047)
+//   BR2  11bbbbba aaaaaaaa aaaaaaaa     copy lengthTable[b] bytes from a bytes back (1-131071)
+//   EOF  01x00000
+#define TOKEN_TYPE_MASK     0xC0
+#define TOKEN_LIT           0x00
+#define TOKEN_BR0           0x40
+#define TOKEN_BR1           0x80
+#define TOKEN_BR2           0xC0
+#define TOKEN_EOF           0x40
+
+#define MAX_LITERAL_RUN     64
+#define MIN_MATCH           3
+#define BR0_MAX_LENGTH      4
+#define BR0_MAX_DISTANCE    31
+#define BR1_MAX_LENGTH      10
+#define BR1_MAX_DISTANCE    2047
+#define BR2_MAX_DISTANCE    131071
+
+// The data starts after the "FC8_" magic and the decoded size
+#define STREAM_HEADER_SIZE  (FC8_DECODED_SIZE_OFFSET + 4)
+
+// BR2 lengths. This also happens to be every length that any backref can
+// represent, since the short ones are covered by BR0 and BR1 too.
+static const uint16_t br2LengthTable[32] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18,
+    19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 35, 48, 72, 128, 256
+};
+
+#define NUM_BR2_LENGTHS     (sizeof(br2LengthTable) / sizeof(br2LengthTable[0]))
+#define MAX_MATCH           256
+
+#endif // FC8TOKENS_H
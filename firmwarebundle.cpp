@@ -0,0 +1,143 @@
+#include "firmwarebundle.h"
+#include <QByteArrayMatcher>
+#include <QFile>
+
+static const QByteArray multiFirmwareDelimiter(
+        "\xDB\x00\xDB\x01\xDB\x02\xDB\x03\xDB\x04\xDB\x05\xDB\x06\xDB\x07"
+        "\xDB\x08\xDB\x09\xDB\x0A\xDB\x0B\xDB\x0C\xDB\x0D\xDB\x0E\xDB\x0F"
+        "\xDB\xDB\xDB\xDB\xAA\xAA\xAA\xAA\xDB\xDB\xDB\xDB\x55\x55\x55\x55", 48);
+
+// The USB vendor and product ID, as they appear in the device descriptor
+static const QByteArray programmerVidPid("\xD0\x16\xAA\x06", 4);
+
+FirmwareBundle::FirmwareBundle() :
+    _firmwareCount(0)
+{
+}
+
+bool FirmwareBundle::load(QString const &fileName)
+{
+    QFile fwFile(fileName);
+    if (!fwFile.open(QFile::ReadOnly))
+    {
+        return false;
+    }
+
+    setData(fwFile.readAll());
+    fwFile.close();
+    return true;
+}
+
+void FirmwareBundle::setData(QByteArray const &data)
+{
+    // Choosing the same file again is common (e.g. retrying an update), so
+    // only rebuild the index if the contents actually changed
+    if (data == _data && !_data.isEmpty())
+    {
+        return;
+    }
+
+    _data = data;
+    buildIndex();
+}
+
+bool FirmwareBundle::findFirmware(uint16_t revision, Entry &entry) const
+{
+    // A revision of 0 means the programmer's revision couldn't be detected,
+    // in which case we just let them attempt the first firmware there is.
+    foreach (Entry const &e, _entries)
+    {
+        if (e.revision == revision || revision == 0)
+        {
+            entry = e;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+QByteArray FirmwareBundle::firmware(Entry const &entry) const
+{
+    // This doesn't copy anything; it's only valid as long as the bundle's
+    // data doesn't change.
+    return QByteArray::fromRawData(_data.constData() + entry.offset, entry.length);
+}
+
+QList<QByteArray> FirmwareBundle::split(QByteArray const &bundle)
+{
+    // The pieces returned point into bundle rather than being copies
+    QList<QByteArray> pieces;
+    const QByteArrayMatcher matcher(multiFirmwareDelimiter);
+
+    int start = 0;
+    int index;
+    while ((index = matcher.indexIn(bundle, start)) >= 0)
+    {
+        pieces.append(QByteArray::fromRawData(bundle.constData() + start, index - start));
+        start = index + multiFirmwareDelimiter.length();
+    }
+
+    // As long as we have something left, also append it
+    if (start < bundle.length())
+    {
+        pieces.append(QByteArray::fromRawData(bundle.constData() + start, bundle.length() - start));
+    }
+
+    return pieces;
+}
+
+void FirmwareBundle::buildIndex()
+{
+    _entries.clear();
+    _firmwareCount = 0;
+
+    foreach (QByteArray const &piece, split(_data))
+    {
+        indexPiece(piece.constData() - _data.constData(), piece.length());
+    }
+}
+
+void FirmwareBundle::indexPiece(int offset, int length)
+{
+    // Find the device descriptor in the dump. Locate it by
+    // searching for the USB VID and PID, and then double-checking
+    // that it's actually a device descriptor by verifying the surrounding data.
+    const QByteArrayMatcher matcher(programmerVidPid);
+    const char *piece = _data.constData() + offset;
+    int descriptorsFound = 0;
+    int index = 0;
+    while ((index = matcher.indexIn(piece, length, index)) >= 0)
+    {
+        // Is this actually the device descriptor? Check a bunch of fields to see.
+        // The descriptors are slightly different between revisions, but this will
+        // check enough of the fields that we can be confident.
+        if (index >= 8 &&
+            index + 9 < length &&
+            piece[index - 8] == 0x12 && // Device descriptor length
+            piece[index - 7] == 0x01 && // Device descriptor identifier
+            piece[index - 4] == 0x02 && // Class = CDC communication device
+            piece[index - 3] == 0x00 && // Subclass = 0
+            piece[index - 2] == 0x00 && // Protocol = 0)
+            piece[index + 6] == 0x01 && // Manufacturer string = 1
+            piece[index + 7] == 0x02 && // Product string = 2
+            piece[index + 9] == 0x01) // Num configurations = 1
+        {
+            // We're pretty sure it is. Let's extract the revision.
+            Entry entry;
+            entry.revision = static_cast<uint8_t>(piece[index + 4]) |
+                             static_cast<uint8_t>(piece[index + 5]) << 8;
+            entry.offset = offset;
+            entry.length = length;
+            _entries.append(entry);
+            descriptorsFound++;
+        }
+
+        index += programmerVidPid.length();
+    }
+
+    if (descriptorsFound > 0)
+    {
+        _firmwareCount++;
+    }
+}
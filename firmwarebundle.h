@@ -0,0 +1,46 @@
+#ifndef FIRMWAREBUNDLE_H
+#define FIRMWAREBUNDLE_H
+
+#include <QByteArray>
+#include <QList>
+#include <QString>
+#include <stdint.h>
+
+// A firmware file can contain several firmware images (one per programmer
+// revision) separated by a delimiter. This splits the file up in a single
+// pass and keeps an index of which revision lives where, so picking the
+// right firmware again for the same file doesn't need another scan.
+class FirmwareBundle
+{
+public:
+    struct Entry
+    {
+        uint16_t revision;
+        int offset;
+        int length;
+    };
+
+    FirmwareBundle();
+
+    bool load(QString const &fileName);
+    void setData(QByteArray const &data);
+
+    QByteArray const &data() const { return _data; }
+    QList<Entry> const &entries() const { return _entries; }
+    int firmwareCount() const { return _firmwareCount; }
+
+    bool findFirmware(uint16_t revision, Entry &entry) const;
+    QByteArray firmware(Entry const &entry) const;
+
+    static QList<QByteArray> split(QByteArray const &bundle);
+
+private:
+    void buildIndex();
+    void indexPiece(int offset, int length);
+
+    QByteArray _data;
+    QList<Entry> _entries;
+    int _firmwareCount;
+};
+
+#endif // FIRMWAREBUNDLE_H
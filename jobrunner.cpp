@@ -0,0 +1,549 @@
+#include "jobrunner.h"
+#include <QTimer>
+
+JobRunner::JobRunner(Programmer *programmer, QObject *parent) :
+    QObject(parent),
+    p(programmer),
+    nextJobID(1),
+    connected(false),
+    currentJobID(-1),
+    currentSequenceID(0),
+    previousVerifyMode(VerifyWhileWriting),
+    progressTotal(0)
+{
+    jobBuffer = new QBuffer(&jobArray, this);
+
+    connect(p, SIGNAL(programmerBoardConnected()), SLOT(boardConnected()));
+    connect(p, SIGNAL(programmerBoardDisconnected()), SLOT(boardDisconnected()));
+    connect(p, SIGNAL(programmerBoardDisconnectedDuringOperation()), SLOT(boardDisconnectedDuringOperation()));
+
+    connect(p, SIGNAL(readStatusChanged(ReadStatus)), SLOT(readStatusChanged(ReadStatus)));
+    connect(p, SIGNAL(writeStatusChanged(WriteStatus)), SLOT(writeStatusChanged(WriteStatus)));
+    connect(p, SIGNAL(identificationStatusChanged(IdentificationStatus)), SLOT(identificationStatusChanged(IdentificationStatus)));
+    connect(p, SIGNAL(electricalTestStatusChanged(ElectricalTestStatus)), SLOT(electricalTestStatusChanged(ElectricalTestStatus)));
+    connect(p, SIGNAL(electricalTestFailLocation(uint8_t,uint8_t)), SLOT(electricalTestFailLocation(uint8_t,uint8_t)));
+
+    connect(p, SIGNAL(readTotalLengthChanged(uint32_t)), SLOT(totalLengthChanged(uint32_t)));
+    connect(p, SIGNAL(readCompletionLengthChanged(uint32_t)), SLOT(completionLengthChanged(uint32_t)));
+    connect(p, SIGNAL(writeTotalLengthChanged(uint32_t)), SLOT(totalLengthChanged(uint32_t)));
+    connect(p, SIGNAL(writeCompletionLengthChanged(uint32_t)), SLOT(completionLengthChanged(uint32_t)));
+    connect(p, SIGNAL(writeVerifyTotalLengthChanged(uint32_t)), SLOT(totalLengthChanged(uint32_t)));
+    connect(p, SIGNAL(writeVerifyCompletionLengthChanged(uint32_t)), SLOT(completionLengthChanged(uint32_t)));
+}
+
+JobRunner::~JobRunner()
+{
+    jobBuffer->close();
+}
+
+int JobRunner::enqueue(ProgrammerJob const &job)
+{
+    QueuedJob queued;
+    queued.id = nextJobID++;
+    queued.sequenceID = 0;
+    queued.job = job;
+    queue.append(queued);
+
+    if (!isBusy())
+    {
+        QTimer::singleShot(0, this, SLOT(startNextJob()));
+    }
+    return queued.id;
+}
+
+int JobRunner::enqueueSequence(QList<ProgrammerJob> const &jobs)
+{
+    const int sequenceID = nextJobID++;
+    if (jobs.isEmpty())
+    {
+        return sequenceID;
+    }
+
+    Sequence sequence;
+    sequence.totalSteps = jobs.count();
+    sequence.completedSteps = 0;
+    sequence.previousSessionMode = p->sessionMode();
+    sequences.insert(sequenceID, sequence);
+
+    foreach (ProgrammerJob const &job, jobs)
+    {
+        QueuedJob queued;
+        queued.id = nextJobID++;
+        queued.sequenceID = sequenceID;
+        queued.job = job;
+        queue.append(queued);
+    }
+
+    if (!isBusy())
+    {
+        QTimer::singleShot(0, this, SLOT(startNextJob()));
+    }
+    return sequenceID;
+}
+
+void JobRunner::setBoardConnected(bool isConnected)
+{
+    connected = isConnected;
+    if (connected)
+    {
+        QTimer::singleShot(0, this, SLOT(startNextJob()));
+    }
+}
+
+QString JobRunner::describe(ProgrammerJob::Type type)
+{
+    switch (type)
+    {
+    case ProgrammerJob::Read:
+        return "Read";
+    case ProgrammerJob::Write:
+        return "Write";
+    case ProgrammerJob::WritePortion:
+        return "Write sectors";
+    case ProgrammerJob::Verify:
+        return "Verify";
+    case ProgrammerJob::Identify:
+        return "Identify chips";
+    case ProgrammerJob::ElectricalTest:
+        return "Electrical test";
+    case ProgrammerJob::ChecksumVerify:
+        return "Checksum verify";
+    }
+    return QString();
+}
+
+bool JobRunner::cancel(int id)
+{
+    // Only jobs that haven't started yet can be taken back. Steps of a
+    // sequence only go away along with the rest of the sequence.
+    for (int i = 0; i < queue.count(); i++)
+    {
+        if (queue[i].id == id && queue[i].sequenceID == 0)
+        {
+            queue.removeAt(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+void JobRunner::startNextJob()
+{
+    if (isBusy() || queue.isEmpty() || !connected)
+    {
+        return;
+    }
+
+    QueuedJob next = queue.takeFirst();
+    currentJobID = next.id;
+    currentSequenceID = next.sequenceID;
+    currentJob = next.job;
+    progressTotal = 0;
+    electricalTestFailures.clear();
+    currentJobElapsed.start();
+
+    jobBuffer->close();
+    jobArray.clear();
+
+    if (currentJob.simmCapacity > 0)
+    {
+        p->setSIMMType(currentJob.simmCapacity, currentJob.simmChip);
+    }
+
+    emit jobStarted(currentJobID);
+    if (currentSequenceID)
+    {
+        Sequence &sequence = sequences[currentSequenceID];
+        if (sequence.completedSteps == 0)
+        {
+            // Keep the port open from one step to the next
+            sequence.elapsed.start();
+            p->setSessionMode(true);
+        }
+        emit sequenceStepStarted(currentSequenceID, sequence.completedSteps + 1,
+                                 sequence.totalSteps, currentJob.type);
+    }
+
+    switch (currentJob.type)
+    {
+    case ProgrammerJob::Read:
+        jobBuffer->open(QBuffer::ReadWrite);
+        p->readSIMM(jobBuffer, currentJob.length);
+        break;
+    case ProgrammerJob::Write:
+        jobArray = currentJob.data;
+        jobBuffer->open(QBuffer::ReadOnly);
+        previousVerifyMode = p->verifyMode();
+        p->setVerifyMode(currentJob.verifyMode);
+        p->writeToSIMM(jobBuffer, currentJob.chipMask);
+        break;
+    case ProgrammerJob::WritePortion:
+        jobArray = currentJob.data;
+        jobBuffer->open(QBuffer::ReadOnly);
+        previousVerifyMode = p->verifyMode();
+        p->setVerifyMode(currentJob.verifyMode);
+        p->writeToSIMM(jobBuffer, currentJob.offset, currentJob.length, currentJob.chipMask);
+        break;
+    case ProgrammerJob::Verify:
+        jobBuffer->open(QBuffer::ReadWrite);
+        if (currentJob.length > 0)
+        {
+            p->readSIMM(jobBuffer, currentJob.length, currentJob.offset);
+        }
+        else
+        {
+            p->readSIMM(jobBuffer, currentJob.data.size());
+        }
+        break;
+    case ProgrammerJob::Identify:
+        p->identifySIMMChips();
+        break;
+    case ProgrammerJob::ElectricalTest:
+        p->runElectricalTest();
+        break;
+    case ProgrammerJob::ChecksumVerify:
+        jobBuffer->open(QBuffer::ReadWrite);
+        p->readSIMM(jobBuffer, currentJob.length);
+        break;
+    }
+}
+
+void JobRunner::finishCurrentJob(bool success, QString const &message, QByteArray const &data)
+{
+    const int id = currentJobID;
+    currentJobID = -1;
+    jobBuffer->close();
+    jobArray.clear();
+    if (currentJob.type == ProgrammerJob::Write ||
+        currentJob.type == ProgrammerJob::WritePortion)
+    {
+        p->setVerifyMode(previousVerifyMode);
+    }
+
+    emit jobFinished(id, success, message, data);
+    if (currentSequenceID)
+    {
+        finishSequenceStep(success, message);
+        currentSequenceID = 0;
+    }
+
+    // Let the programmer finish up whatever it was doing when it told us
+    // about this before starting on the next one
+    QTimer::singleShot(0, this, SLOT(startNextJob()));
+}
+
+void JobRunner::finishSequenceStep(bool success, QString const &message)
+{
+    const int sequenceID = currentSequenceID;
+    Sequence &sequence = sequences[sequenceID];
+    sequence.completedSteps++;
+
+    sequence.report.append(QString("%1. %2: %3 (%4 s)\n")
+                           .arg(sequence.completedSteps)
+                           .arg(describe(currentJob.type))
+                           .arg(success ? "OK" : "FAILED")
+                           .arg(currentJobElapsed.elapsed() / 1000.0, 0, 'f', 1));
+    if (!success || currentJob.type == ProgrammerJob::Identify)
+    {
+        // Indent whatever the step had to say underneath it
+        sequence.report.append("   " + QString(message).replace("\n", "\n   ") + "\n");
+    }
+
+    if (success && sequence.completedSteps < sequence.totalSteps)
+    {
+        return;
+    }
+
+    // Either that was the last step, or there's no point in doing the rest
+    for (int i = queue.count() - 1; i >= 0; i--)
+    {
+        if (queue[i].sequenceID == sequenceID)
+        {
+            queue.removeAt(i);
+        }
+    }
+    if (!success && sequence.completedSteps < sequence.totalSteps)
+    {
+        sequence.report.append(QString("Stopped; %1 of %2 steps were not run.\n")
+                               .arg(sequence.totalSteps - sequence.completedSteps)
+                               .arg(sequence.totalSteps));
+    }
+    sequence.report.append(QString("Total time: %1 s").arg(sequence.elapsed.elapsed() / 1000.0, 0, 'f', 1));
+
+    const QString report = sequence.report;
+    p->setSessionMode(sequence.previousSessionMode);
+    sequences.remove(sequenceID);
+    emit sequenceFinished(sequenceID, success, report);
+}
+
+void JobRunner::boardConnected()
+{
+    connected = true;
+    QTimer::singleShot(0, this, SLOT(startNextJob()));
+}
+
+void JobRunner::boardDisconnected()
+{
+    connected = false;
+}
+
+void JobRunner::boardDisconnectedDuringOperation()
+{
+    connected = false;
+    if (isBusy())
+    {
+        finishCurrentJob(false, "Lost contact with the programmer board.");
+    }
+}
+
+void JobRunner::readStatusChanged(ReadStatus status)
+{
+    if (!isBusy() || (currentJob.type != ProgrammerJob::Read &&
+                      currentJob.type != ProgrammerJob::Verify &&
+                      currentJob.type != ProgrammerJob::ChecksumVerify))
+    {
+        return;
+    }
+
+    switch (status)
+    {
+    case ReadStarting:
+        break;
+    case ReadComplete:
+        if (currentJob.type == ProgrammerJob::Verify)
+        {
+            finishVerify();
+        }
+        else if (currentJob.type == ProgrammerJob::ChecksumVerify)
+        {
+            finishChecksumVerify();
+        }
+        else
+        {
+            finishCurrentJob(true, "The read operation finished.", jobArray);
+        }
+        break;
+    case ReadError:
+        finishCurrentJob(false, "An error occurred reading from the SIMM.");
+        break;
+    case ReadCancelled:
+        finishCurrentJob(false, "The read operation was cancelled.");
+        break;
+    case ReadTimedOut:
+        finishCurrentJob(false, "The read operation timed out.");
+        break;
+    }
+}
+
+void JobRunner::finishVerify()
+{
+    const uint32_t start = currentJob.length > 0 ? currentJob.offset : 0;
+    const QByteArray expected = currentJob.length > 0 ?
+                currentJob.data.mid(start, currentJob.length) : currentJob.data;
+    for (int i = 0; i < expected.size(); i++)
+    {
+        if (i >= jobArray.size() || jobArray.at(i) != expected.at(i))
+        {
+            // The chip is the byte lane the mismatch is in
+            const uint32_t offset = start + i;
+            finishCurrentJob(false, QString("The SIMM doesn't match the image, starting at offset 0x%1 (IC%2).")
+                             .arg(offset, 0, 16).arg(4 - (offset % 4)));
+            return;
+        }
+    }
+
+    finishCurrentJob(true, "The SIMM matches the image.");
+}
+
+void JobRunner::finishChecksumVerify()
+{
+    // The checksum was worked out as the data came in
+    ROMChecksum const &checksum = p->readChecksum();
+    uint32_t romLength = 0;
+    uint32_t actualChecksum = 0;
+    if (checksum.checksumMatchesHeader(romLength, actualChecksum))
+    {
+        finishCurrentJob(true, QString("The ROM checksum (%1) matches the header.")
+                         .arg(actualChecksum, 8, 16, QChar('0')));
+    }
+    else
+    {
+        finishCurrentJob(false, QString("The ROM checksum doesn't match the header (%1).")
+                         .arg(checksum.checksumInHeader(), 8, 16, QChar('0')));
+    }
+}
+
+void JobRunner::writeStatusChanged(WriteStatus status)
+{
+    if (!isBusy() || (currentJob.type != ProgrammerJob::Write &&
+                      currentJob.type != ProgrammerJob::WritePortion))
+    {
+        return;
+    }
+
+    switch (status)
+    {
+    // Still going...
+    case WriteErasing:
+    case WriteEraseComplete:
+    case WriteVerifying:
+    case WriteVerifyStarting:
+    case WritePreservingData:
+    case WriteResumeChecking:
+        break;
+
+    case WriteCompleteNoVerify:
+        finishCurrentJob(true, "The write operation finished.");
+        break;
+    case WriteCompleteVerifyOK:
+        finishCurrentJob(true, "The write operation finished, and the contents were verified successfully.");
+        break;
+    case WriteVerificationFailure:
+        finishCurrentJob(false, QString("The data written to the SIMM didn't verify (bad chip mask 0x%1).")
+                         .arg(p->verifyBadChipMask(), 2, 16, QChar('0')));
+        break;
+    case WriteCancelled:
+    case WriteVerifyCancelled:
+        finishCurrentJob(false, "The write operation was cancelled.");
+        break;
+    case WriteTimedOut:
+    case WriteVerifyTimedOut:
+        finishCurrentJob(false, "The write operation timed out.");
+        break;
+    case WriteFileTooBig:
+        finishCurrentJob(false, "The image is too big for the selected SIMM.");
+        break;
+    case WriteNeedsFirmwareUpdateBiggerSIMM:
+    case WriteNeedsFirmwareUpdateVerifyWhileWrite:
+    case WriteNeedsFirmwareUpdateErasePortion:
+    case WriteNeedsFirmwareUpdateIndividualChips:
+        finishCurrentJob(false, "The programmer board needs a firmware update to do this.");
+        break;
+    case WriteEraseFailed:
+        finishCurrentJob(false, "An error occurred erasing the SIMM.");
+        break;
+    case WriteError:
+    case WriteVerifyError:
+    case WriteEraseBlockWrongSize:
+    case WriteResumeMismatch:
+    default:
+        finishCurrentJob(false, "An error occurred writing to the SIMM.");
+        break;
+    }
+}
+
+void JobRunner::identificationStatusChanged(IdentificationStatus status)
+{
+    if (!isBusy() || currentJob.type != ProgrammerJob::Identify)
+    {
+        return;
+    }
+
+    switch (status)
+    {
+    case IdentificationStarting:
+        break;
+    case IdentificationComplete:
+    {
+        QByteArray ids;
+        const QString report = identificationReport(ids);
+        finishCurrentJob(true, report, ids);
+        break;
+    }
+    case IdentificationError:
+        finishCurrentJob(false, "An error occurred identifying the chips on the SIMM.");
+        break;
+    case IdentificationTimedOut:
+        finishCurrentJob(false, "The identification operation timed out.");
+        break;
+    case IdentificationNeedsFirmwareUpdate:
+        finishCurrentJob(false, "The programmer board needs a firmware update to identify this SIMM.");
+        break;
+    }
+}
+
+// Describes what each chip said, and also returns the raw IDs: for each
+// chip, the manufacturer and device ID with the straight unlock sequence,
+// then the same with the shifted one.
+QString JobRunner::identificationReport(QByteArray &ids)
+{
+    QString report;
+    ids.clear();
+    for (int i = 0; i < 4; i++)
+    {
+        uint8_t manufacturerStraight, deviceStraight, manufacturerShifted, deviceShifted;
+        p->getChipIdentity(i, &manufacturerStraight, &deviceStraight, false);
+        p->getChipIdentity(i, &manufacturerShifted, &deviceShifted, true);
+        ids.append(static_cast<char>(manufacturerStraight));
+        ids.append(static_cast<char>(deviceStraight));
+        ids.append(static_cast<char>(manufacturerShifted));
+        ids.append(static_cast<char>(deviceShifted));
+
+        if (!report.isEmpty())
+        {
+            report.append("\n");
+        }
+        report.append(QString("IC%1: %2/%3 (shifted unlock: %4/%5)")
+                      .arg(i + 1)
+                      .arg(manufacturerStraight, 2, 16, QChar('0'))
+                      .arg(deviceStraight, 2, 16, QChar('0'))
+                      .arg(manufacturerShifted, 2, 16, QChar('0'))
+                      .arg(deviceShifted, 2, 16, QChar('0')));
+    }
+    return report;
+}
+
+void JobRunner::electricalTestStatusChanged(ElectricalTestStatus status)
+{
+    if (!isBusy() || currentJob.type != ProgrammerJob::ElectricalTest)
+    {
+        return;
+    }
+
+    switch (status)
+    {
+    case ElectricalTestStarted:
+        break;
+    case ElectricalTestPassed:
+        finishCurrentJob(true, "The electrical test passed successfully.");
+        break;
+    case ElectricalTestFailed:
+        finishCurrentJob(false, "The electrical test failed:\n" + electricalTestFailures);
+        break;
+    case ElectricalTestTimedOut:
+        finishCurrentJob(false, "The electrical test timed out.");
+        break;
+    case ElectricalTestCouldntStart:
+        finishCurrentJob(false, "The electrical test couldn't start.");
+        break;
+    }
+}
+
+void JobRunner::electricalTestFailLocation(uint8_t loc1, uint8_t loc2)
+{
+    if (!isBusy())
+    {
+        return;
+    }
+
+    if (!electricalTestFailures.isEmpty())
+    {
+        electricalTestFailures.append("\n");
+    }
+    electricalTestFailures.append(p->electricalTestPinName(loc1));
+    electricalTestFailures.append(" shorted to ");
+    electricalTestFailures.append(p->electricalTestPinName(loc2));
+}
+
+void JobRunner::totalLengthChanged(uint32_t total)
+{
+    progressTotal = total;
+}
+
+void JobRunner::completionLengthChanged(uint32_t done)
+{
+    if (isBusy())
+    {
+        emit jobProgress(currentJobID, done, progressTotal);
+    }
+}
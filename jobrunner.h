@@ -0,0 +1,139 @@
+#ifndef JOBRUNNER_H
+#define JOBRUNNER_H
+
+#include <QObject>
+#include <QBuffer>
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QList>
+#include <QString>
+#include "programmer.h"
+
+// One thing to do with the programmer, along with everything needed to do it
+// without having to ask anyone anything along the way
+struct ProgrammerJob
+{
+    enum Type
+    {
+        Read,
+        Write,
+        Verify,
+        Identify,
+        ElectricalTest,
+        ChecksumVerify,
+        // Daemon clients send these values, so new types only go at the end
+        WritePortion
+    };
+
+    ProgrammerJob() :
+        type(Identify),
+        simmCapacity(0),
+        simmChip(SIMM_PLCC_x8),
+        chipMask(0x0F),
+        verifyMode(VerifyWhileWriting),
+        offset(0),
+        length(0)
+    {
+    }
+
+    Type type;
+    uint32_t simmCapacity;      // 0 = leave whatever is already selected
+    uint32_t simmChip;
+    uint8_t chipMask;           // Write and WritePortion only
+    VerificationOption verifyMode;  // Write and WritePortion only
+    uint32_t offset;            // WritePortion and Verify only
+    uint32_t length;            // Read: 0 = the entire SIMM; WritePortion and
+                                // Verify: how much from offset (Verify: 0 =
+                                // the whole image)
+    QByteArray data;            // Write, WritePortion and Verify: the image. For
+                                // WritePortion and Verify it's the whole image,
+                                // of which only offset/length is used.
+};
+
+// Runs jobs on a Programmer one after another, in the order they were
+// queued. Jobs wait until a programmer board is connected.
+//
+// A list of jobs can also be queued as a sequence. A sequence keeps the
+// connection to the programmer open the whole way through, stops at the
+// first job that fails, and ends with a report covering every step.
+class JobRunner : public QObject
+{
+    Q_OBJECT
+public:
+    explicit JobRunner(Programmer *programmer, QObject *parent = 0);
+    virtual ~JobRunner();
+
+    int enqueue(ProgrammerJob const &job);
+    int enqueueSequence(QList<ProgrammerJob> const &jobs);
+    bool cancel(int id);
+    bool isBusy() const { return currentJobID >= 0; }
+    int queuedCount() const { return queue.count(); }
+    void setBoardConnected(bool isConnected);
+    Programmer *programmer() const { return p; }
+
+    static QString describe(ProgrammerJob::Type type);
+
+signals:
+    void jobStarted(int id);
+    void jobProgress(int id, uint32_t done, uint32_t total);
+    void jobFinished(int id, bool success, QString message, QByteArray data);
+    void sequenceStepStarted(int sequenceID, int step, int totalSteps, ProgrammerJob::Type type);
+    void sequenceFinished(int sequenceID, bool success, QString report);
+
+private slots:
+    void startNextJob();
+    void boardConnected();
+    void boardDisconnected();
+    void boardDisconnectedDuringOperation();
+
+    void readStatusChanged(ReadStatus status);
+    void writeStatusChanged(WriteStatus status);
+    void identificationStatusChanged(IdentificationStatus status);
+    void electricalTestStatusChanged(ElectricalTestStatus status);
+    void electricalTestFailLocation(uint8_t loc1, uint8_t loc2);
+
+    void totalLengthChanged(uint32_t total);
+    void completionLengthChanged(uint32_t done);
+
+private:
+    struct QueuedJob
+    {
+        int id;
+        int sequenceID;     // 0 if it isn't part of a sequence
+        ProgrammerJob job;
+    };
+
+    struct Sequence
+    {
+        int totalSteps;
+        int completedSteps;
+        bool previousSessionMode;
+        QString report;
+        QElapsedTimer elapsed;
+    };
+
+    void finishCurrentJob(bool success, QString const &message, QByteArray const &data = QByteArray());
+    void finishVerify();
+    void finishChecksumVerify();
+    void finishSequenceStep(bool success, QString const &message);
+    QString identificationReport(QByteArray &ids);
+
+    Programmer *p;
+    QList<QueuedJob> queue;
+    int nextJobID;
+    bool connected;
+
+    int currentJobID;
+    int currentSequenceID;
+    ProgrammerJob currentJob;
+    QElapsedTimer currentJobElapsed;
+    VerificationOption previousVerifyMode;
+    QHash<int, Sequence> sequences;
+    QByteArray jobArray;
+    QBuffer *jobBuffer;
+    uint32_t progressTotal;
+    QString electricalTestFailures;
+};
+
+#endif // JOBRUNNER_H
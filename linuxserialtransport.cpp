@@ -0,0 +1,310 @@
+#include "linuxserialtransport.h"
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QSocketNotifier>
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/serial.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <termios.h>
+#include <unistd.h>
+
+// How long closing the port waits for queued writes to go out
+#define FLUSH_TIMEOUT_MS    1000
+
+LinuxSerialTransport::LinuxSerialTransport(QObject *parent) :
+    ProgrammerTransport(parent),
+    fd(-1),
+    readNotifier(NULL),
+    writeNotifier(NULL),
+    readPos(0)
+{
+}
+
+LinuxSerialTransport::~LinuxSerialTransport()
+{
+    close();
+}
+
+void LinuxSerialTransport::setPortName(QString const &name)
+{
+    portName = name;
+}
+
+bool LinuxSerialTransport::open()
+{
+    if (fd >= 0)
+    {
+        return true;
+    }
+
+    // The port enumerator gives us names like "ttyACM0"
+    const QString path = portName.startsWith('/') ? portName : "/dev/" + portName;
+    fd = ::open(QFile::encodeName(path).constData(), O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0)
+    {
+        qDebug() << "Unable to open" << path << strerror(errno);
+        return false;
+    }
+
+    configureTTY();
+
+    readNotifier = new QSocketNotifier(fd, QSocketNotifier::Read, this);
+    connect(readNotifier, SIGNAL(activated(int)), SLOT(readAvailable()));
+    writeNotifier = new QSocketNotifier(fd, QSocketNotifier::Write, this);
+    writeNotifier->setEnabled(false);
+    connect(writeNotifier, SIGNAL(activated(int)), SLOT(writePending()));
+    return true;
+}
+
+void LinuxSerialTransport::configureTTY()
+{
+    struct termios tio;
+    if (tcgetattr(fd, &tio) == 0)
+    {
+        // No line editing, echo or character translation of any kind. Reads
+        // return whatever is there without waiting for more, which means a
+        // read with nothing waiting returns 0 rather than failing with EAGAIN.
+        cfmakeraw(&tio);
+        tio.c_cflag |= CLOCAL | CREAD;
+        tio.c_cc[VMIN] = 0;
+        tio.c_cc[VTIME] = 0;
+
+        // CDC-ACM doesn't care about the baud rate, but pick something sane
+        cfsetispeed(&tio, B115200);
+        cfsetospeed(&tio, B115200);
+        tcsetattr(fd, TCSANOW, &tio);
+    }
+
+    // Ask the driver to push incoming data up to us right away instead of
+    // batching it. Not every driver supports this, which is fine.
+    struct serial_struct serial;
+    if (ioctl(fd, TIOCGSERIAL, &serial) == 0)
+    {
+        serial.flags |= ASYNC_LOW_LATENCY;
+        ioctl(fd, TIOCSSERIAL, &serial);
+    }
+
+    // Don't let anything left over from before confuse the state machine
+    tcflush(fd, TCIOFLUSH);
+}
+
+void LinuxSerialTransport::close()
+{
+    if (fd < 0)
+    {
+        return;
+    }
+
+    delete readNotifier;
+    readNotifier = NULL;
+    delete writeNotifier;
+    writeNotifier = NULL;
+
+    // Whatever is still queued up was written before the close, so it
+    // should still go out (a command sent right before closing the port,
+    // for example)
+    flushPendingWrites();
+
+    ::close(fd);
+    fd = -1;
+
+    readBuffer.clear();
+    readPos = 0;
+    writeBuffer.clear();
+}
+
+bool LinuxSerialTransport::isOpen() const
+{
+    return fd >= 0;
+}
+
+qint64 LinuxSerialTransport::write(const char *data, qint64 len)
+{
+    if (fd < 0)
+    {
+        return -1;
+    }
+
+    // Keep everything in order if we're already waiting to send something
+    if (!writeBuffer.isEmpty())
+    {
+        writeBuffer.append(data, len);
+        return len;
+    }
+
+    qint64 written = 0;
+    while (written < len)
+    {
+        const ssize_t result = ::write(fd, data + written, len - written);
+        if (result > 0)
+        {
+            written += result;
+        }
+        else if (result < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        else if (result < 0 && errno != EAGAIN && errno != EWOULDBLOCK)
+        {
+            qDebug() << "Error writing to programmer:" << strerror(errno);
+            return written > 0 ? written : -1;
+        }
+        else
+        {
+            // The tty is full. Send the rest when it has room.
+            writeBuffer.append(data + written, len - written);
+            writeNotifier->setEnabled(true);
+            break;
+        }
+    }
+
+    return len;
+}
+
+void LinuxSerialTransport::writePending()
+{
+    while (!writeBuffer.isEmpty())
+    {
+        const ssize_t result = ::write(fd, writeBuffer.constData(), writeBuffer.size());
+        if (result > 0)
+        {
+            writeBuffer.remove(0, result);
+        }
+        else if (result < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        else if (result < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        {
+            // Full again; wait for more room
+            break;
+        }
+        else
+        {
+            // Something went wrong. If the device is gone, Programmer will
+            // find out when the port is removed.
+            qDebug() << "Error writing to programmer:" << strerror(errno);
+            writeBuffer.clear();
+        }
+    }
+
+    writeNotifier->setEnabled(!writeBuffer.isEmpty());
+}
+
+void LinuxSerialTransport::flushPendingWrites()
+{
+    // Don't hang forever if the board has stopped taking data
+    QElapsedTimer timer;
+    timer.start();
+    while (!writeBuffer.isEmpty() && timer.elapsed() < FLUSH_TIMEOUT_MS)
+    {
+        const ssize_t result = ::write(fd, writeBuffer.constData(), writeBuffer.size());
+        if (result > 0)
+        {
+            writeBuffer.remove(0, result);
+        }
+        else if (result < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+        {
+            struct pollfd pfd;
+            pfd.fd = fd;
+            pfd.events = POLLOUT;
+            pfd.revents = 0;
+            poll(&pfd, 1, qMax(0, FLUSH_TIMEOUT_MS - static_cast<int>(timer.elapsed())));
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    if (!writeBuffer.isEmpty())
+    {
+        qDebug() << "Dropping" << writeBuffer.size() << "unsent bytes while closing the programmer port";
+    }
+}
+
+void LinuxSerialTransport::readAvailable()
+{
+    // Start the buffer over once everything in it has been consumed
+    if (readPos >= readBuffer.size())
+    {
+        readBuffer.clear();
+        readPos = 0;
+    }
+
+    bool gotData = false;
+    char buf[4096];
+    for (;;)
+    {
+        const ssize_t result = ::read(fd, buf, sizeof(buf));
+        if (result > 0)
+        {
+            readBuffer.append(buf, result);
+            gotData = true;
+        }
+        else if (result < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        else if (result == 0 || errno == EAGAIN || errno == EWOULDBLOCK)
+        {
+            // Nothing more for now. With VMIN and VTIME both 0, an empty tty
+            // reads as 0 bytes, so that doesn't mean the device is gone. It
+            // only is if the tty says it was hung up.
+            if (!gotData && isHungUp())
+            {
+                stopReading();
+            }
+            break;
+        }
+        else
+        {
+            // EIO or ENXIO once the device has been unplugged
+            qDebug() << "Error reading from programmer:" << strerror(errno);
+            stopReading();
+            break;
+        }
+    }
+
+    if (gotData)
+    {
+        emit readyRead();
+    }
+}
+
+bool LinuxSerialTransport::isHungUp() const
+{
+    struct pollfd pfd;
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    return poll(&pfd, 1, 0) > 0 && (pfd.revents & (POLLHUP | POLLERR | POLLNVAL));
+}
+
+void LinuxSerialTransport::stopReading()
+{
+    // The device went away. Stop listening so we don't spin on it;
+    // Programmer will find out when the port is removed.
+    readNotifier->setEnabled(false);
+}
+
+qint64 LinuxSerialTransport::read(char *data, qint64 maxLen)
+{
+    const qint64 available = readBuffer.size() - readPos;
+    const qint64 len = qMin(available, maxLen);
+    if (len > 0)
+    {
+        memcpy(data, readBuffer.constData() + readPos, len);
+        readPos += len;
+    }
+    return len;
+}
+
+bool LinuxSerialTransport::atEnd() const
+{
+    return readPos >= readBuffer.size();
+}
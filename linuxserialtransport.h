@@ -0,0 +1,52 @@
+#ifndef LINUXSERIALTRANSPORT_H
+#define LINUXSERIALTRANSPORT_H
+
+#include "programmertransport.h"
+
+class QSocketNotifier;
+
+// Talks to the programmer's CDC-ACM tty directly. The tty is put in raw,
+// non-blocking mode with the driver's low latency flag set, so each reply
+// from the board gets to us as soon as it arrives instead of going through
+// QextSerialPort's extra buffering.
+class LinuxSerialTransport : public ProgrammerTransport
+{
+    Q_OBJECT
+public:
+    explicit LinuxSerialTransport(QObject *parent = 0);
+    virtual ~LinuxSerialTransport();
+
+    void setPortName(QString const &name);
+    bool open();
+    void close();
+    bool isOpen() const;
+
+    qint64 write(const char *data, qint64 len);
+    qint64 read(char *data, qint64 maxLen);
+    bool atEnd() const;
+
+private slots:
+    void readAvailable();
+    void writePending();
+
+private:
+    void configureTTY();
+    void flushPendingWrites();
+    bool isHungUp() const;
+    void stopReading();
+
+    QString portName;
+    int fd;
+    QSocketNotifier *readNotifier;
+    QSocketNotifier *writeNotifier;
+
+    // Data that has come in but hasn't been read yet. Reading doesn't
+    // shuffle the buffer around; it just advances readPos.
+    QByteArray readBuffer;
+    int readPos;
+
+    // Data that the tty wasn't ready to accept yet
+    QByteArray writeBuffer;
+};
+
+#endif // LINUXSERIALTRANSPORT_H
@@ -18,11 +18,47 @@
  */
 
 #include <QApplication>
+#include <string.h>
 #include "mainwindow.h"
+#include "programmerdaemon.h"
+
+static void setApplicationNames()
+{
+    // Make default QSettings use these settings
+    QCoreApplication::setOrganizationName("Doug Brown");
+    QCoreApplication::setOrganizationDomain("downtowndougbrown.com");
+    QCoreApplication::setApplicationName("SIMMProgrammer");
+}
+
+// Runs without any UI, taking jobs from other programs over a local socket
+static int runDaemon(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    setApplicationNames();
+
+    Programmer p;
+    ProgrammerDaemon daemon(&p);
+    if (!daemon.listen())
+    {
+        return 1;
+    }
+    p.startCheckingPorts();
+
+    return a.exec();
+}
 
 int main(int argc, char *argv[])
 {
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "--daemon"))
+        {
+            return runDaemon(argc, argv);
+        }
+    }
+
     QApplication a(argc, argv);
+    setApplicationNames();
     MainWindow w;
     w.show();
 
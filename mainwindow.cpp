@@ -20,18 +20,22 @@
 #include "mainwindow.h"
 #include "ui_mainwindow.h"
 #include "programmer.h"
+#include "simmtable.h"
 #include "aboutbox.h"
 #include "fc8compressor.h"
+#include "compressionservice.h"
+#include "fc8sizeestimator.h"
+#include "fc8blocksizeselector.h"
+#include "pipelinedrombuilder.h"
 #include "createblankdiskdialog.h"
 #include <QFileDialog>
 #include <QMessageBox>
 #include <QDebug>
 #include <QSettings>
 #include <QBuffer>
-#include <QThread>
 #include <algorithm>
 #include <QLocale>
-#include <QCryptographicHash>
+#include <QTimer>
 
 static Programmer *p;
 
@@ -40,70 +44,9 @@ static Programmer *p;
 #define verifyWhileWritingKey   "verifyWhileWriting"
 #define selectedEraseSizeKey    "selectedEraseSize"
 #define extendedViewKey         "extendedView"
-
-struct SIMMDesc {
-    uint32_t saveValue;
-    const char *text;
-    uint32_t size;
-    uint32_t chipType;
-};
-
-SIMMDesc simmTable[] ={
-    {0, "128KB (4x 256Kb PLCC)", 128, SIMM_PLCC_x8 },
-    {1, "256KB (4x 512Kb PLCC)", 256, SIMM_PLCC_x8 },
-    {2, "512KB (4x 1Mb PLCC)",   512, SIMM_PLCC_x8 },
-    {3, "1MB (4x 2Mb PLCC)",    1024, SIMM_PLCC_x8 },
-    {4, "2MB (4x 4Mb PLCC)",    2048, SIMM_PLCC_x8 },
-    {8, "2MB (2x 8Mb TSOP)",    2048, SIMM_TSOP_x16},
-    {9, "4MB (4x 8Mb TSOP)",    4096, SIMM_TSOP_x8 },
-    {5, "4MB (2x 16Mb TSOP)",   4096, SIMM_TSOP_x16},
-    {6, "8MB (4x 16Mb TSOP)",   8192, SIMM_TSOP_x8 },
-    {7, "8MB (2x 32Mb TSOP)",   8192, SIMM_TSOP_x16},
-};
-
-static const struct
-{
-    uint32_t checksum;
-    const char *model;
-} romChecksumsAndModels[] = {
-    {0x28BA61CEUL, "128k or 512k"},
-    {0x28BA4E50UL, "128k or 512k"},
-    {0x4D1EEEE1UL, "Plus"},
-    {0x4D1EEAE1UL, "Plus"},
-    {0x4D1F8172UL, "Plus"},
-    {0xB2E362A8UL, "SE"},
-    {0xB306E171UL, "SE FDHD"},
-    {0x9779D2C4UL, "II"},
-    {0x97851DB6UL, "II"},
-    {0x97221136UL, "IIx, IIcx, or SE/30"},
-    {0x368CADFEUL, "IIci"},
-    {0x36B7FB6CUL, "IIsi"},
-    {0x4147DD77UL, "IIfx"},
-    {0x4957EB49UL, "IIvx or IIvi"},
-    {0x49579803UL, "IIvx or IIvi"},
-    {0xA49F9914UL, "Classic"},
-    {0x3193670EUL, "Classic II"},
-    {0xECD99DC0UL, "Color Classic"},
-    {0xEDE66CBDUL, "Color Classic II, LC 550, or TV"},
-    {0xEAF1678DUL, "Color Classic II, LC 550, or TV"},
-    {0x350EACF0UL, "LC"},
-    {0x35C28F5FUL, "LC II"},
-    {0xEC904829UL, "LC III"},
-    {0xECBBC41CUL, "LC III"},
-    {0x064DC91DUL, "LC 580"},
-    {0xF1A6F343UL, "Quadra/Centris 610, 650, or 800"},
-    {0x420DBFF3UL, "Quadra 700 or 900"},
-    {0x3DC27823UL, "Quadra 950"},
-    {0xFF7439EEUL, "Quadra 605, LC 475, or LC 575"},
-    {0x06684214UL, "Quadra 630"},
-    {0x5BF10FD1UL, "Quadra 660av or 840av"},
-    {0x87D3C814UL, "Quadra 660av or 840av"},
-};
-
-static const QByteArray multiFirmwareDelimiter(
-        "\xDB\x00\xDB\x01\xDB\x02\xDB\x03\xDB\x04\xDB\x05\xDB\x06\xDB\x07"
-        "\xDB\x08\xDB\x09\xDB\x0A\xDB\x0B\xDB\x0C\xDB\x0D\xDB\x0E\xDB\x0F"
-        "\xDB\xDB\xDB\xDB\xAA\xAA\xAA\xAA\xDB\xDB\xDB\xDB\x55\x55\x55\x55", 48);
+#define sessionModeKey          "sessionMode"
+#define highCompressionKey      "highCompression"
+#define autoBlockSizeKey        "autoBlockSize"
 
 MainWindow::MainWindow(QWidget *parent) :
     QMainWindow(parent),
@@ -116,10 +59,6 @@ MainWindow::MainWindow(QWidget *parent) :
     activeMessageBox(NULL)
 {
     initializing = true;
-    // Make default QSettings use these settings
-    QCoreApplication::setOrganizationName("Doug Brown");
-    QCoreApplication::setOrganizationDomain("downtowndougbrown.com");
-    QCoreApplication::setApplicationName("SIMMProgrammer");
     QSettings settings;
 
     p = new Programmer();
@@ -136,6 +75,22 @@ MainWindow::MainWindow(QWidget *parent) :
         ui->actionExtended_UI->setChecked(true);
     }
 
+    if (settings.value(sessionModeKey, false).toBool())
+    {
+        p->setSessionMode(true);
+        ui->actionKeep_connection_open->setChecked(true);
+    }
+
+    if (settings.value(highCompressionKey, false).toBool())
+    {
+        ui->actionHigh_compression->setChecked(true);
+    }
+
+    if (settings.value(autoBlockSizeKey, false).toBool())
+    {
+        ui->actionAutomatic_block_size->setChecked(true);
+    }
+
     hideFlashIndividualControls();
     ui->pages->setCurrentWidget(ui->notConnectedPage);
     ui->tabWidget->setCurrentWidget(ui->writeTab);
@@ -143,7 +98,7 @@ MainWindow::MainWindow(QWidget *parent) :
     ui->actionCheck_Firmware_Version->setEnabled(false);
 
     // Fill in the list of SIMM chip capacities (programmer can support anywhere up to 8 MB of space)
-    for (size_t i = 0; i < sizeof(simmTable)/sizeof(simmTable[0]); i++)
+    for (size_t i = 0; i < simmTableCount; i++)
     {
         ui->simmCapacityBox->addItem(simmTable[i].text, QVariant(simmTable[i].saveValue));
     }
@@ -241,12 +196,14 @@ MainWindow::MainWindow(QWidget *parent) :
     connect(p, SIGNAL(writeCompletionLengthChanged(uint32_t)), SLOT(programmerWriteCompletionLengthChanged(uint32_t)));
     connect(p, SIGNAL(writeVerifyTotalLengthChanged(uint32_t)), SLOT(programmerVerifyTotalLengthChanged(uint32_t)));
     connect(p, SIGNAL(writeVerifyCompletionLengthChanged(uint32_t)), SLOT(programmerVerifyCompletionLengthChanged(uint32_t)));
+    connect(p, SIGNAL(writeCheckpoint(uint32_t)), SLOT(programmerWriteCheckpoint(uint32_t)));
     connect(p, SIGNAL(electricalTestStatusChanged(ElectricalTestStatus)), SLOT(programmerElectricalTestStatusChanged(ElectricalTestStatus)));
     connect(p, SIGNAL(electricalTestFailLocation(uint8_t,uint8_t)), SLOT(programmerElectricalTestLocation(uint8_t,uint8_t)));
     connect(p, SIGNAL(readStatusChanged(ReadStatus)), SLOT(programmerReadStatusChanged(ReadStatus)));
     connect(p, SIGNAL(readTotalLengthChanged(uint32_t)), SLOT(programmerReadTotalLengthChanged(uint32_t)));
     connect(p, SIGNAL(readCompletionLengthChanged(uint32_t)), SLOT(programmerReadCompletionLengthChanged(uint32_t)));
     connect(p, SIGNAL(identificationStatusChanged(IdentificationStatus)), SLOT(programmerIdentifyStatusChanged(IdentificationStatus)));
+    connect(p, SIGNAL(identifiedChipsChanged()), SLOT(programmerIdentifiedChipsChanged()));
     connect(p, SIGNAL(firmwareFlashStatusChanged(FirmwareFlashStatus)), SLOT(programmerFirmwareFlashStatusChanged(FirmwareFlashStatus)));
     connect(p, SIGNAL(firmwareFlashTotalLengthChanged(uint32_t)), SLOT(programmerFirmwareFlashTotalLengthChanged(uint32_t)));
     connect(p, SIGNAL(firmwareFlashCompletionLengthChanged(uint32_t)), SLOT(programmerFirmwareFlashCompletionLengthChanged(uint32_t)));
@@ -254,6 +211,25 @@ MainWindow::MainWindow(QWidget *parent) :
     connect(p, SIGNAL(programmerBoardDisconnected()), SLOT(programmerBoardDisconnected()));
     connect(p, SIGNAL(programmerBoardDisconnectedDuringOperation()), SLOT(programmerBoardDisconnectedDuringOperation()));
     connect(p, SIGNAL(readFirmwareVersionStatusChanged(ReadFirmwareVersionStatus,uint32_t)), SLOT(programmerFirmwareVersionStatusChanged(ReadFirmwareVersionStatus,uint32_t)));
+
+    // This has to be hooked up after everything above, so our handlers find
+    // out about a sequence's last step before the runner moves on from it
+    jobRunner = new JobRunner(p, this);
+    connect(jobRunner, SIGNAL(sequenceStepStarted(int,int,int,ProgrammerJob::Type)), SLOT(sequenceStepStarted(int,int,int,ProgrammerJob::Type)));
+    connect(jobRunner, SIGNAL(sequenceFinished(int,bool,QString)), SLOT(sequenceFinished(int,bool,QString)));
+    batchProgrammer = new BatchProgrammer(jobRunner, this);
+    compressionService = new CompressionService(this);
+    sizeEstimateReady = false;
+    sizeEstimateSize = 0;
+    sizeEstimateMargin = 0;
+    romWatcher = new ROMWatcher(this);
+    watchSequenceID = 0;
+    watchSIMMChanged = false;
+    watchCheckingSIMM = false;
+    connect(romWatcher, SIGNAL(rebuilt(QByteArray,QString)), SLOT(watchedROMRebuilt(QByteArray,QString)));
+    connect(romWatcher, SIGNAL(rebuildFailed(QString)), SLOT(watchedROMRebuildFailed(QString)));
+    connect(batchProgrammer, SIGNAL(stateChanged(BatchProgrammer::State)), SLOT(batchStateChanged(BatchProgrammer::State)));
+    connect(batchProgrammer, SIGNAL(unitFinished(int,bool,QString)), SLOT(batchUnitFinished(int,bool,QString)));
     p->startCheckingPorts();
 
     // Set up the multi chip flasher UI -- connect signals
@@ -365,7 +341,7 @@ void MainWindow::on_writeToSIMMButton_clicked()
     doInternalWrite(new QFile(ui->chosenWriteFile->text()));
 }
 
-void MainWindow::doInternalWrite(QIODevice *device)
+void MainWindow::doInternalWrite(QIODevice *device, uint32_t resumeOffset)
 {
     // Ensure we don't think we're in buffer writing/reading mode...we're writing
     // an actual file.
@@ -390,6 +366,11 @@ void MainWindow::doInternalWrite(QIODevice *device)
         delete writeFile;
     }
     writeFile = device;
+
+    // Whatever was on the SIMM won't be after this. If it's a combined ROM,
+    // the caller fills this in afterward.
+    watchFlashedImage.clear();
+    combinedROMBeingWritten.clear();
     if (writeFile)
     {
         if (!writeFile->open(QFile::ReadOnly))
@@ -402,12 +383,31 @@ void MainWindow::doInternalWrite(QIODevice *device)
         resetAndShowStatusPage();
 
         uint howMuchToErase = ui->howMuchToWriteBox->itemData(ui->howMuchToWriteBox->currentIndex()).toUInt();
-        if (howMuchToErase == 0)
+        if (resumeOffset > 0)
         {
+            // The journal is already set up from the write we're resuming
+            p->resumeWriteToSIMM(writeFile, resumeOffset, writeJournal.chipMask());
+        }
+        else if (howMuchToErase == 0)
+        {
+            // Keep track of how far the write gets in case the programmer
+            // gets unplugged partway through. This only works for actual
+            // files, since we need to be able to find the data again later.
+            QFile *file = qobject_cast<QFile *>(writeFile);
+            if (file)
+            {
+                writeJournal.begin(QFileInfo(*file).absoluteFilePath(), WriteJournal::hashDevice(file),
+                                   p->SIMMCapacity(), p->SIMMChip(), 0x0F);
+            }
+            else
+            {
+                writeJournal.clear();
+            }
             p->writeToSIMM(writeFile);
         }
         else
         {
+            writeJournal.clear();
             p->writeToSIMM(writeFile, 0, qMin(howMuchToErase, p->SIMMCapacity()));
         }
         qDebug() << "Writing to SIMM...";
@@ -495,6 +495,45 @@ void MainWindow::on_createROMGroupBox_fileDropped(const QString &filePath)
 
 void MainWindow::programmerWriteStatusChanged(WriteStatus newStatus)
 {
+    // Steps of a production sequence are reported by the job runner instead
+    if (jobRunner->isBusy()) { return; }
+
+    // Once a write has made it all the way through (or failed in a way that
+    // resuming it wouldn't help), there's nothing left to resume. Errors and
+    // timeouts partway through keep the journal around.
+    switch (newStatus)
+    {
+    case WriteCompleteNoVerify:
+    case WriteCompleteVerifyOK:
+    case WriteVerificationFailure:
+    case WriteVerifyError:
+    case WriteVerifyCancelled:
+    case WriteVerifyTimedOut:
+    case WriteCancelled:
+    case WriteEraseFailed:
+    case WriteFileTooBig:
+    case WriteResumeMismatch:
+        writeJournal.clear();
+        break;
+    default:
+        break;
+    }
+
+    // A combined ROM written while it was compressing still needs its block
+    // table filled in before it's really done
+    if ((newStatus == WriteCompleteNoVerify || newStatus == WriteCompleteVerifyOK) &&
+        startBlockTablePatch())
+    {
+        return;
+    }
+
+    // Watch mode can start from whatever combined ROM made it onto the SIMM
+    if (newStatus == WriteCompleteNoVerify || newStatus == WriteCompleteVerifyOK)
+    {
+        watchFlashedImage = combinedROMBeingWritten;
+        combinedROMBeingWritten.clear();
+    }
+
     switch (newStatus)
     {
     case WriteErasing:
@@ -507,6 +546,29 @@ void MainWindow::programmerWriteStatusChanged(WriteStatus newStatus)
             ui->statusLabel->setText("Erasing SIMM (this may take a few seconds)...");
         }
         break;
+    case WritePreservingData:
+        ui->statusLabel->setText("Reading existing data to keep around the area being written...");
+        break;
+    case WriteResumeChecking:
+        ui->statusLabel->setText("Checking what was already written before picking up where the write left off...");
+        break;
+    case WriteResumeMismatch:
+        if (writeFile)
+        {
+            writeFile->close();
+            delete writeFile;
+            writeFile = NULL;
+        }
+
+        returnToControlPage();
+        showMessageBox(QMessageBox::Warning, "Unable to resume write", "The data already on the SIMM doesn't match the file being written, so the write can't pick up where it left off. Please write the file again from the beginning.");
+        if (writeBuffer)
+        {
+            writeBuffer->close();
+            delete writeBuffer;
+            writeBuffer = NULL;
+        }
+        break;
     case WriteCompleteNoVerify:
         if (writeFile)
         {
@@ -516,7 +578,7 @@ void MainWindow::programmerWriteStatusChanged(WriteStatus newStatus)
         }
 
         returnToControlPage();
-        showMessageBox(QMessageBox::Information, "Write complete", "The write operation finished.");
+        showMessageBox(QMessageBox::Information, "Write complete", "The write operation finished." + recoverySummary());
         if (writeBuffer)
         {
             writeBuffer->close();
@@ -533,7 +595,7 @@ void MainWindow::programmerWriteStatusChanged(WriteStatus newStatus)
         }
 
         returnToControlPage();
-        showMessageBox(QMessageBox::Information, "Write complete", "The write operation finished, and the contents were verified successfully.");
+        showMessageBox(QMessageBox::Information, "Write complete", "The write operation finished, and the contents were verified successfully." + recoverySummary());
         if (writeBuffer)
         {
             writeBuffer->close();
@@ -802,6 +864,15 @@ void MainWindow::programmerWriteCompletionLengthChanged(uint32_t len)
     ui->progressBar->setValue((int)len);
 }
 
+void MainWindow::programmerWriteCheckpoint(uint32_t offset)
+{
+    // Writes of individual chips don't get journaled
+    if (writeFile)
+    {
+        writeJournal.checkpoint(offset);
+    }
+}
+
 void MainWindow::programmerVerifyTotalLengthChanged(uint32_t totalLen)
 {
     ui->progressBar->setMaximum((int)totalLen);
@@ -821,6 +892,9 @@ void MainWindow::on_electricalTestButton_clicked()
 
 void MainWindow::programmerElectricalTestStatusChanged(ElectricalTestStatus newStatus)
 {
+    // Steps of a production sequence are reported by the job runner instead
+    if (jobRunner->isBusy()) { return; }
+
     switch (newStatus)
     {
     case ElectricalTestStarted:
@@ -861,6 +935,9 @@ void MainWindow::programmerElectricalTestLocation(uint8_t loc1, uint8_t loc2)
 
 void MainWindow::programmerReadStatusChanged(ReadStatus newStatus)
 {
+    // Steps of a production sequence are reported by the job runner instead
+    if (jobRunner->isBusy()) { return; }
+
     switch (newStatus)
     {
     case ReadStarting:
@@ -887,8 +964,15 @@ void MainWindow::programmerReadStatusChanged(ReadStatus newStatus)
         }
         else
         {
-            // Normal reads just show a message box
-            showMessageBox(QMessageBox::Information, "Read complete", "The read operation finished.");
+            // Normal reads just show a message box, along with whatever we
+            // figured out about the ROM's checksum while it was being read
+            QString message = "The read operation finished." + recoverySummary();
+            QString checksumSummary = readChecksumSummary();
+            if (!checksumSummary.isEmpty())
+            {
+                message += "\n\n" + checksumSummary;
+            }
+            showMessageBox(QMessageBox::Information, "Read complete", message);
         }
         if (readBuffer)
         {
@@ -979,6 +1063,9 @@ void MainWindow::programmerReadCompletionLengthChanged(uint32_t len)
 
 void MainWindow::programmerIdentifyStatusChanged(IdentificationStatus newStatus)
 {
+    // Steps of a production sequence are reported by the job runner instead
+    if (jobRunner->isBusy()) { return; }
+
     switch (newStatus)
     {
     case IdentificationStarting:
@@ -1103,7 +1190,7 @@ void MainWindow::programmerIdentifyStatusChanged(IdentificationStatus newStatus)
 
                     // Find a matching item in the dropdown
                     bool foundMatch = false;
-                    for (size_t i = 0; i < sizeof(simmTable)/sizeof(simmTable[0]); i++)
+                    for (size_t i = 0; i < simmTableCount; i++)
                     {
                         QString displayName(simmTable[i].text);
                         if (displayName.contains(chipConfigDetail))
@@ -1143,14 +1230,7 @@ void MainWindow::programmerIdentifyStatusChanged(IdentificationStatus newStatus)
                         (static_cast<uint32_t>(manufacturersStraight[3]) << 24);
 
                 // See if we find a matching standard Mac ROM checksum in our internal database
-                for (size_t i = 0; i < sizeof(romChecksumsAndModels) / sizeof(romChecksumsAndModels[0]); i++)
-                {
-                    if (romChecksumsAndModels[i].checksum == possibleRomChecksum)
-                    {
-                        macModel = romChecksumsAndModels[i].model;
-                        break;
-                    }
-                }
+                macModel = ROMChecksum::modelForChecksum(possibleRomChecksum);
             }
 
             if (!macModel.isEmpty())
@@ -1283,19 +1363,27 @@ void MainWindow::programmerBoardConnected()
     returnToControlPage();
     ui->actionUpdate_firmware->setEnabled(true);
     ui->actionCheck_Firmware_Version->setEnabled(true);
+
+    // Wait until we're done handling the connection before asking anything
+    QTimer::singleShot(0, this, SLOT(offerWriteResume()));
 }
 
 void MainWindow::programmerBoardDisconnected()
 {
-    // If a message box currently visible, dismiss it
+    // If a message box currently visible, dismiss it. If it was offering to
+    // resume a write, that's still on offer when the board comes back.
     if (activeMessageBox)
     {
+        disconnect(activeMessageBox, SIGNAL(finished(int)), this, SLOT(writeResumeAnswered(int)));
         activeMessageBox->close();
         messageBoxFinished();
     }
     ui->pages->setCurrentWidget(ui->notConnectedPage);
     ui->actionUpdate_firmware->setEnabled(false);
     ui->actionCheck_Firmware_Version->setEnabled(false);
+
+    // A different SIMM could be in there by the time it's back
+    forgetSIMMContents();
 }
 
 void MainWindow::programmerBoardDisconnectedDuringOperation()
@@ -1303,6 +1391,7 @@ void MainWindow::programmerBoardDisconnectedDuringOperation()
     ui->pages->setCurrentWidget(ui->notConnectedPage);
     ui->actionUpdate_firmware->setEnabled(false);
     ui->actionCheck_Firmware_Version->setEnabled(false);
+    forgetSIMMContents();
     // Make sure any files have been closed if we were in the middle of something.
     if (writeFile)
     {
@@ -1316,7 +1405,66 @@ void MainWindow::programmerBoardDisconnectedDuringOperation()
         delete readFile;
         readFile = NULL;
     }
-    showMessageBox(QMessageBox::Warning, "Programmer lost connection", "Lost contact with the programmer board. Unplug it, plug it back in, and try again.");
+    if (writeJournal.isActive() && writeJournal.checkpointOffset() > 0)
+    {
+        showMessageBox(QMessageBox::Warning, "Programmer lost connection", "Lost contact with the programmer board. Unplug it and plug it back in, and you'll be able to pick the write back up where it left off.");
+    }
+    else
+    {
+        showMessageBox(QMessageBox::Warning, "Programmer lost connection", "Lost contact with the programmer board. Unplug it, plug it back in, and try again.");
+    }
+}
+
+void MainWindow::offerWriteResume()
+{
+    // Don't interrupt anything, and only bother if a write actually got
+    // somewhere before it was interrupted
+    if (activeMessageBox || ui->pages->currentWidget() == ui->statusPage ||
+        !writeJournal.load() || writeJournal.checkpointOffset() == 0)
+    {
+        return;
+    }
+
+    // The same kind of SIMM has to be selected. If it isn't, leave the
+    // journal alone in case they plug in again after fixing it.
+    if (writeJournal.simmCapacity() != p->SIMMCapacity() ||
+        writeJournal.simmChip() != p->SIMMChip())
+    {
+        return;
+    }
+
+    // Make sure the file hasn't changed since we started writing it
+    QFile file(writeJournal.sourcePath());
+    if (!file.open(QFile::ReadOnly) ||
+        WriteJournal::hashDevice(&file) != writeJournal.imageHash())
+    {
+        writeJournal.clear();
+        return;
+    }
+    file.close();
+
+    // Same as showMessageBox(), so it goes away if the board does
+    const QString question = QString("Writing %1 to the SIMM was interrupted after %2 had been written. "
+                                     "Do you want to pick up where it left off?")
+            .arg(QFileInfo(file).fileName())
+            .arg(displayableFileSize(writeJournal.checkpointOffset()));
+    activeMessageBox = new QMessageBox(QMessageBox::Question, "Resume write?", question,
+                                       QMessageBox::Yes | QMessageBox::No, this);
+    connect(activeMessageBox, SIGNAL(finished(int)), this, SLOT(writeResumeAnswered(int)));
+    connect(activeMessageBox, SIGNAL(finished(int)), this, SLOT(messageBoxFinished()));
+    activeMessageBox->setModal(true);
+    activeMessageBox->open();
+}
+
+void MainWindow::writeResumeAnswered(int button)
+{
+    if (button != QMessageBox::Yes)
+    {
+        writeJournal.clear();
+        return;
+    }
+
+    doInternalWrite(new QFile(writeJournal.sourcePath()), writeJournal.checkpointOffset());
 }
 
 void MainWindow::resetAndShowStatusPage()
@@ -1332,6 +1480,7 @@ void MainWindow::resetAndShowStatusPage()
 void MainWindow::on_simmCapacityBox_currentIndexChanged(int index)
 {
     p->setSIMMType(simmTable[index].size*1024, simmTable[index].chipType);
+    forgetSIMMContents();
     QSettings settings;
     if (!initializing)
     {
@@ -1340,6 +1489,12 @@ void MainWindow::on_simmCapacityBox_currentIndexChanged(int index)
         uint32_t saveValue = static_cast<uint32_t>(ui->simmCapacityBox->itemData(index).toUInt());
         settings.setValue(selectedCapacityKey, saveValue);
 
+        // The automatically chosen block size depends on how much room there is
+        if (ui->actionAutomatic_block_size->isChecked())
+        {
+            compressedImageFileHash.clear();
+        }
+
         // This can affect the error status of the ROM creation section
         updateCreateROMControlStatus();
     }
@@ -1769,6 +1924,8 @@ void MainWindow::on_multiFlashChipsButton_clicked()
     // and write it!
     resetAndShowStatusPage();
     writeBuffer->seek(0);
+    watchFlashedImage.clear();
+    combinedROMBeingWritten.clear();
     p->writeToSIMM(writeBuffer, chipsMask);
 }
 
@@ -1944,29 +2101,19 @@ void MainWindow::on_verifyROMChecksumButton_clicked()
 
 void MainWindow::finishChecksumVerify()
 {
-    QByteArray const &bufferBytes = checksumVerifyBuffer->buffer();
+    // The programmer calculated the checksum as the data was being read,
+    // so all we have to do here is interpret it.
+    ROMChecksum const &romChecksum = p->readChecksum();
 
-    if (bufferBytes.length() < 0x44)
+    if (!romChecksum.hasHeader())
     {
         showMessageBox(QMessageBox::Warning, "Checksum verify error", "The programmer was unable to read enough data to verify the checksum.");
         return;
     }
 
-    // Pull out the checksum
-    uint32_t checksumInROM = 0;
-    checksumInROM |= static_cast<uint8_t>(bufferBytes.at(0x0)) << 24;
-    checksumInROM |= static_cast<uint8_t>(bufferBytes.at(0x1)) << 16;
-    checksumInROM |= static_cast<uint8_t>(bufferBytes.at(0x2)) << 8;
-    checksumInROM |= static_cast<uint8_t>(bufferBytes.at(0x3)) << 0;
-
-    // Pull out the length
-    uint32_t romLength = 0;
-    romLength |= static_cast<uint8_t>(bufferBytes.at(0x40)) << 24;
-    romLength |= static_cast<uint8_t>(bufferBytes.at(0x41)) << 16;
-    romLength |= static_cast<uint8_t>(bufferBytes.at(0x42)) << 8;
-    romLength |= static_cast<uint8_t>(bufferBytes.at(0x43)) << 0;
-
-    uint8_t romVersion = static_cast<uint8_t>(bufferBytes.at(0x09));
+    const uint32_t checksumInROM = romChecksum.checksumInHeader();
+    uint32_t romLength = romChecksum.lengthInHeader();
+    const uint8_t romVersion = romChecksum.romVersion();
 
     // ROM versions up to 0x78 don't have the ROM length embedded.
     // It's unclear whether ROM 0x79 has the ROM length embedded or not.
@@ -1979,7 +2126,7 @@ void MainWindow::finishChecksumVerify()
         uint32_t tmpChecksum;
         for (uint32_t tmpLen = 64*1024; tmpLen <= 512*1024; tmpLen *= 2)
         {
-            if (calculateROMChecksum(bufferBytes, tmpLen, tmpChecksum) && (tmpChecksum == checksumInROM))
+            if (romChecksum.checksumForLength(tmpLen, tmpChecksum) && (tmpChecksum == checksumInROM))
             {
                 romLength = tmpLen;
                 break;
@@ -2001,7 +2148,7 @@ void MainWindow::finishChecksumVerify()
                        .arg(displayableFileSize(romLength)));
         return;
     }
-    else if (static_cast<uint32_t>(bufferBytes.length()) < romLength)
+    else if (romChecksum.bytesProcessed() < romLength)
     {
         showMessageBox(QMessageBox::Warning, "Checksum verify error",
                        QString("According to the ROM header, this is a %1 ROM. Make sure you are reading at least that much data in order to verify the checksum.")
@@ -2010,7 +2157,7 @@ void MainWindow::finishChecksumVerify()
     }
 
     uint32_t actualChecksum = 0;
-    if (calculateROMChecksum(bufferBytes, romLength, actualChecksum) && (actualChecksum == checksumInROM))
+    if (romChecksum.checksumForLength(romLength, actualChecksum) && (actualChecksum == checksumInROM))
     {
         QString checksumInROMString = QString("%1").arg(checksumInROM, 8, 16, QChar('0')).toUpper();
         QString finalMessage = QString("The checksum of this ROM image comes out correct. The checksum is %1.\n\n")
@@ -2030,13 +2177,10 @@ void MainWindow::finishChecksumVerify()
         }
 
         // Go ahead and identify it by checksum, if we can.
-        for (size_t i = 0; i < sizeof(romChecksumsAndModels) / sizeof(romChecksumsAndModels[0]); i++)
+        const char *model = ROMChecksum::modelForChecksum(actualChecksum);
+        if (model)
         {
-            if (romChecksumsAndModels[i].checksum == actualChecksum)
-            {
-                finalMessage += QString("\n\nThis appears to be a standard Macintosh %1 ROM image.").arg(romChecksumsAndModels[i].model);
-                break;
-            }
+            finalMessage += QString("\n\nThis appears to be a standard Macintosh %1 ROM image.").arg(model);
         }
 
         showMessageBox(QMessageBox::Information, "Checksum matches", finalMessage);
@@ -2044,7 +2188,8 @@ void MainWindow::finishChecksumVerify()
     else
     {
         // This *might* not be an error. The ROM might be patched.
-        if (identifyBaseROM(&bufferBytes) != BaseROMUnknown)
+        QByteArray const &bufferBytes = checksumVerifyBuffer->buffer();
+        if (identifyBaseROM(&bufferBytes) != ROMBuilder::BaseROMUnknown)
         {
             QString finalMessage = QString("The checksum in this ROM does not match. However, it appears to be a patched ROM, so it's normal for the checksum to not match.\n\nAccording to the ROM header, it is a %1 ROM.")
                     .arg(displayableFileSize(romLength));
@@ -2065,24 +2210,49 @@ void MainWindow::finishChecksumVerify()
     }
 }
 
-bool MainWindow::calculateROMChecksum(const QByteArray &rom, uint32_t len, uint32_t &checksum)
+QString MainWindow::readChecksumSummary()
 {
-    if (static_cast<uint32_t>(rom.length()) < len)
+    ROMChecksum const &romChecksum = p->readChecksum();
+    if (!romChecksum.hasHeader())
     {
-        return false;
+        return QString();
+    }
+
+    QString summary;
+    uint32_t romLength = 0;
+    uint32_t actualChecksum = 0;
+    if (romChecksum.checksumMatchesHeader(romLength, actualChecksum))
+    {
+        summary = QString("The ROM checksum (%1) matches the header for a %2 ROM.")
+                .arg(QString("%1").arg(actualChecksum, 8, 16, QChar('0')).toUpper())
+                .arg(displayableFileSize(romLength));
+
+        const char *model = ROMChecksum::modelForChecksum(actualChecksum);
+        if (model)
+        {
+            summary += QString(" This appears to be a standard Macintosh %1 ROM image.").arg(model);
+        }
+    }
+    else
+    {
+        summary = "The data read doesn't have a matching Mac ROM checksum. This is normal for patched ROMs or data that isn't a Mac ROM.";
     }
 
-    // Now calculate the checksum
-    checksum = 0;
-    for (uint32_t i = 4; i < len; i += 2)
+    summary += QString("\n\n%1: %2").arg(ROMChecksum::hashName()).arg(QString(romChecksum.hash().toHex()));
+    return summary;
+}
+
+QString MainWindow::recoverySummary()
+{
+    OperationTelemetry const &telemetry = p->operationTelemetry();
+    const int retries = telemetry.readRetries + telemetry.writeRetries;
+    if (retries == 0)
     {
-        uint16_t thisWord = 0;
-        thisWord |= static_cast<uint8_t>(rom.at(i + 0)) << 8;
-        thisWord |= static_cast<uint8_t>(rom.at(i + 1)) << 0;
-        checksum += thisWord;
+        return QString();
     }
 
-    return true;
+    return QString(" It recovered from %1 transfer error%2 along the way.")
+            .arg(retries).arg(retries == 1 ? "" : "s");
 }
 
 void MainWindow::returnToControlPage()
@@ -2162,13 +2332,42 @@ void MainWindow::updateCreateROMControlStatus()
         bool supportsCompression = checkBaseROMCompressionSupport();
         bool shouldCompress = supportsCompression && !alreadyCompressed;
         error = false;
-        if (shouldCompress &&
-            !FC8Compressor::hashMatchesFile(compressedImageFileHash, uncompressedImage))
-        {
-            ui->createROMErrorText->setText("Compressing...");
+        const QByteArray imageHash = shouldCompress ? FC8Compressor::hashOf(uncompressedImage) : QByteArray();
+        if (shouldCompress && imageHash != compressedImageFileHash)
+        {
+            // Compressing the whole thing takes a while, so start with a quick
+            // estimate from a sample of blocks. The real size replaces it once
+            // the compression finishes. Even the estimate can take a moment
+            // in high compression mode, so it happens in the background too.
+            if (!startSizeEstimate(uncompressedImage, imageHash))
+            {
+                ui->createROMErrorText->setText("Compressing... Estimating the total ROM size...");
+            }
+            else
+            {
+                const qint64 baseROMSize = QFileInfo(ui->chosenBaseROMFile->text()).size();
+                const qint64 simmSize = simmTable[ui->simmCapacityBox->currentIndex()].size * 1024;
+                const qint64 estimatedSize = baseROMSize + sizeEstimateSize;
+                QString fitText;
+                if (estimatedSize + sizeEstimateMargin <= simmSize)
+                {
+                    fitText = "should fit";
+                }
+                else if (estimatedSize - sizeEstimateMargin > simmSize)
+                {
+                    fitText = "probably too large";
+                }
+                else
+                {
+                    fitText = "might not fit";
+                }
+                ui->createROMErrorText->setText("Compressing... Estimated Total ROM Size: " +
+                                                displayableFileSize(estimatedSize) + " +/- " +
+                                                displayableFileSize(sizeEstimateMargin) + " (" + fitText + ")");
+            }
 
             // Run the compression in the background. When it completes, this will re-run.
-            compressImageInBackground(uncompressedImage, false);
+            compressImageInBackground(uncompressedImage, false, imageHash);
 
             // While it's compressing, we can't allow writing/saving
             ui->writeCombinedFileToSIMMButton->setEnabled(false);
@@ -2183,7 +2382,7 @@ void MainWindow::updateCreateROMControlStatus()
             ui->writeCombinedFileToSIMMButton->setEnabled(false);
             ui->saveCombinedFileButton->setEnabled(false);
         }
-        else if (identifyBaseROM() == BaseROMbbraun2MB && uncompressedImage.length() > 1572864)
+        else if (identifyBaseROM() == ROMBuilder::BaseROMbbraun2MB && uncompressedImage.length() > 1572864)
         {
             ui->createROMErrorText->setText("This base ROM only supports disk images " + QLocale(QLocale::English).toString(1572864) + " bytes or less in size.");
             error = true;
@@ -2227,6 +2426,7 @@ void MainWindow::updateCreateROMControlStatus()
             }
 
             ui->createROMErrorText->setText("Total ROM Size: " + prettySize);
+            ui->createROMErrorText->setToolTip(shouldCompress ? compressionCandidates : QString());
         }
     }
     else
@@ -2304,44 +2504,12 @@ bool MainWindow::checkBaseROMValidity(QString &errorText)
 
 bool MainWindow::checkBaseROMCompressionSupport()
 {
-    // This string shows up in custom ROMs that support compression
-    return unpatchedBaseROM().contains(" block-compressed disk image");
+    return ROMBuilder::supportsCompression(unpatchedBaseROM());
 }
 
-MainWindow::KnownBaseROM MainWindow::identifyBaseROM(QByteArray const *baseROMToCheck)
+ROMBuilder::KnownBaseROM MainWindow::identifyBaseROM(QByteArray const *baseROMToCheck)
 {
-    QByteArray baseROM = !baseROMToCheck ? unpatchedBaseROM() : *baseROMToCheck;
-    if (baseROM.length() < 0x51DC4)
-    {
-        return BaseROMUnknown;
-    }
-
-    if (baseROM.contains("Garrett's Workshop ROM Disk"))
-    {
-        return BaseROMGarrettsWorkshop;
-    }
-    else if (baseROM.contains(" block-compressed disk image"))
-    {
-        return BaseROMBMOW;
-    }
-    // Look for a known byte pattern in bbraun's ROM disk driver
-    else if (baseROM.at(0x51DC0) == static_cast<char>(0x4E) &&
-             baseROM.at(0x51DC1) == static_cast<char>(0xBA) &&
-             baseROM.at(0x51DC2) == static_cast<char>(0x04) &&
-             baseROM.at(0x51DC3) == static_cast<char>(0xDC))
-    {
-        return BaseROMbbraun8MB;
-    }
-    // The pattern is slightly different in the 2 MB version
-    else if (baseROM.at(0x51DC0) == static_cast<char>(0x4E) &&
-             baseROM.at(0x51DC1) == static_cast<char>(0xBA) &&
-             baseROM.at(0x51DC2) == static_cast<char>(0x03) &&
-             baseROM.at(0x51DC3) == static_cast<char>(0x02))
-    {
-        return BaseROMbbraun2MB;
-    }
-
-    return BaseROMUnknown;
+    return ROMBuilder::identify(!baseROMToCheck ? unpatchedBaseROM() : *baseROMToCheck);
 }
 
 bool MainWindow::checkDiskImageValidity(QString &errorText, bool &alreadyCompressed)
@@ -2406,49 +2574,127 @@ bool MainWindow::checkDiskImageValidity(QString &errorText, bool &alreadyCompres
 
 bool MainWindow::isCompressedDiskImage(const QByteArray &image)
 {
-    // Look for start of FC8b or FC8_
-    return image.length() >= 4 && image.at(0) == 'F' &&
-        image.at(1) == 'C' && image.at(2) == '8' &&
-        (image.at(3) == 'b' || image.at(3) == '_');
+    return ROMBuilder::isCompressedDiskImage(image);
 }
 
-void MainWindow::compressImageInBackground(QByteArray uncompressedImage, bool blockUntilCompletion)
+CompressionJob *MainWindow::compressImageInBackground(const QByteArray &uncompressedImage, bool blockUntilCompletion,
+                                                      const QByteArray &hashOfImage)
 {
-    // Set up a thread to do the compression in the background. It can take a few seconds.
-    QThread *compressionThread = new QThread();
-    FC8Compressor *compressor = new FC8Compressor(uncompressedImage, 65536);
-    compressor->moveToThread(compressionThread);
-    // When the compression finishes, save it in this object. Just doing this to make use of
-    // cross-thread signal functionality.
-    connect(compressor, SIGNAL(compressionFinished(QByteArray,QByteArray)), this, SLOT(compressorThreadFinished(QByteArray,QByteArray)));
-    // When the compression finishes, delete the compressor
-    connect(compressor, SIGNAL(compressionFinished(QByteArray,QByteArray)), compressor, SLOT(deleteLater()));
-    // When the compressor is destroyed, stop the thread
-    connect(compressor, SIGNAL(destroyed()), compressionThread, SLOT(quit()));
-    // When the thread starts, start the compressor
-    connect(compressionThread, SIGNAL(started()), compressor, SLOT(doCompression()));
-    // When the thread stops, it should destroy itself
-    connect(compressionThread, SIGNAL(finished()), compressionThread, SLOT(deleteLater()));
+    const FC8Compressor::Mode mode = ui->actionHigh_compression->isChecked() ?
+                FC8Compressor::HighRatioMode : FC8Compressor::FastMode;
+    CompressionJob *job;
+    if (ui->actionAutomatic_block_size->isChecked())
+    {
+        // Try all the block sizes and use the one that fits and is quickest
+        // for the ROM to decompress
+        const qint64 simmSize = simmTable[ui->simmCapacityBox->currentIndex()].size * 1024;
+        const qint64 availableSpace = simmSize - QFileInfo(ui->chosenBaseROMFile->text()).size();
+        job = compressionService->compress(uncompressedImage, CompressionService::AutomaticBlockSize,
+                                           mode, availableSpace, hashOfImage);
+    }
+    else
+    {
+        job = compressionService->compress(uncompressedImage, 65536, mode, 0, hashOfImage);
+    }
+
+    if (job != compressionJob)
+    {
+        // Whatever was compressing before is out of date now
+        if (compressionJob)
+        {
+            compressionJob->cancel();
+        }
+        compressionJob = job;
+        connect(job, SIGNAL(finished()), this, SLOT(compressionJobFinished()), Qt::UniqueConnection);
 
-    compressionThread->start();
+        // An earlier compression of the same thing might already be done.
+        // It won't send finished() again, so check back once we're out of
+        // whatever called us.
+        if (job->isFinished())
+        {
+            QTimer::singleShot(0, this, SLOT(compressionJobFinished()));
+        }
+    }
 
-    if (blockUntilCompletion)
+    if (blockUntilCompletion && !job->isFinished())
     {
         QWidget *prevPage = ui->pages->currentWidget();
-        ui->progressBar->setRange(0, 0);
+        ui->progressBar->setRange(0, job->progressMaximum());
+        ui->progressBar->setValue(job->progressValue());
         ui->statusLabel->setText("Compressing disk image...");
         ui->pages->setCurrentWidget(ui->statusPage);
 
         // Block until the compression is complete, showing a progress bar
-        while (!compressionThread->isFinished() ||
-               !FC8Compressor::hashMatchesFile(compressedImageFileHash, uncompressedImage))
-        {
-            qApp->processEvents();
-        }
+        connect(job, SIGNAL(progressChanged(int,int)), this, SLOT(compressionProgressChanged(int,int)));
+        job->waitForFinished();
+        disconnect(job, SIGNAL(progressChanged(int,int)), this, SLOT(compressionProgressChanged(int,int)));
 
         // Restore the page we were on before
         ui->pages->setCurrentWidget(prevPage);
     }
+
+    return job;
+}
+
+// The block size the estimate should assume. With automatic block sizes,
+// it's the biggest candidate: that's the one that compresses best, so if
+// even that won't fit, nothing will.
+int MainWindow::sizeEstimateBlockSize()
+{
+    if (ui->actionAutomatic_block_size->isChecked())
+    {
+        const QList<int> candidates = FC8BlockSizeSelector::candidateBlockSizes();
+        return *std::max_element(candidates.begin(), candidates.end());
+    }
+    return 65536;
+}
+
+QByteArray MainWindow::sizeEstimateKeyFor(const QByteArray &hashOfImage, int blockSize, FC8Compressor::Mode mode)
+{
+    return hashOfImage + ":" + QByteArray::number(blockSize) + ":" + QByteArray::number(static_cast<int>(mode));
+}
+
+// Returns true if the estimate for this image and the current settings is
+// ready. Otherwise it gets started (unless it already has been), and
+// updateCreateROMControlStatus() runs again once it's done.
+bool MainWindow::startSizeEstimate(const QByteArray &uncompressedImage, const QByteArray &hashOfImage)
+{
+    const FC8Compressor::Mode mode = ui->actionHigh_compression->isChecked() ?
+                FC8Compressor::HighRatioMode : FC8Compressor::FastMode;
+    const int blockSize = sizeEstimateBlockSize();
+    const QByteArray key = sizeEstimateKeyFor(hashOfImage, blockSize, mode);
+    if (key == sizeEstimateKey)
+    {
+        return sizeEstimateReady;
+    }
+
+    sizeEstimateKey = key;
+    sizeEstimateReady = false;
+    FC8SizeEstimateWorker *worker = new FC8SizeEstimateWorker(key, uncompressedImage, blockSize, mode);
+    connect(worker, SIGNAL(estimateFinished(QByteArray,qint64,qint64)), this, SLOT(sizeEstimateFinished(QByteArray,qint64,qint64)));
+    worker->start();
+    return false;
+}
+
+void MainWindow::sizeEstimateFinished(QByteArray key, qint64 size, qint64 margin)
+{
+    // Only the newest one matters
+    if (key != sizeEstimateKey)
+    {
+        return;
+    }
+
+    sizeEstimateReady = true;
+    sizeEstimateSize = size;
+    sizeEstimateMargin = margin;
+    updateCreateROMControlStatus();
+}
+
+void MainWindow::applyCompressionJob(CompressionJob *job)
+{
+    compressedImageFileHash = job->hashOfOriginal();
+    compressedImage = job->result();
+    compressionCandidates = job->candidatesSummary();
 }
 
 QByteArray MainWindow::uncompressedDiskImage()
@@ -2465,14 +2711,14 @@ QByteArray MainWindow::uncompressedDiskImage()
     return data;
 }
 
-QByteArray MainWindow::diskImageToWrite()
+QByteArray MainWindow::diskImageToWrite(ROMBuilder const &romBuilder)
 {
-    QByteArray uncompressedImage = uncompressedDiskImage();
+    QByteArray const &uncompressedImage = romBuilder.diskImage();
 
     // If the selected ROM doesn't support compression, return it uncompressed.
     // Also, if it's a compressed disk image, return it as is (earlier checks
     // will have already ensured we are using a supported ROM in that case)
-    if (!checkBaseROMCompressionSupport() || isCompressedDiskImage(uncompressedImage))
+    if (!romBuilder.baseROMSupportsCompression() || isCompressedDiskImage(uncompressedImage))
     {
         return uncompressedImage;
     }
@@ -2480,19 +2726,19 @@ QByteArray MainWindow::diskImageToWrite()
     // Otherwise, return the compressed image which we should have already
     // verified is good to go. Double check though...it's possible that the file
     // changed underneath us, in which case we need to compress it again.
-    if (FC8Compressor::hashMatchesFile(compressedImageFileHash, uncompressedImage))
+    if (romBuilder.diskImageHash() == compressedImageFileHash)
     {
         return compressedImage;
     }
     else
     {
         // It doesn't match, which means the filename hasn't changed but the
-        // content has changed since we last compressed it. Recompress it.
-        compressImageInBackground(uncompressedImage, true);
-
-        // Make sure it matches now
-        if (FC8Compressor::hashMatchesFile(compressedImageFileHash, uncompressedImage))
+        // content has changed since we last compressed it. Recompress it, or
+        // pick up the compression that's already running for it.
+        CompressionJob *job = compressImageInBackground(uncompressedImage, true, romBuilder.diskImageHash());
+        if (job->succeeded())
         {
+            applyCompressionJob(job);
             return compressedImage;
         }
         else
@@ -2517,73 +2763,113 @@ QByteArray MainWindow::unpatchedBaseROM()
     return finalImage;
 }
 
-QByteArray MainWindow::patchedBaseROM()
+bool MainWindow::loadCombinedROMInputs(ROMBuilder &romBuilder)
 {
-    QByteArray rom = unpatchedBaseROM();
-    uint32_t imageSize = uncompressedDiskImage().length();
+    // Each file only gets read once; everything from here on works from
+    // what the builder has
+    return romBuilder.loadBaseROM(ui->chosenBaseROMFile->text()) &&
+           romBuilder.loadDiskImage(ui->chosenDiskImageFile->text());
+}
 
-    // If we find a base ROM that we know how to modify for the correct disk image size,
-    // perform the modification here.
-    switch (identifyBaseROM())
+QByteArray MainWindow::createROM(ROMBuilder const &romBuilder)
+{
+    QByteArray diskImage = diskImageToWrite(romBuilder);
+    if (diskImage.isEmpty())
     {
-    case BaseROMbbraun8MB:
-        rom[0x52500] = (imageSize >> 24) & 0xFF;
-        rom[0x52501] = (imageSize >> 16) & 0xFF;
-        rom[0x52502] = (imageSize >> 8) & 0xFF;
-        rom[0x52503] = (imageSize >> 0) & 0xFF;
-
-        // bbraun's 8 MB 0.9.6 base image has a bug that can cause a bus error when booting with R+A
-        // if a write is attempted before the ROM disk has been copied to RAM. Work around this
-        // bug if the driver exactly matches the known broken driver. The fix is, when deciding if
-        // a write operation is allowed or not, to look at origdisk instead of drvsts.writeProt.
-        // writeProt can say the drive is writable even though it hasn't been copied to RAM yet.
-        // When origdisk is non-null, we're guaranteed it's in RAM, so it's a safer check.
-        if (QCryptographicHash::hash(rom.mid(0x51D40, 0x7BC), QCryptographicHash::Md5) ==
-            QByteArray("\x0E\x12\x43\x36\x03\x48\x5C\xDE\x2E\x4C\x04\xE3\x30\xF9\xD2\x0B", 16))
-        {
-            // Change opcode from tst.b to tst.l
-            rom[0x521F1] = 0xAA;
-            // Change tested data from drvsts.writeProt to origdisk
-            rom[0x521F3] = 0x22;
-            // Change bne to beq
-            rom[0x521F4] = 0x67;
-        }
-        break;
-    case BaseROMGarrettsWorkshop:
-        rom[0x51DAC] = (imageSize >> 24) & 0xFF;
-        rom[0x51DAD] = (imageSize >> 16) & 0xFF;
-        rom[0x51DAE] = (imageSize >> 8) & 0xFF;
-        rom[0x51DAF] = (imageSize >> 0) & 0xFF;
-        break;
-    case BaseROMUnknown:
-    case BaseROMbbraun2MB:
-    case BaseROMBMOW:
-    default:
-        break;
+        return QByteArray();
     }
 
-    return rom;
+    return romBuilder.build(diskImage);
 }
 
-QByteArray MainWindow::createROM()
+PipelinedROMBuilder *MainWindow::createPipelinedROM(ROMBuilder const &romBuilder)
 {
-    QByteArray finalImage;
-    QByteArray baseROM = patchedBaseROM();
+    // Only worth it if we'd otherwise have to sit and wait for the
+    // compression. The automatic block size has to see every candidate
+    // before it can pick one, so it can't be pipelined either.
+    QByteArray const &uncompressedImage = romBuilder.diskImage();
+    if (!romBuilder.baseROMSupportsCompression() ||
+        isCompressedDiskImage(uncompressedImage) ||
+        uncompressedImage.isEmpty() ||
+        romBuilder.diskImageHash() == compressedImageFileHash ||
+        ui->actionAutomatic_block_size->isChecked())
+    {
+        return NULL;
+    }
+
+    QByteArray baseROM = romBuilder.patchedBaseROM();
     if (baseROM.isEmpty())
     {
-        return QByteArray();
+        return NULL;
+    }
+    // The write starts before we know exactly how big the result is, so make
+    // sure it's going to fit. If it's close, do it the old way so a
+    // too-large image is caught before anything gets erased.
+    const qint64 simmSize = simmTable[ui->simmCapacityBox->currentIndex()].size * 1024;
+    const FC8Compressor::Mode mode = ui->actionHigh_compression->isChecked() ?
+                FC8Compressor::HighRatioMode : FC8Compressor::FastMode;
+    qint64 estimatedSize = sizeEstimateSize;
+    qint64 estimateMargin = sizeEstimateMargin;
+    if (!sizeEstimateReady ||
+        sizeEstimateKey != sizeEstimateKeyFor(romBuilder.diskImageHash(), 65536, mode))
+    {
+        // Nothing we can use yet, and the write can't start without it
+        const FC8SizeEstimator::Estimate estimate = FC8SizeEstimator::estimate(uncompressedImage, 65536, mode);
+        estimatedSize = estimate.size;
+        estimateMargin = estimate.margin;
+    }
+    if (baseROM.length() + estimatedSize + estimateMargin > simmSize)
+    {
+        return NULL;
     }
 
-    finalImage = baseROM;
+    PipelinedROMBuilder *builder = new PipelinedROMBuilder(baseROM, uncompressedImage, 65536, mode, simmSize);
+    // Hang onto the compressed image once it's done, so saving or writing
+    // it again doesn't compress it all over again
+    connect(builder, SIGNAL(compressionFinished(QByteArray,QByteArray)), this, SLOT(compressorThreadFinished(QByteArray,QByteArray)));
+    builder->start();
 
-    QByteArray diskImage = diskImageToWrite();
-    if (diskImage.isEmpty())
+    // No point in the background compression racing it for the same result
+    if (compressionJob)
     {
-        return QByteArray();
+        compressionJob->cancel();
     }
-    finalImage += diskImage;
+    return builder;
+}
 
-    return finalImage;
+bool MainWindow::startBlockTablePatch()
+{
+    PipelinedROMBuilder *builder = qobject_cast<PipelinedROMBuilder *>(writeFile);
+    if (!builder)
+    {
+        return false;
+    }
+
+    // If the compression failed or didn't fit after all, whatever made it
+    // onto the SIMM isn't usable
+    if (!builder->succeeded())
+    {
+        programmerWriteStatusChanged(WriteError);
+        return true;
+    }
+
+    // The block table was left erased during the main write, so it can be
+    // programmed now. The programmer takes care of keeping the rest of the
+    // sector intact.
+    QBuffer *finalImage = new QBuffer();
+    finalImage->setData(builder->finalImage());
+    const uint32_t tableOffset = builder->blockTableOffset();
+    const uint32_t tableLength = builder->blockTableLength();
+
+    writeFile->close();
+    delete writeFile;
+    writeFile = finalImage;
+    writeFile->open(QFile::ReadOnly);
+    combinedROMBeingWritten = finalImage->data();
+
+    ui->statusLabel->setText("Writing the disk image's block table...");
+    p->writeToSIMM(writeFile, tableOffset, tableLength);
+    return true;
 }
 
 QString MainWindow::displayableFileSize(qint64 size)
@@ -2616,7 +2902,21 @@ QString MainWindow::displayableFileSize(qint64 size)
 
 void MainWindow::on_writeCombinedFileToSIMMButton_clicked()
 {
-    QByteArray dataToWrite = createROM();
+    ROMBuilder romBuilder;
+    QByteArray dataToWrite;
+    if (loadCombinedROMInputs(romBuilder))
+    {
+        // If the disk image still has to be compressed, there's no need to wait
+        // for it. The SIMM can be erased and the base ROM written in the meantime.
+        PipelinedROMBuilder *builder = createPipelinedROM(romBuilder);
+        if (builder)
+        {
+            doInternalWrite(builder);
+            return;
+        }
+
+        dataToWrite = createROM(romBuilder);
+    }
     if (dataToWrite.isEmpty())
     {
         showMessageBox(QMessageBox::Warning, "Error combining files", "The ROM and disk image were unable to be combined. Make sure you chose the correct files.");
@@ -2626,11 +2926,17 @@ void MainWindow::on_writeCombinedFileToSIMMButton_clicked()
     QBuffer *combinedFile = new QBuffer();
     combinedFile->setData(dataToWrite);
     doInternalWrite(combinedFile);
+    combinedROMBeingWritten = dataToWrite;
 }
 
 void MainWindow::on_saveCombinedFileButton_clicked()
 {
-    QByteArray dataToWrite = createROM();
+    ROMBuilder romBuilder;
+    QByteArray dataToWrite;
+    if (loadCombinedROMInputs(romBuilder))
+    {
+        dataToWrite = createROM(romBuilder);
+    }
     if (dataToWrite.isEmpty())
     {
         showMessageBox(QMessageBox::Warning, "Error combining files", "The ROM and disk image were unable to be combined. Make sure you chose the correct files.");
@@ -2661,65 +2967,50 @@ void MainWindow::on_saveCombinedFileButton_clicked()
     }
 }
 
-void MainWindow::compressorThreadFinished(QByteArray hashOfOriginal, QByteArray compressedData)
+void MainWindow::compressionJobFinished()
 {
-    compressedImageFileHash = hashOfOriginal;
-    compressedImage = compressedData;
+    // Only the latest one counts, and a cancelled one has nothing to offer
+    if (!compressionJob || !compressionJob->isFinished() || compressionJob->isCancelled())
+    {
+        return;
+    }
+    applyCompressionJob(compressionJob);
     updateCreateROMControlStatus();
 }
 
-QList<QByteArray> MainWindow::separateFirmwareIntoVersions(QByteArray totalFirmware)
+void MainWindow::compressionProgressChanged(int value, int maximum)
 {
-    QList<QByteArray> firmwares;
-
-    while (totalFirmware.contains(multiFirmwareDelimiter))
-    {
-        int index = totalFirmware.indexOf(multiFirmwareDelimiter);
-        firmwares.append(totalFirmware.mid(0, index));
-        totalFirmware.remove(0, index + multiFirmwareDelimiter.length());
-    }
-
-    // As long as we have something left, also append it
-    if (!totalFirmware.isEmpty())
-    {
-        firmwares.append(totalFirmware);
-    }
+    ui->progressBar->setRange(0, maximum);
+    ui->progressBar->setValue(value);
+}
 
-    return firmwares;
+void MainWindow::compressorThreadFinished(QByteArray hashOfOriginal, QByteArray compressedData)
+{
+    compressedImageFileHash = hashOfOriginal;
+    compressedImage = compressedData;
+    updateCreateROMControlStatus();
 }
 
 QByteArray MainWindow::findCompatibleFirmware(QString filename, QString &compatibilityError)
 {
-    QFile fwFile(filename);
-    if (!fwFile.open(QFile::ReadOnly))
+    // The bundle hangs onto its index, so picking the same file again
+    // doesn't have to split it up and look for descriptors all over again
+    if (!firmwareBundle.load(filename))
     {
         compatibilityError = "Unable to open the selected firmware file.";
         return QByteArray();
     }
 
-    QByteArray totalFirmware = fwFile.readAll();
-    fwFile.close();
-
-    // Extract all different firmwares from this
-    QList<QByteArray> firmwares = separateFirmwareIntoVersions(totalFirmware);
-
-    // Make sure they are each firmware files, and try to find the first one that is compatible
-    int firmwaresFound = 0;
-    foreach (QByteArray const &firmware, firmwares)
+    // Try to find the first firmware that is compatible
+    FirmwareBundle::Entry entry;
+    if (firmwareBundle.findFirmware(p->programmerRevision(), entry))
     {
-        bool isFirmwareFile = false;
-        if (firmwareIsCompatible(firmware, isFirmwareFile))
-        {
-            return firmware;
-        }
-
-        if (isFirmwareFile)
-        {
-            firmwaresFound++;
-        }
+        // Make a real copy; the programmer keeps it around while flashing
+        QByteArray firmware = firmwareBundle.firmware(entry);
+        return QByteArray(firmware.constData(), firmware.length());
     }
 
-    if (firmwaresFound == 0)
+    if (firmwareBundle.firmwareCount() == 0)
     {
         compatibilityError = "The selected file doesn't appear to be a programmer firmware file.";
     }
@@ -2734,59 +3025,6 @@ QByteArray MainWindow::findCompatibleFirmware(QString filename, QString &compati
     return QByteArray();
 }
 
-bool MainWindow::firmwareIsCompatible(QByteArray const &firmware, bool &isFirmwareFile)
-{
-    // Find the device descriptor in the dump. Locate it by
-    // searching for the USB VID and PID, and then double-checking
-    // that it's actually a device descriptor by verifying the surrounding data.
-    QByteArray vidPid("\xD0\x16\xAA\x06", 4);
-    int index = 0;
-    int descriptorsFound = 0;
-    do
-    {
-        index = firmware.indexOf(vidPid, index);
-        if (index >= 0)
-        {
-            // Is this actually the device descriptor? Check a bunch of fields to see.
-            // The descriptors are slightly different between revisions, but this will
-            // check enough of the fields that we can be confident.
-            if (index >= 8 &&
-                index + 9 < firmware.length() &&
-                firmware.at(index - 8) == 0x12 && // Device descriptor length
-                firmware.at(index - 7) == 0x01 && // Device descriptor identifier
-                firmware.at(index - 4) == 0x02 && // Class = CDC communication device
-                firmware.at(index - 3) == 0x00 && // Subclass = 0
-                firmware.at(index - 2) == 0x00 && // Protocol = 0)
-                firmware.at(index + 6) == 0x01 && // Manufacturer string = 1
-                firmware.at(index + 7) == 0x02 && // Product string = 2
-                firmware.at(index + 9) == 0x01) // Num configurations = 1
-            {
-                // We're pretty sure it is. Let's extract the revision.
-                uint16_t revision = static_cast<uint8_t>(firmware.at(index + 4)) |
-                                    static_cast<uint8_t>(firmware.at(index + 5)) << 8;
-
-                // See if it matches the current programmer revision. Alternatively,
-                // if the current programmer revision is 0 it means we failed to detect it,
-                // and we should just let them attempt it anyway.
-                if (revision == p->programmerRevision() ||
-                    p->programmerRevision() == ProgrammerRevisionUnknown)
-                {
-                    isFirmwareFile = true;
-                    return true;
-                }
-
-                // Count how many descriptors we found
-                descriptorsFound++;
-            }
-
-            index += 4;
-        }
-    } while (index >= 0);
-
-    isFirmwareFile = (descriptorsFound > 0);
-    return false;
-}
-
 void MainWindow::showMessageBox(QMessageBox::Icon icon, const QString &title, const QString &text)
 {
     // We can't show multiple message boxes
@@ -2813,6 +3051,266 @@ void MainWindow::on_actionExtended_UI_triggered(bool checked)
     setUseExtendedUI(checked);
 }
 
+void MainWindow::on_actionRun_production_sequence_triggered()
+{
+    // Watch mode would write its ROM over the SIMM as soon as a file changed
+    if (romWatcher->isWatching())
+    {
+        showMessageBox(QMessageBox::Warning, "Watch mode is on", "Turn off watch mode before running a production sequence.");
+        return;
+    }
+
+    QByteArray image;
+    if (!loadProductionImage(image))
+    {
+        return;
+    }
+
+    resetAndShowStatusPage();
+    jobRunner->enqueueSequence(productionSequenceJobs(image));
+}
+
+bool MainWindow::loadProductionImage(QByteArray &image)
+{
+    QFile file(ui->chosenWriteFile->text());
+    if (ui->chosenWriteFile->text().isEmpty() || !file.open(QFile::ReadOnly))
+    {
+        showMessageBox(QMessageBox::Warning, "No file chosen", "Choose the file to write to the SIMM first. The production sequence tests the SIMM, identifies its chips, writes and verifies the file, and then checks the ROM checksum.");
+        return false;
+    }
+    image = file.readAll();
+    file.close();
+    return true;
+}
+
+QList<ProgrammerJob> MainWindow::productionSequenceJobs(QByteArray const &image)
+{
+    // Electrical test, identify, write with verify, checksum verify
+    QList<ProgrammerJob> jobs;
+    ProgrammerJob job;
+    job.type = ProgrammerJob::ElectricalTest;
+    jobs.append(job);
+    job.type = ProgrammerJob::Identify;
+    jobs.append(job);
+    job.type = ProgrammerJob::Write;
+    job.data = image;
+    job.verifyMode = (p->verifyMode() == NoVerification) ? VerifyWhileWriting : p->verifyMode();
+    jobs.append(job);
+    job.type = ProgrammerJob::ChecksumVerify;
+    job.data.clear();
+    job.length = image.size();
+    jobs.append(job);
+    return jobs;
+}
+
+void MainWindow::on_actionBatch_mode_triggered(bool checked)
+{
+    if (!checked)
+    {
+        // This goes back to the control page once it's stopped, which might
+        // not be until the SIMM being programmed is done
+        batchProgrammer->stop();
+        return;
+    }
+
+    // Watch mode would write its ROM to whatever SIMM is in there between
+    // units
+    if (romWatcher->isWatching())
+    {
+        ui->actionBatch_mode->setChecked(false);
+        showMessageBox(QMessageBox::Warning, "Watch mode is on", "Turn off watch mode before starting batch mode.");
+        return;
+    }
+
+    // The image is loaded once here and shared by every SIMM after this
+    QByteArray image;
+    if (!loadProductionImage(image))
+    {
+        ui->actionBatch_mode->setChecked(false);
+        return;
+    }
+
+    lastBatchResult.clear();
+    resetAndShowStatusPage();
+    batchProgrammer->start(productionSequenceJobs(image));
+}
+
+void MainWindow::batchStateChanged(BatchProgrammer::State state)
+{
+    QString counts = QString("%1 passed, %2 failed").arg(batchProgrammer->unitsPassed()).arg(batchProgrammer->unitsFailed());
+    if (!lastBatchResult.isEmpty())
+    {
+        counts = lastBatchResult + "\n" + counts;
+    }
+
+    switch (state)
+    {
+    case BatchProgrammer::WaitingForInsertion:
+        ui->progressBar->setRange(0, 0);
+        ui->statusLabel->setText("Batch mode: insert a SIMM to program it.\n" + counts);
+        break;
+    case BatchProgrammer::WaitingForRemoval:
+        ui->progressBar->setRange(0, 0);
+        ui->statusLabel->setText("Batch mode: remove the SIMM.\n" + counts);
+        break;
+    case BatchProgrammer::Stopping:
+        ui->statusLabel->setText("Batch mode: stopping once this SIMM is done.\n" + counts);
+        break;
+    case BatchProgrammer::Stopped:
+        returnToControlPage();
+        break;
+    case BatchProgrammer::Programming:
+        break;
+    }
+}
+
+void MainWindow::batchUnitFinished(int unitNumber, bool success, QString report)
+{
+    if (success)
+    {
+        lastBatchResult = QString("SIMM #%1 passed.").arg(unitNumber);
+    }
+    else
+    {
+        // The first line of the report that has a failure in it says the most
+        QString failure;
+        foreach (QString const &line, report.split("\n"))
+        {
+            if (line.contains("FAILED"))
+            {
+                failure = line.trimmed();
+                break;
+            }
+        }
+        lastBatchResult = QString("SIMM #%1 FAILED: %2").arg(unitNumber).arg(failure);
+    }
+}
+
+void MainWindow::sequenceStepStarted(int sequenceID, int step, int totalSteps, ProgrammerJob::Type type)
+{
+    if (sequenceID == watchSequenceID)
+    {
+        // Watch mode checks the SIMM with verify steps before writing to it
+        watchCheckingSIMM = (type == ProgrammerJob::Verify);
+    }
+
+    ui->progressBar->setRange(0, 0);
+    QString text = QString("Step %1 of %2: %3...").arg(step).arg(totalSteps).arg(JobRunner::describe(type));
+    if (batchProgrammer->state() == BatchProgrammer::Stopping)
+    {
+        text += "\nBatch mode will stop once this SIMM is done.";
+    }
+    ui->statusLabel->setText(text);
+}
+
+void MainWindow::sequenceFinished(int sequenceID, bool success, QString report)
+{
+    if (sequenceID == watchSequenceID)
+    {
+        watchSequenceID = 0;
+        if (watchSIMMChanged)
+        {
+            // Only the changed sectors went onto a SIMM that turned out to
+            // be a different one, so the rest of it still has to be written
+            watchSIMMChanged = false;
+            watchFlashedImage.clear();
+            if (watchPendingImage.isEmpty())
+            {
+                watchPendingImage = watchImageBeingWritten;
+            }
+            lastWatchResult = "A different SIMM was found. The whole ROM is being written to it.";
+        }
+        else if (!success && watchCheckingSIMM)
+        {
+            // Nothing was written yet. The SIMM isn't the one we wrote last
+            // time (or it got changed behind our back), so write all of it.
+            watchFlashedImage.clear();
+            if (watchPendingImage.isEmpty())
+            {
+                watchPendingImage = watchImageBeingWritten;
+            }
+            lastWatchResult = "The SIMM doesn't have the last ROM on it anymore. The whole ROM is being written to it.";
+        }
+        else if (success)
+        {
+            watchFlashedImage = watchImageBeingWritten;
+            lastWatchResult = "Last change: " + watchRebuildSummary + "\n" + report.split("\n").last();
+        }
+        else
+        {
+            // No telling what's on the SIMM now, so write all of it next time
+            watchFlashedImage.clear();
+            lastWatchResult = "The last write FAILED. The whole ROM will be written next time.";
+        }
+        watchImageBeingWritten.clear();
+        watchCheckingSIMM = false;
+
+        if (!romWatcher->isWatching())
+        {
+            returnToControlPage();
+            if (!success)
+            {
+                showMessageBox(QMessageBox::Warning, "Write failed", report);
+            }
+            return;
+        }
+
+        // Something might have changed again in the meantime
+        showWatchStatus();
+        writeWatchedROMChanges();
+        return;
+    }
+
+    // Anything else written to the SIMM means we no longer know what's on it
+    watchFlashedImage.clear();
+
+    // In batch mode, results show up on the status page instead
+    if (batchProgrammer->isActive())
+    {
+        return;
+    }
+
+    returnToControlPage();
+    if (success)
+    {
+        showMessageBox(QMessageBox::Information, "Production sequence complete", report);
+    }
+    else
+    {
+        showMessageBox(QMessageBox::Warning, "Production sequence failed", report);
+    }
+}
+
+void MainWindow::on_actionKeep_connection_open_triggered(bool checked)
+{
+    p->setSessionMode(checked);
+
+    QSettings settings;
+    settings.setValue(sessionModeKey, checked);
+}
+
+void MainWindow::on_actionHigh_compression_triggered(bool checked)
+{
+    QSettings settings;
+    settings.setValue(highCompressionKey, checked);
+
+    // Whatever was compressed before was done in the other mode, so forget
+    // it and compress again
+    compressedImageFileHash.clear();
+    compressedImage.clear();
+    updateCreateROMControlStatus();
+}
+
+void MainWindow::on_actionAutomatic_block_size_triggered(bool checked)
+{
+    QSettings settings;
+    settings.setValue(autoBlockSizeKey, checked);
+
+    compressedImageFileHash.clear();
+    compressedImage.clear();
+    updateCreateROMControlStatus();
+}
+
 void MainWindow::setUseExtendedUI(bool extended)
 {
     const bool alreadyExtended = ui->tabWidget->isHidden();
@@ -2931,3 +3429,173 @@ void MainWindow::programmerFirmwareVersionStatusChanged(ReadFirmwareVersionStatu
         break;
     }
 }
+
+void MainWindow::programmerIdentifiedChipsChanged()
+{
+    // The SIMM was swapped, so whatever we wrote to the old one isn't there.
+    // If this was found partway into writing changes in watch mode, that
+    // gets straightened out when it's done.
+    watchFlashedImage.clear();
+    if (watchSequenceID)
+    {
+        watchSIMMChanged = true;
+    }
+}
+
+void MainWindow::forgetSIMMContents()
+{
+    watchFlashedImage.clear();
+    combinedROMBeingWritten.clear();
+    watchSIMMChanged = false;
+}
+
+void MainWindow::on_actionWatch_and_reflash_triggered(bool checked)
+{
+    if (!checked)
+    {
+        romWatcher->stop();
+        watchPendingImage.clear();
+
+        // A write that's already going finishes first, then goes back
+        if (!watchSequenceID)
+        {
+            returnToControlPage();
+        }
+        return;
+    }
+
+    QString error;
+    bool alreadyCompressed = false;
+    if (batchProgrammer->isActive() || jobRunner->isBusy() || jobRunner->queuedCount() > 0 ||
+        !checkBaseROMValidity(error) ||
+        !checkDiskImageValidity(error, alreadyCompressed))
+    {
+        ui->actionWatch_and_reflash->setChecked(false);
+        showMessageBox(QMessageBox::Warning, "Unable to watch files", "Choose the base ROM and disk image to combine first. Watch mode rebuilds the combined ROM whenever either file changes, and writes whatever changed to the SIMM. It can't be used along with batch mode or a production sequence.");
+        return;
+    }
+
+    // The automatic block size could pick a different size every time,
+    // which would change everything, so this sticks with the usual size
+    const FC8Compressor::Mode mode = ui->actionHigh_compression->isChecked() ?
+                FC8Compressor::HighRatioMode : FC8Compressor::FastMode;
+    lastWatchResult.clear();
+    resetAndShowStatusPage();
+    ui->statusLabel->setText("Watch mode: building the combined ROM...");
+    romWatcher->start(ui->chosenBaseROMFile->text(), ui->chosenDiskImageFile->text(), 65536, mode);
+}
+
+void MainWindow::watchedROMRebuilt(QByteArray combinedImage, QString summary)
+{
+    const qint64 simmSize = simmTable[ui->simmCapacityBox->currentIndex()].size * 1024;
+    if (combinedImage.length() > simmSize)
+    {
+        lastWatchResult = "The combined ROM is too big for the selected SIMM (" +
+                displayableFileSize(combinedImage.length()) + ").";
+        showWatchStatus();
+        return;
+    }
+
+    // If a write is still going, this gets picked up when it's done. Only
+    // the newest version matters.
+    watchPendingImage = combinedImage;
+    watchRebuildSummary = summary.isEmpty() ? QString("rebuilt") : summary;
+    writeWatchedROMChanges();
+}
+
+void MainWindow::watchedROMRebuildFailed(QString error)
+{
+    lastWatchResult = "Unable to rebuild: " + error;
+    showWatchStatus();
+}
+
+void MainWindow::writeWatchedROMChanges()
+{
+    if (watchPendingImage.isEmpty() || watchSequenceID)
+    {
+        return;
+    }
+
+    const uint32_t simmSize = simmTable[ui->simmCapacityBox->currentIndex()].size * 1024;
+    QList<QPair<uint32_t, uint32_t> > ranges =
+            ROMWatcher::changedRanges(watchFlashedImage, watchPendingImage, p->sectorIndex(),
+                                      Programmer::fallbackEraseSize(), simmSize);
+    if (ranges.isEmpty())
+    {
+        watchFlashedImage = watchPendingImage;
+        watchPendingImage.clear();
+        lastWatchResult = "Last change: " + watchRebuildSummary + "; nothing on the SIMM needed to change.";
+        showWatchStatus();
+        return;
+    }
+
+    // Every range ends on a sector boundary. Past the end of the image,
+    // write it erased, the same as writing the whole thing would leave it.
+    QByteArray image = watchPendingImage;
+    const uint32_t end = ranges.last().first + ranges.last().second;
+    if (static_cast<uint32_t>(image.length()) < end)
+    {
+        image.append(QByteArray(end - image.length(), static_cast<char>(0xFF)));
+    }
+
+    // A SIMM of the same size could have been swapped in without anything
+    // noticing, so first make sure everything that isn't being rewritten is
+    // still what we left there. If it isn't, the whole ROM gets written.
+    QList<ProgrammerJob> jobs;
+    typedef QPair<uint32_t, uint32_t> Range;
+    const uint32_t keptEnd = qMin(static_cast<uint32_t>(watchFlashedImage.length()), simmSize);
+    uint32_t keptStart = 0;
+    for (int i = 0; i <= ranges.count() && !watchFlashedImage.isEmpty(); i++)
+    {
+        const uint32_t keptStop = qMin(i < ranges.count() ? ranges[i].first : keptEnd, keptEnd);
+        if (keptStop > keptStart)
+        {
+            ProgrammerJob check;
+            check.type = ProgrammerJob::Verify;
+            check.data = watchFlashedImage;
+            check.offset = keptStart;
+            check.length = keptStop - keptStart;
+            jobs.append(check);
+        }
+        if (i < ranges.count())
+        {
+            keptStart = ranges[i].first + ranges[i].second;
+        }
+    }
+
+    uint32_t total = 0;
+    foreach (Range const &range, ranges)
+    {
+        ProgrammerJob job;
+        job.type = ProgrammerJob::WritePortion;
+        job.data = image;
+        job.offset = range.first;
+        job.length = range.second;
+        job.verifyMode = p->verifyMode();
+        jobs.append(job);
+        total += range.second;
+    }
+
+    watchRebuildSummary += QString(", wrote %1 of %2")
+            .arg(displayableFileSize(total))
+            .arg(displayableFileSize(watchPendingImage.length()));
+    watchImageBeingWritten = watchPendingImage;
+    watchPendingImage.clear();
+    watchSequenceID = jobRunner->enqueueSequence(jobs);
+}
+
+void MainWindow::showWatchStatus()
+{
+    if (!romWatcher->isWatching() || watchSequenceID)
+    {
+        return;
+    }
+
+    ui->progressBar->setRange(0, 0);
+    QString text = "Watch mode: waiting for the base ROM or disk image to change.";
+    if (!lastWatchResult.isEmpty())
+    {
+        text += "\n" + lastWatchResult;
+    }
+    ui->statusLabel->setText(text);
+}
@@ -23,12 +23,22 @@
 #include <QMainWindow>
 #include <QFile>
 #include <QMessageBox>
+#include <QPointer>
 #include "programmer.h"
+#include "firmwarebundle.h"
+#include "writejournal.h"
+#include "jobrunner.h"
+#include "batchprogrammer.h"
+#include "compressionservice.h"
+#include "rombuilder.h"
+#include "romwatcher.h"
 
 namespace Ui {
 class MainWindow;
 }
 
+class PipelinedROMBuilder;
+
 class MainWindow : public QMainWindow
 {
     Q_OBJECT
@@ -42,7 +52,7 @@ private slots:
     void on_selectReadFileButton_clicked();
 
     void on_writeToSIMMButton_clicked();
-    void doInternalWrite(QIODevice *device);
+    void doInternalWrite(QIODevice *device, uint32_t resumeOffset = 0);
     void on_readFromSIMMButton_clicked();
 
     void on_chosenWriteFile_textEdited(const QString &newText);
@@ -55,6 +65,7 @@ private slots:
     void programmerWriteStatusChanged(WriteStatus newStatus);
     void programmerWriteTotalLengthChanged(uint32_t totalLen);
     void programmerWriteCompletionLengthChanged(uint32_t len);
+    void programmerWriteCheckpoint(uint32_t offset);
 
     void programmerVerifyTotalLengthChanged(uint32_t totalLen);
     void programmerVerifyCompletionLengthChanged(uint32_t len);
@@ -67,6 +78,7 @@ private slots:
     void programmerReadCompletionLengthChanged(uint32_t len);
 
     void programmerIdentifyStatusChanged(IdentificationStatus newStatus);
+    void programmerIdentifiedChipsChanged();
 
     void programmerFirmwareFlashStatusChanged(FirmwareFlashStatus newStatus);
     void programmerFirmwareFlashTotalLengthChanged(uint32_t totalLen);
@@ -84,6 +96,8 @@ private slots:
     void programmerBoardConnected();
     void programmerBoardDisconnected();
     void programmerBoardDisconnectedDuringOperation();
+    void offerWriteResume();
+    void writeResumeAnswered(int button);
 
     void on_simmCapacityBox_currentIndexChanged(int index);
 
@@ -109,7 +123,6 @@ private slots:
 
     void on_verifyROMChecksumButton_clicked();
     void finishChecksumVerify();
-    bool calculateROMChecksum(QByteArray const &rom, uint32_t len, uint32_t &checksum);
 
     void on_selectBaseROMButton_clicked();
     void on_selectDiskImageButton_clicked();
@@ -119,14 +132,30 @@ private slots:
     void on_writeCombinedFileToSIMMButton_clicked();
     void on_saveCombinedFileButton_clicked();
 
+    void compressionJobFinished();
+    void compressionProgressChanged(int value, int maximum);
     void compressorThreadFinished(QByteArray hashOfOriginal, QByteArray compressedData);
+    void sizeEstimateFinished(QByteArray key, qint64 size, qint64 margin);
 
     void messageBoxFinished();
 
     void on_actionExtended_UI_triggered(bool checked);
+    void on_actionKeep_connection_open_triggered(bool checked);
+    void on_actionHigh_compression_triggered(bool checked);
+    void on_actionAutomatic_block_size_triggered(bool checked);
+    void on_actionRun_production_sequence_triggered();
+    void sequenceStepStarted(int sequenceID, int step, int totalSteps, ProgrammerJob::Type type);
+    void sequenceFinished(int sequenceID, bool success, QString report);
+    void on_actionBatch_mode_triggered(bool checked);
+    void batchStateChanged(BatchProgrammer::State state);
+    void batchUnitFinished(int unitNumber, bool success, QString report);
 
     void on_actionCreate_blank_disk_image_triggered();
 
+    void on_actionWatch_and_reflash_triggered(bool checked);
+    void watchedROMRebuilt(QByteArray combinedImage, QString summary);
+    void watchedROMRebuildFailed(QString error);
+
 private:
     Ui::MainWindow *ui;
     bool initializing;
@@ -138,16 +167,33 @@ private:
     QBuffer *checksumVerifyBuffer;
     QByteArray compressedImageFileHash;
     QByteArray compressedImage;
+    QString compressionCandidates;
+    CompressionService *compressionService;
+    QPointer<CompressionJob> compressionJob;
+    // The last size estimate asked for (disk image hash, block size and
+    // mode), so refreshing the controls doesn't work it out all over again
+    QByteArray sizeEstimateKey;
+    bool sizeEstimateReady;
+    qint64 sizeEstimateSize;
+    qint64 sizeEstimateMargin;
     QMessageBox *activeMessageBox;
-
-    enum KnownBaseROM
-    {
-        BaseROMUnknown,
-        BaseROMbbraun2MB,
-        BaseROMbbraun8MB,
-        BaseROMBMOW,
-        BaseROMGarrettsWorkshop,
-    };
+    FirmwareBundle firmwareBundle;
+    WriteJournal writeJournal;
+    JobRunner *jobRunner;
+    BatchProgrammer *batchProgrammer;
+    QString lastBatchResult;
+    ROMWatcher *romWatcher;
+    // What we know is on the SIMM, from the last combined ROM that was
+    // written all the way through. Empty if we don't know.
+    QByteArray watchFlashedImage;
+    QByteArray combinedROMBeingWritten;
+    QByteArray watchPendingImage;
+    QByteArray watchImageBeingWritten;
+    QString watchRebuildSummary;
+    QString lastWatchResult;
+    int watchSequenceID;
+    bool watchSIMMChanged;
+    bool watchCheckingSIMM;
 
     void resetAndShowStatusPage();
     void handleVerifyFailureReply();
@@ -159,20 +205,32 @@ private:
 
     bool checkBaseROMValidity(QString &errorText);
     bool checkBaseROMCompressionSupport();
-    KnownBaseROM identifyBaseROM(QByteArray const *baseROMToCheck = NULL);
+    ROMBuilder::KnownBaseROM identifyBaseROM(QByteArray const *baseROMToCheck = NULL);
     bool checkDiskImageValidity(QString &errorText, bool &alreadyCompressed);
     bool isCompressedDiskImage(QByteArray const &image);
-    void compressImageInBackground(QByteArray uncompressedImage, bool blockUntilCompletion);
+    CompressionJob *compressImageInBackground(QByteArray const &uncompressedImage, bool blockUntilCompletion,
+                                              QByteArray const &hashOfImage = QByteArray());
+    void applyCompressionJob(CompressionJob *job);
+    int sizeEstimateBlockSize();
+    QByteArray sizeEstimateKeyFor(QByteArray const &hashOfImage, int blockSize, FC8Compressor::Mode mode);
+    bool startSizeEstimate(QByteArray const &uncompressedImage, QByteArray const &hashOfImage);
     QByteArray uncompressedDiskImage();
-    QByteArray diskImageToWrite();
+    QByteArray diskImageToWrite(ROMBuilder const &romBuilder);
     QByteArray unpatchedBaseROM();
-    QByteArray patchedBaseROM();
-    QByteArray createROM();
+    bool loadCombinedROMInputs(ROMBuilder &romBuilder);
+    QByteArray createROM(ROMBuilder const &romBuilder);
+    PipelinedROMBuilder *createPipelinedROM(ROMBuilder const &romBuilder);
+    bool startBlockTablePatch();
     QString displayableFileSize(qint64 size);
+    QString readChecksumSummary();
+    QString recoverySummary();
+    bool loadProductionImage(QByteArray &image);
+    QList<ProgrammerJob> productionSequenceJobs(QByteArray const &image);
+    void writeWatchedROMChanges();
+    void forgetSIMMContents();
+    void showWatchStatus();
 
-    static QList<QByteArray> separateFirmwareIntoVersions(QByteArray totalFirmware);
     QByteArray findCompatibleFirmware(QString filename, QString &compatibilityError);
-    bool firmwareIsCompatible(QByteArray const &firmware, bool &isFirmwareFile);
 
     void showMessageBox(QMessageBox::Icon icon, const QString &title, const QString &text);
     void setUseExtendedUI(bool extended);
@@ -0,0 +1,317 @@
+#include "pipelinedrombuilder.h"
+#include <QBuffer>
+#include <QMutexLocker>
+#include <QThread>
+#include <string.h>
+namespace fc8 {
+extern "C" {
+#include "3rdparty/fc8-compression/fc8.h"
+}
+}
+
+// Runs the compression for a builder
+class PipelinedROMBuilderThread : public QThread
+{
+public:
+    explicit PipelinedROMBuilderThread(PipelinedROMBuilder *builder) : builder(builder) {}
+
+protected:
+    void run() { builder->runCompression(); }
+
+private:
+    PipelinedROMBuilder *builder;
+};
+
+// Where FC8Compressor::compressStream() writes to. Everything goes straight
+// into the builder, which hands it out as soon as it's there.
+class PipelinedROMBuilderSink : public QIODevice
+{
+public:
+    explicit PipelinedROMBuilderSink(PipelinedROMBuilder *builder) : builder(builder), length(0) {}
+
+    bool isSequential() const { return false; }
+    qint64 size() const { return length; }
+
+protected:
+    qint64 readData(char *data, qint64 maxlen)
+    {
+        // Only ever asked for what was already written, to reuse a block
+        QMutexLocker locker(&builder->_mutex);
+        const qint64 n = qBound(static_cast<qint64>(0), builder->_compressed.length() - pos(), maxlen);
+        if (n > 0)
+        {
+            memcpy(data, builder->_compressed.constData() + pos(), n);
+        }
+        return n;
+    }
+    qint64 writeData(const char *data, qint64 len)
+    {
+        {
+            QMutexLocker locker(&builder->_mutex);
+            if (builder->_cancelled)
+            {
+                return -1;
+            }
+        }
+
+        builder->appendCompressed(pos(), data, len);
+        length = qMax(length, pos() + len);
+        return len;
+    }
+
+private:
+    PipelinedROMBuilder *builder;
+    qint64 length;
+};
+
+PipelinedROMBuilder::PipelinedROMBuilder(const QByteArray &baseROM, const QByteArray &diskImage, int blockSize,
+                                         FC8Compressor::Mode mode, qint64 provisionalSize, QObject *parent) :
+    QIODevice(parent),
+    _baseROM(baseROM),
+    _diskImage(diskImage),
+    _blockSize(blockSize),
+    _mode(mode),
+    _provisionalSize(provisionalSize),
+    _thread(NULL),
+    _compressedFinal(0),
+    _finished(false),
+    _succeeded(false),
+    _cancelled(false)
+{
+}
+
+PipelinedROMBuilder::~PipelinedROMBuilder()
+{
+    if (_thread)
+    {
+        // If the write ended early, don't bother finishing the compression
+        {
+            QMutexLocker locker(&_mutex);
+            _cancelled = true;
+        }
+        _thread->wait();
+        delete _thread;
+    }
+}
+
+void PipelinedROMBuilder::start()
+{
+    if (!_thread)
+    {
+        _thread = new PipelinedROMBuilderThread(this);
+        _thread->start();
+    }
+}
+
+bool PipelinedROMBuilder::open(OpenMode mode)
+{
+    // Unbuffered, so bytesAvailable() and pos() are exactly what the caller sees
+    return QIODevice::open(mode | QIODevice::Unbuffered);
+}
+
+bool PipelinedROMBuilder::isSequential() const
+{
+    return false;
+}
+
+qint64 PipelinedROMBuilder::size() const
+{
+    QMutexLocker locker(&_mutex);
+    if (_finished && _succeeded)
+    {
+        return _baseROM.length() + _compressed.length();
+    }
+    return _provisionalSize;
+}
+
+bool PipelinedROMBuilder::isFinished() const
+{
+    QMutexLocker locker(&_mutex);
+    return _finished;
+}
+
+bool PipelinedROMBuilder::succeeded() const
+{
+    QMutexLocker locker(&_mutex);
+    return _finished && _succeeded;
+}
+
+QByteArray PipelinedROMBuilder::finalImage() const
+{
+    QMutexLocker locker(&_mutex);
+    if (!_finished || !_succeeded)
+    {
+        return QByteArray();
+    }
+    return _baseROM + _compressed;
+}
+
+uint32_t PipelinedROMBuilder::blockTableOffset() const
+{
+    return _baseROM.length() + FC8_BLOCK_HEADER_SIZE;
+}
+
+uint32_t PipelinedROMBuilder::blockTableLength() const
+{
+    const int numBlocks = (_diskImage.length() - 1) / _blockSize + 1;
+    return 4 * numBlocks;
+}
+
+qint64 PipelinedROMBuilder::readData(char *data, qint64 maxlen)
+{
+    const qint64 baseLen = _baseROM.length();
+    const qint64 tableStart = blockTableOffset();
+    const qint64 tableEnd = tableStart + blockTableLength();
+    qint64 done = 0;
+
+    QMutexLocker locker(&_mutex);
+    while (done < maxlen)
+    {
+        const qint64 p = pos() + done;
+        qint64 n;
+        if (p < baseLen)
+        {
+            n = qMin(maxlen - done, baseLen - p);
+            memcpy(data + done, _baseROM.constData() + p, n);
+        }
+        else if (p >= tableStart && p < tableEnd)
+        {
+            // Left erased for now
+            n = qMin(maxlen - done, tableEnd - p);
+            memset(data + done, 0xFF, n);
+        }
+        else
+        {
+            // Hand back what's ready; bytesAvailable() and readyRead() say
+            // when there's more
+            if (!_finished && p - baseLen >= _compressedFinal)
+            {
+                break;
+            }
+
+            if (_finished && !_succeeded)
+            {
+                return done > 0 ? done : -1;
+            }
+            else if (p - baseLen < _compressedFinal)
+            {
+                n = qMin(maxlen - done, _compressedFinal - (p - baseLen));
+                if (p < tableStart)
+                {
+                    // Don't run into the block table from the header
+                    n = qMin(n, tableStart - p);
+                }
+                memcpy(data + done, _compressed.constData() + (p - baseLen), n);
+            }
+            else
+            {
+                // Past the end; that's erased too
+                n = maxlen - done;
+                memset(data + done, 0xFF, n);
+            }
+        }
+        done += n;
+    }
+
+    return done;
+}
+
+qint64 PipelinedROMBuilder::bytesAvailable() const
+{
+    const qint64 baseLen = _baseROM.length();
+    const qint64 tableStart = blockTableOffset();
+    const qint64 tableEnd = tableStart + blockTableLength();
+
+    QMutexLocker locker(&_mutex);
+    qint64 end;
+    if (_finished)
+    {
+        // Everything can be read now (or fails right away)
+        end = _succeeded ? baseLen + _compressed.length() : _provisionalSize;
+    }
+    else
+    {
+        // The block table is always ready, so it doesn't hold anything up
+        end = baseLen + _compressedFinal;
+        if (end >= tableStart && end < tableEnd)
+        {
+            end = tableEnd;
+        }
+    }
+
+    return qMax<qint64>(end - pos(), 0) + QIODevice::bytesAvailable();
+}
+
+qint64 PipelinedROMBuilder::writeData(const char *data, qint64 len)
+{
+    Q_UNUSED(data);
+    Q_UNUSED(len);
+    return -1;
+}
+
+void PipelinedROMBuilder::appendCompressed(qint64 offset, const char *data, qint64 len)
+{
+    bool more = false;
+    {
+        QMutexLocker locker(&_mutex);
+        if (offset + len > _compressed.length())
+        {
+            _compressed.resize(offset + len);
+        }
+        memcpy(_compressed.data() + offset, data, len);
+
+        // The compressor only goes back to fill in the block table, which is
+        // handled separately, so anything it appends is final
+        if (offset + len > _compressedFinal)
+        {
+            _compressedFinal = offset + len;
+            more = true;
+        }
+    }
+
+    if (more)
+    {
+        emit readyRead();
+    }
+}
+
+void PipelinedROMBuilder::runCompression()
+{
+    FC8Compressor compressor(_diskImage, _blockSize, _mode);
+    QBuffer input;
+    input.setData(_diskImage);
+    input.open(QIODevice::ReadOnly);
+
+    PipelinedROMBuilderSink sink(this);
+    // Unbuffered so reads and writes land exactly where pos() says
+    sink.open(QIODevice::ReadWrite | QIODevice::Unbuffered);
+
+    QByteArray hashOfOriginal;
+    bool ok = compressor.compressStream(&input, &sink, &hashOfOriginal);
+
+    // The write has been going on the assumption that it all fits. If it
+    // turned out bigger after all, fail it rather than cutting it short.
+    if (ok && _baseROM.length() + sink.size() > _provisionalSize)
+    {
+        ok = false;
+    }
+
+    QByteArray compressedData;
+    {
+        QMutexLocker locker(&_mutex);
+        _finished = true;
+        _succeeded = ok;
+        if (ok)
+        {
+            compressedData = _compressed;
+        }
+    }
+
+    // Whatever was waiting can go ahead now, even if it's only to fail
+    emit readyRead();
+
+    if (ok)
+    {
+        emit compressionFinished(hashOfOriginal, compressedData);
+    }
+}
@@ -0,0 +1,76 @@
+#ifndef PIPELINEDROMBUILDER_H
+#define PIPELINEDROMBUILDER_H
+
+#include <QIODevice>
+#include <QMutex>
+#include "fc8compressor.h"
+
+class QThread;
+
+// A combined ROM (base ROM followed by an FC8 block-compressed disk image)
+// that can be written to the SIMM while the disk image is still being
+// compressed in the background. Reads never wait on the compressor; they stop
+// short at the first block that isn't done yet. bytesAvailable() says how much
+// can be read right now, and readyRead() is sent (from the compression thread)
+// whenever that grows.
+//
+// The block table comes right after the base ROM but isn't known until every
+// block is done, so it reads as 0xFF (erased) here. Once the write is done,
+// write finalImage() over blockTableOffset()/blockTableLength() to fill it in.
+//
+// Until the compression finishes, size() is the provisional size given to
+// the constructor; after that it's the real size, which is never larger.
+class PipelinedROMBuilder : public QIODevice
+{
+    Q_OBJECT
+public:
+    PipelinedROMBuilder(QByteArray const &baseROM, QByteArray const &diskImage, int blockSize,
+                        FC8Compressor::Mode mode, qint64 provisionalSize, QObject *parent = NULL);
+    ~PipelinedROMBuilder();
+
+    void start();
+
+    bool open(OpenMode mode);
+    bool isSequential() const;
+    qint64 size() const;
+    qint64 bytesAvailable() const;
+
+    bool isFinished() const;
+    bool succeeded() const;
+    QByteArray finalImage() const;
+    uint32_t blockTableOffset() const;
+    uint32_t blockTableLength() const;
+
+signals:
+    // Sent from the compression thread once everything is compressed, just
+    // like FC8Compressor's signal
+    void compressionFinished(QByteArray hashOfOriginal, QByteArray compressedData);
+
+protected:
+    qint64 readData(char *data, qint64 maxlen);
+    qint64 writeData(const char *data, qint64 len);
+
+private:
+    friend class PipelinedROMBuilderThread;
+    friend class PipelinedROMBuilderSink;
+
+    void runCompression();
+    void appendCompressed(qint64 offset, const char *data, qint64 len);
+
+    QByteArray _baseROM;
+    QByteArray _diskImage;
+    int _blockSize;
+    FC8Compressor::Mode _mode;
+    qint64 _provisionalSize;
+    QThread *_thread;
+
+    // Everything below is shared with the compression thread
+    mutable QMutex _mutex;
+    QByteArray _compressed;
+    qint64 _compressedFinal;
+    bool _finished;
+    bool _succeeded;
+    bool _cancelled;
+};
+
+#endif // PIPELINEDROMBUILDER_H
@@ -18,6 +18,7 @@
  */
 
 #include "programmer.h"
+#include "sectorindex.h"
 #include <QDebug>
 #include <QWaitCondition>
 #include <QMutex>
@@ -37,6 +38,7 @@ typedef enum ProgrammerCommandState
     WriteSIMMWaitingWriteReply,
     WriteSIMMWaitingFinishReply,
     WriteSIMMWaitingWriteMoreReply,
+    WriteSIMMWaitingForData,
 
     ElectricalTestWaitingStartReply,
     ElectricalTestWaitingNextStatus,
@@ -49,6 +51,7 @@ typedef enum ProgrammerCommandState
     ReadSIMMWaitingData,
     ReadSIMMWaitingStatusReply,
 
+    ResyncDrainingInput,
     BootloaderStateAwaitingOKReply,
     BootloaderStateAwaitingReply,
     BootloaderStateAwaitingOKReplyToBootloader,
@@ -79,6 +82,8 @@ typedef enum ProgrammerCommandState
     WritePortionWaitingEraseResult,
     WritePortionWaitingWriteAtReply,
 
+    WriteSetupWaitingPipelinedReplies,
+
     ReadFWVersionAwaitingOKReply,
     ReadFWVersionWaitingData,
     ReadFWVersionAwaitingDoneReply
@@ -205,21 +210,60 @@ typedef enum ProgrammerGetFWVersionReply
 
 #define BLOCK_ERASE_SIZE    (256*1024UL)
 
+// How long to wait for the programmer before giving up. Most replies come back
+// within a round trip, so that timeout follows the round trip times we've seen.
+// Erasing and USB re-enumeration take a lot longer than that.
+#define WATCHDOG_MIN_TIMEOUT_MS         2000
+#define WATCHDOG_MAX_TIMEOUT_MS         15000
+#define WATCHDOG_REPLUG_TIMEOUT_MS      15000
+#define WATCHDOG_LONG_COMMAND_MS        15000
+#define WATCHDOG_ERASE_BASE_MS          10000
+#define WATCHDOG_ERASE_PER_SECTOR_MS    4000
+#define WATCHDOG_ERASE_UNKNOWN_MS       180000
+
+// After losing track of the board, how long the line has to stay quiet before
+// we believe whatever it was still sending is all out of the way
+#define RESYNC_QUIET_MS                 250
+
+// How many times a read or write will pick back up where it left off after a
+// transfer error before giving up on the whole operation
+#define MAX_CHUNK_RETRIES   3
+
+// How often (in bytes written) to let everyone know how far a write has
+// safely gotten, and how much already-written data to double-check before
+// resuming an interrupted write
+#define WRITE_CHECKPOINT_INTERVAL   (64 * 1024)
+#define RESUME_CHECK_SIZE           (16 * 1024)
+
 static ProgrammerCommandState curState = WaitingForNextCommand;
 
 // After identifying that we're in the main program, what will be the command
 // we will send and the state we will be waiting in?
 static ProgrammerCommandState nextState = WaitingForNextCommand;
 static uint8_t nextSendByte = 0;
+static QByteArray nextSendPayload;
+
+// Which bootloader state check to start once the line has gone quiet
+static ProgrammerCommandState handshakeAfterDrain = WaitingForNextCommand;
 
 static ProgrammerBoardFoundState foundState = ProgrammerBoardNotFound;
 static QString programmerBoardPortName;
 
+// Same byte order as sendWord(), for building up data to send all at once
+static void appendWord(QByteArray &data, uint32_t w)
+{
+    data.append(static_cast<char>((w >> 0)  & 0xFF));
+    data.append(static_cast<char>((w >> 8)  & 0xFF));
+    data.append(static_cast<char>((w >> 16) & 0xFF));
+    data.append(static_cast<char>((w >> 24) & 0xFF));
+}
+
 Programmer::Programmer(QObject *parent) :
     QObject(parent),
-    _chipID(":/chipid/chipid.txt")
+    _chipID(ChipID::defaultOverlayFilePath())
 {
     detectedDeviceRevision = 0;
+    firmwareFile = NULL;
     identifyIsForWriteAttempt = false;
     identifyWriteIsEntireSIMM = false;
     _verifyMode = VerifyAfterWrite;
@@ -227,8 +271,47 @@ Programmer::Programmer(QObject *parent) :
     verifyArray = new QByteArray();
     verifyBuffer = new QBuffer(verifyArray);
     verifyBuffer->open(QBuffer::ReadWrite);
-    serialPort = new QextSerialPort(QextSerialPort::EventDriven);
+    portionArray = new QByteArray();
+    portionBuffer = new QBuffer(portionArray);
+    portionBuffer->open(QBuffer::ReadWrite);
+    replanArray = new QByteArray();
+    replanBuffer = new QBuffer(replanArray);
+    replanBuffer->open(QBuffer::ReadWrite);
+    portionBlockAligned = false;
+    retryCheckArray = new QByteArray();
+    retryCheckBuffer = new QBuffer(retryCheckArray);
+    retryCheckBuffer->open(QBuffer::ReadWrite);
+    chunkRetriesRemaining = MAX_CHUNK_RETRIES;
+    writeLenAcknowledged = 0;
+    writeResumeOffset = 0;
+    readDeviceStart = 0;
+    resetTelemetry();
+    sectorLayoutWidth = 0;
+    writeDeviceOffset = 0;
+    _sessionMode = false;
+    sessionBoardState = SessionBoardUnknown;
+    sessionFirmwareVersionKnown = false;
+    sessionFirmwareVersion = 0;
+    setupCapabilities = 0;
+    pipelinedRepliesRemaining = 0;
+    _simmCapacity = 0;
+    _simmChip = SIMM_PLCC_x8;
+    identificationCacheValid = false;
+    identificationIsProbe = false;
+    _identificationProbe = true;
+    previousIdentityKnown = false;
+    serialPort = ProgrammerTransport::create();
     connect(serialPort, SIGNAL(readyRead()), SLOT(dataReady()));
+    watchdogTimer = new QTimer(this);
+    watchdogTimer->setSingleShot(true);
+    connect(watchdogTimer, SIGNAL(timeout()), SLOT(watchdogTimeout()));
+    drainTimer = new QTimer(this);
+    drainTimer->setSingleShot(true);
+    connect(drainTimer, SIGNAL(timeout()), SLOT(drainFinished()));
+    drainBeforeHandshake = false;
+    awaitingReply = false;
+    smoothedReplyTime = 0;
+    replyTimeVariance = 0;
 }
 
 Programmer::~Programmer()
@@ -238,18 +321,33 @@ Programmer::~Programmer()
     verifyBuffer->close();
     delete verifyBuffer;
     delete verifyArray;
+    portionBuffer->close();
+    delete portionBuffer;
+    delete portionArray;
+    replanBuffer->close();
+    delete replanBuffer;
+    delete replanArray;
+    retryCheckBuffer->close();
+    delete retryCheckBuffer;
+    delete retryCheckArray;
 }
 
-void Programmer::readSIMM(QIODevice *device, uint32_t len)
+void Programmer::readSIMM(QIODevice *device, uint32_t len, uint32_t offset)
 {
-    // We're not verifying in this case
-    isReadVerifying = false;
-    internalReadSIMM(device, len);
+    // We're just dumping the SIMM in this case
+    readPurpose = ReadPurposeDump;
+
+    // Keep a running checksum of everything we read so the ROM can be
+    // validated as soon as the read finishes
+    _readChecksum.reset();
+    resetTelemetry();
+    internalReadSIMM(device, len, offset);
 }
 
 void Programmer::internalReadSIMM(QIODevice *device, uint32_t len, uint32_t offset)
 {
     readDevice = device;
+    readDeviceStart = device->pos();
     lenRead = 0;
     readOffset = offset;
 
@@ -274,7 +372,14 @@ void Programmer::internalReadSIMM(QIODevice *device, uint32_t len, uint32_t offs
         trueLenToRead = len;
     }
 
-    if (offset > 0)
+    startReadCommand();
+}
+
+// Asks the programmer for whatever is left of the current read. That's
+// normally all of it, unless we're picking up after a transfer error.
+void Programmer::startReadCommand()
+{
+    if (readOffset + lenRead > 0)
     {
         startProgrammerCommand(ReadChipsAt, ReadSIMMWaitingStartOffsetReply);
     }
@@ -297,17 +402,19 @@ void Programmer::writeToSIMM(QIODevice *device, uint8_t chipsMask)
     else
     {
         lenWritten = 0;
+        writeLenAcknowledged = 0;
         writeLenRemaining = writeDevice->size();
         writeOffset = 0;
+        writeDeviceOffset = 0;
+        writeResumeOffset = 0;
+        resetTelemetry();
 
         // Start out by identifying the chips so that we can send the correct
         // erase sector layout. We have to save some flags to indicate that the
         // identification is the start of a write. This isn't strictly necessary
         // for full chip erases, but I do it for consistency.
-        identifyIsForWriteAttempt = true;
         identifyWriteIsEntireSIMM = true;
-        identificationShiftCounter = 0;
-        startProgrammerCommand(SetSIMMLayout_AddressStraight, IdentificationWaitingSetSizeReply);
+        startWriteIdentification();
     }
 }
 
@@ -322,16 +429,20 @@ void Programmer::writeToSIMM(QIODevice *device, uint32_t startOffset, uint32_t l
         emit writeStatusChanged(WriteFileTooBig);
         return;
     }
-    else if ((startOffset % BLOCK_ERASE_SIZE) || (length % BLOCK_ERASE_SIZE))
-    {
-        curState = WaitingForNextCommand;
-        emit writeStatusChanged(WriteEraseBlockWrongSize);
-        return;
-    }
     else
     {
+        // The range doesn't have to line up with erase sectors. Once the chips
+        // are identified, planPortionWrite() widens it out to whole sectors
+        // and preserves whatever else lives in them.
         lenWritten = 0;
-        writeLenRemaining = writeDevice->size() - startOffset;
+        writeLenAcknowledged = 0;
+        writeLenRemaining = 0;
+        writeResumeOffset = 0;
+        resetTelemetry();
+        if (writeDevice->size() > startOffset)
+        {
+            writeLenRemaining = writeDevice->size() - startOffset;
+        }
         if (writeLenRemaining > length)
         {
             writeLenRemaining = length;
@@ -339,20 +450,303 @@ void Programmer::writeToSIMM(QIODevice *device, uint32_t startOffset, uint32_t l
         device->seek(startOffset);
         writeOffset = startOffset;
         writeLength = length;
+        writeDeviceOffset = 0;
+        portionBlockAligned = false;
 
         // Start out by identifying the chips so that we can send the correct
         // erase sector layout. We have to save some flags to indicate that the
         // identification is the start of a write.
-        identifyIsForWriteAttempt = true;
         identifyWriteIsEntireSIMM = false;
-        identificationShiftCounter = 0;
-        startProgrammerCommand(SetSIMMLayout_AddressStraight, IdentificationWaitingSetSizeReply);
+        startWriteIdentification();
+    }
+}
+
+// Picks up an entire-SIMM write that was interrupted after everything
+// before resumeOffset was written. The chips are set up the same way as the
+// original write, but nothing gets erased. Instead, the end of what was
+// already written is checked before the write carries on from there.
+void Programmer::resumeWriteToSIMM(QIODevice *device, uint32_t resumeOffset, uint8_t chipsMask)
+{
+    writeDevice = device;
+    writeChipMask = chipsMask;
+    if (writeDevice->size() > SIMMCapacity())
+    {
+        curState = WaitingForNextCommand;
+        emit writeStatusChanged(WriteFileTooBig);
+        return;
+    }
+    else if (resumeOffset == 0 || resumeOffset >= writeDevice->size())
+    {
+        // Nothing to resume, so it's just a regular write
+        writeToSIMM(device, chipsMask);
+        return;
+    }
+
+    lenWritten = 0;
+    writeLenAcknowledged = 0;
+    writeLenRemaining = writeDevice->size();
+    writeOffset = 0;
+    writeDeviceOffset = 0;
+    writeResumeOffset = resumeOffset;
+    resetTelemetry();
+
+    identifyWriteIsEntireSIMM = true;
+    startWriteIdentification();
+}
+
+void Programmer::startWriteIdentification()
+{
+    identifyIsForWriteAttempt = true;
+    identificationShiftCounter = 0;
+    identificationIsProbe = false;
+
+    // If we've already identified the chips in this SIMM, we don't have to
+    // do it again. Unless we were told to trust the cache completely, do a
+    // quick check that the chips still answer the same way, in case the
+    // SIMM was swapped. That's just the first half of a full identification,
+    // so if they don't match, the identification carries on as usual.
+    if (identificationCacheValid)
+    {
+        if (!_identificationProbe)
+        {
+            updateSectorLayoutFromIdentity();
+            startWriteAfterIdentification();
+            return;
+        }
+
+        identificationIsProbe = true;
+        memcpy(probeManufacturerIDs, chipManufacturerIDs[0], sizeof(probeManufacturerIDs));
+        memcpy(probeDeviceIDs, chipDeviceIDs[0], sizeof(probeDeviceIDs));
+    }
+
+    startProgrammerCommand(SetSIMMLayout_AddressStraight, IdentificationWaitingSetSizeReply);
+}
+
+// Looks up the erase sector layout for the chips we identified. If we can't
+// find anything, fall back to empty erase sector info.
+void Programmer::updateSectorLayoutFromIdentity()
+{
+    sectorGroups.clear();
+    sectorLayoutWidth = 0;
+
+    // We have to convert the ID info into a format that is usable by ChipID
+    QList<uint8_t> manufacturersStraight;
+    QList<uint8_t> devicesStraight;
+    QList<uint8_t> manufacturersShifted;
+    QList<uint8_t> devicesShifted;
+    for (int i = 0; i < 4; i++)
+    {
+        manufacturersStraight << chipManufacturerIDs[0][i];
+        devicesStraight << chipDeviceIDs[0][i];
+        manufacturersShifted << chipManufacturerIDs[1][i];
+        devicesShifted << chipDeviceIDs[1][i];
+    }
+
+    // Now ask ChipID to tell us what we have
+    QList<ChipID::ChipInfo> chipInfo;
+    if (_chipID.findChips(manufacturersStraight, devicesStraight,
+                          manufacturersShifted, devicesShifted,
+                          chipInfo))
+    {
+        // Use the sector info of the first valid chip we find in the info returned
+        foreach (ChipID::ChipInfo const &info, chipInfo)
+        {
+            if (info.capacity != 0)
+            {
+                sectorGroups = info.sectors;
+                sectorLayoutWidth = info.width;
+                break;
+            }
+        }
+    }
+}
+
+void Programmer::startWriteAfterIdentification()
+{
+    if (identifyWriteIsEntireSIMM)
+    {
+        startWriteSetup();
+    }
+    else
+    {
+        planPortionWrite();
+    }
+}
+
+void Programmer::planPortionWrite()
+{
+    // Figure out which erase sectors the requested range touches. If we
+    // couldn't identify the chips, or the firmware can't be told about
+    // their sectors, assume the firmware's fixed erase size.
+    uint32_t eraseStart;
+    uint32_t eraseEnd;
+    SectorIndex sectors(sectorGroups, sectorLayoutWidth, SIMMCapacity());
+    SectorIndex::Span span;
+    if (writeLength == 0)
+    {
+        eraseStart = writeOffset;
+        eraseEnd = writeOffset;
+    }
+    else if (!portionBlockAligned && sectors.isValid() && sectors.span(writeOffset, writeLength, span))
+    {
+        eraseStart = span.start;
+        eraseEnd = span.end;
+    }
+    else
+    {
+        eraseStart = writeOffset - (writeOffset % BLOCK_ERASE_SIZE);
+        eraseEnd = writeOffset + writeLength;
+        if (eraseEnd % BLOCK_ERASE_SIZE)
+        {
+            eraseEnd += BLOCK_ERASE_SIZE - (eraseEnd % BLOCK_ERASE_SIZE);
+        }
+        if (eraseEnd > SIMMCapacity())
+        {
+            eraseEnd = SIMMCapacity();
+        }
+    }
+
+    // If the range already covers whole sectors, there's nothing to preserve
+    if ((eraseStart == writeOffset) && (eraseEnd == writeOffset + writeLength))
+    {
+        startWriteSetup();
+        return;
+    }
+
+    // Otherwise, read whatever's in those sectors outside of the requested
+    // range so it can be written back afterward. The merged copy of the
+    // sectors is built up in portionArray.
+    portionArray->fill(0xFF, eraseEnd - eraseStart);
+    preserveRegions.clear();
+    if (eraseStart < writeOffset)
+    {
+        preserveRegions << qMakePair(eraseStart, writeOffset - eraseStart);
+    }
+    if (writeOffset + writeLength < eraseEnd)
+    {
+        // Start on a read chunk boundary; the overlap gets replaced with new
+        // data when everything is merged together
+        uint32_t tailStart = writeOffset + writeLength;
+        tailStart -= tailStart % READ_CHUNK_SIZE;
+        if (tailStart < eraseStart)
+        {
+            tailStart = eraseStart;
+        }
+        preserveRegions << qMakePair(tailStart, eraseEnd - tailStart);
+    }
+
+    portionEraseStart = eraseStart;
+    emit writeStatusChanged(WritePreservingData);
+    readNextPreserveRegion();
+}
+
+// The firmware turned out not to know about sector layouts, so it's going
+// to erase in BLOCK_ERASE_SIZE pieces. Plan the write over again with those,
+// starting from whatever was going to be written before.
+void Programmer::replanPortionWriteForBlockErase()
+{
+    portionBlockAligned = true;
+
+    // The merged sectors from the first plan get built up again in
+    // portionArray, so they need to be somewhere else to be read from
+    if (writeDevice == portionBuffer)
+    {
+        *replanArray = *portionArray;
+        writeDevice = replanBuffer;
+    }
+
+    writeLenRemaining = writeLength;
+    if (writeDevice->size() < writeOffset + writeLength - writeDeviceOffset)
+    {
+        writeLenRemaining = (writeDevice->size() > writeOffset - writeDeviceOffset) ?
+                    writeDevice->size() - (writeOffset - writeDeviceOffset) : 0;
     }
+    lenWritten = 0;
+    writeLenAcknowledged = 0;
+    planPortionWrite();
+}
+
+void Programmer::readNextPreserveRegion()
+{
+    if (!preserveRegions.isEmpty())
+    {
+        QPair<uint32_t, uint32_t> region = preserveRegions.takeFirst();
+        readPurpose = ReadPurposePreserve;
+        portionBuffer->seek(region.first - portionEraseStart);
+        internalReadSIMM(portionBuffer, region.second, region.first);
+        return;
+    }
+
+    // Everything we need to keep has been read. Drop the new data on top
+    // of it; anything in the requested range past the end of the device
+    // stays erased, same as it would have without the widening.
+    uint32_t rangeStart = writeOffset - portionEraseStart;
+    writeDevice->seek(writeOffset - writeDeviceOffset);
+    QByteArray newData = writeDevice->read(writeLenRemaining);
+    memcpy(portionArray->data() + rangeStart, newData.constData(), newData.size());
+    memset(portionArray->data() + rangeStart + newData.size(), 0xFF, writeLength - newData.size());
+
+    // From here on, write out the merged sectors instead
+    writeDevice = portionBuffer;
+    writeDevice->seek(0);
+    writeDeviceOffset = portionEraseStart;
+    writeOffset = portionEraseStart;
+    writeLength = portionArray->size();
+    writeLenRemaining = writeLength;
+    lenWritten = 0;
+    writeLenAcknowledged = 0;
+
+    startWriteSetup();
+}
+
+// Configures the programmer for the write: sector layout, SIMM layout,
+// verify mode and chip mask. Normally each of these waits for its reply
+// before the next one goes out. Once this board has accepted all of them,
+// there's no reason to expect otherwise, so they're all sent at once
+// and the replies are checked as they come back.
+void Programmer::startWriteSetup()
+{
+    if (setupCapabilities != SetupCapabilityAll)
+    {
+        if (identifyWriteIsEntireSIMM)
+        {
+            startProgrammerCommand(SetSectorLayout, WriteSIMMWaitingSetSectorLayoutReply);
+        }
+        else
+        {
+            startProgrammerCommand(SetSectorLayout, WritePortionWaitingSetSectorLayoutReply);
+        }
+        return;
+    }
+
+    QByteArray setup;
+
+    // Everything that follows the SetSectorLayout command byte: the layout
+    // itself, then each of the other commands. Each one gets a reply.
+    for (int i = 0; i < sectorGroups.count(); i++)
+    {
+        appendWord(setup, sectorGroups[i].first);
+        appendWord(setup, sectorGroups[i].second);
+    }
+    appendWord(setup, 0);
+    setup.append(static_cast<char>((SIMMChip() == SIMM_TSOP_x8) ?
+                                   SetSIMMLayout_AddressShifted : SetSIMMLayout_AddressStraight));
+    setup.append(static_cast<char>((verifyMode() == VerifyWhileWriting) ?
+                                   SetVerifyWhileWriting : SetNoVerifyWhileWriting));
+    setup.append(static_cast<char>(SetChipsMask));
+    setup.append(static_cast<char>(writeChipMask));
+
+    // SetSectorLayout, layout data, SetSIMMLayout, verify mode,
+    // SetChipsMask and the mask value
+    pipelinedRepliesRemaining = 6;
+    startProgrammerCommand(SetSectorLayout, WriteSetupWaitingPipelinedReplies, setup);
 }
 
 void Programmer::sendByte(uint8_t b)
 {
     serialPort->write((const char *)&b, 1);
+    awaitingReply = true;
+    replyTimer.start();
 }
 
 void Programmer::sendWord(uint32_t w)
@@ -373,10 +767,283 @@ uint8_t Programmer::readByte()
 
 void Programmer::dataReady()
 {
+    // Keep track of how long the programmer takes to answer us, but only
+    // for replies that don't involve something slow like an erase
+    bool adaptive;
+    watchdogTimeoutForState(adaptive);
+    if (awaitingReply && adaptive)
+    {
+        sampleReplyTime(replyTimer.elapsed());
+    }
+    awaitingReply = false;
+
     while (!serialPort->atEnd())
     {
         handleChar(readByte());
     }
+
+    restartWatchdog();
+}
+
+void Programmer::sampleReplyTime(qint64 ms)
+{
+    // Smoothed round trip time and deviation, the same way TCP does it
+    if (smoothedReplyTime == 0)
+    {
+        smoothedReplyTime = ms;
+        replyTimeVariance = ms / 2.0;
+    }
+    else
+    {
+        replyTimeVariance = 0.75 * replyTimeVariance + 0.25 * qAbs(smoothedReplyTime - ms);
+        smoothedReplyTime = 0.875 * smoothedReplyTime + 0.125 * ms;
+    }
+}
+
+// Returns how long we should wait in the current state before deciding the
+// programmer is stuck, or 0 if we aren't waiting for anything.
+int Programmer::watchdogTimeoutForState(bool &adaptive) const
+{
+    adaptive = false;
+
+    switch (curState)
+    {
+    case WaitingForNextCommand:
+        return 0;
+
+    // The board is resetting into the bootloader or the programmer
+    case BootloaderStateAwaitingUnplug:
+    case BootloaderStateAwaitingPlug:
+    case BootloaderStateAwaitingUnplugToBootloader:
+    case BootloaderStateAwaitingPlugToBootloader:
+        return WATCHDOG_REPLUG_TIMEOUT_MS;
+
+    // The replies to these come back after the SIMM is erased
+    case WriteSIMMWaitingEraseReply:
+    case WritePortionWaitingEraseResult:
+        return expectedEraseTimeout();
+
+    // Erasing the programmer's own flash or running the electrical test,
+    // or waiting for the next chunk of a ROM that's still being built.
+    // A board that never stops talking after a resync is just as stuck.
+    case BootloaderEraseProgramAwaitingStartOKReply:
+    case ElectricalTestWaitingNextStatus:
+    case WriteSIMMWaitingForData:
+    case ResyncDrainingInput:
+        return WATCHDOG_LONG_COMMAND_MS;
+
+    default:
+    {
+        adaptive = true;
+        const int timeout = static_cast<int>(smoothedReplyTime + 4 * replyTimeVariance);
+        return qBound(WATCHDOG_MIN_TIMEOUT_MS, timeout, WATCHDOG_MAX_TIMEOUT_MS);
+    }
+    }
+}
+
+SectorIndex Programmer::sectorIndex() const
+{
+    return SectorIndex(sectorGroups, sectorLayoutWidth, SIMMCapacity());
+}
+
+uint32_t Programmer::fallbackEraseSize()
+{
+    return BLOCK_ERASE_SIZE;
+}
+
+// Erase time depends on how many sectors are being erased. It's a pretty
+// generous estimate, since some older chips can take several seconds per sector.
+int Programmer::expectedEraseTimeout() const
+{
+    SectorIndex sectors(sectorGroups, sectorLayoutWidth, SIMMCapacity());
+    if (!sectors.isValid())
+    {
+        return WATCHDOG_ERASE_UNKNOWN_MS;
+    }
+
+    int sectorCount = sectors.sectorCount();
+    SectorIndex::Span span;
+    if ((curState == WritePortionWaitingEraseResult) &&
+        sectors.span(writeOffset, writeLength, span))
+    {
+        sectorCount = span.lastSector - span.firstSector + 1;
+    }
+
+    return WATCHDOG_ERASE_BASE_MS + sectorCount * WATCHDOG_ERASE_PER_SECTOR_MS;
+}
+
+void Programmer::restartWatchdog()
+{
+    // Draining gets one timeout in total, not one per byte, or a board
+    // that never stops talking would keep us waiting forever
+    if (curState == ResyncDrainingInput && watchdogTimer->isActive())
+    {
+        return;
+    }
+
+    bool adaptive;
+    const int timeout = watchdogTimeoutForState(adaptive);
+    if (timeout > 0)
+    {
+        watchdogTimer->start(timeout);
+    }
+    else
+    {
+        watchdogTimer->stop();
+    }
+}
+
+void Programmer::watchdogTimeout()
+{
+    if (curState == WaitingForNextCommand)
+    {
+        return;
+    }
+
+    qDebug() << "Timed out waiting for the programmer in state" << curState;
+    const ProgrammerCommandState stalledState = curState;
+    curState = WaitingForNextCommand;
+
+    // We have no idea what the board is doing now, so start over with a
+    // fresh connection for the next operation
+    resyncSession();
+
+    // A transfer that stalls partway through might just need a nudge
+    switch (stalledState)
+    {
+    case ReadSIMMWaitingStartReply:
+    case ReadSIMMWaitingStartOffsetReply:
+    case ReadSIMMWaitingLengthReply:
+    case ReadSIMMWaitingData:
+    case ReadSIMMWaitingStatusReply:
+        if (retryReadChunk())
+        {
+            return;
+        }
+        break;
+    case WriteSIMMWaitingWriteReply:
+    case WriteSIMMWaitingWriteMoreReply:
+        if (retryWriteChunk())
+        {
+            return;
+        }
+        break;
+    default:
+        break;
+    }
+
+    emitTimedOut(stalledState);
+}
+
+// Lets whoever started the operation that stalled in this state know about it
+void Programmer::emitTimedOut(uint32_t state)
+{
+    switch ((ProgrammerCommandState)state)
+    {
+    case WaitingForNextCommand:
+        break;
+
+    // Stuck before the real command was sent; it's the command we were
+    // getting ready to send that timed out
+    case ResyncDrainingInput:
+    case BootloaderStateAwaitingOKReply:
+    case BootloaderStateAwaitingReply:
+    case BootloaderStateAwaitingOKReplyToBootloader:
+    case BootloaderStateAwaitingReplyToBootloader:
+    case BootloaderStateAwaitingUnplug:
+    case BootloaderStateAwaitingPlug:
+    case BootloaderStateAwaitingUnplugToBootloader:
+    case BootloaderStateAwaitingPlugToBootloader:
+        emitTimedOut(nextState);
+        break;
+
+    case WriteSIMMWaitingSetSectorLayoutReply:
+    case WriteSIMMWaitingSectorLayoutDataReply:
+    case WriteSIMMWaitingSetSizeReply:
+    case WriteSIMMWaitingSetVerifyModeReply:
+    case WriteSIMMWaitingSetChipMaskReply:
+    case WriteSIMMWaitingSetChipMaskValueReply:
+    case WriteSIMMWaitingEraseReply:
+    case WriteSIMMWaitingWriteReply:
+    case WriteSIMMWaitingFinishReply:
+    case WriteSIMMWaitingWriteMoreReply:
+    case WriteSIMMWaitingForData:
+    case WritePortionWaitingSetSectorLayoutReply:
+    case WritePortionWaitingSectorLayoutDataReply:
+    case WritePortionWaitingSetSizeReply:
+    case WritePortionWaitingSetVerifyModeReply:
+    case WritePortionWaitingSetChipMaskReply:
+    case WritePortionWaitingSetChipMaskValueReply:
+    case WritePortionWaitingEraseReply:
+    case WritePortionWaitingEraseConfirmation:
+    case WritePortionWaitingEraseResult:
+    case WritePortionWaitingWriteAtReply:
+    case WriteSetupWaitingPipelinedReplies:
+        emit writeStatusChanged(WriteTimedOut);
+        break;
+
+    case ReadSIMMWaitingStartReply:
+    case ReadSIMMWaitingStartOffsetReply:
+    case ReadSIMMWaitingLengthReply:
+    case ReadSIMMWaitingData:
+    case ReadSIMMWaitingStatusReply:
+        if (readPurpose == ReadPurposeDump)
+        {
+            emit readStatusChanged(ReadTimedOut);
+        }
+        else if (readPurpose == ReadPurposeVerify)
+        {
+            // Ensure the verify buffer is empty if we were verifying
+            verifyArray->clear();
+            verifyBuffer->seek(0);
+            emit writeStatusChanged(WriteVerifyTimedOut);
+        }
+        else
+        {
+            emit writeStatusChanged(WriteTimedOut);
+        }
+        break;
+
+    case IdentificationWaitingSetSizeReply:
+    case IdentificationAwaitingOKReply:
+    case IdentificationWaitingData:
+    case IdentificationAwaitingDoneReply:
+        if (!identifyIsForWriteAttempt)
+        {
+            emit identificationStatusChanged(IdentificationTimedOut);
+        }
+        else
+        {
+            emit writeStatusChanged(WriteTimedOut);
+        }
+        break;
+
+    case ElectricalTestWaitingStartReply:
+    case ElectricalTestWaitingNextStatus:
+    case ElectricalTestWaitingFirstFail:
+    case ElectricalTestWaitingSecondFail:
+        emit electricalTestStatusChanged(ElectricalTestTimedOut);
+        break;
+
+    case BootloaderEraseProgramAwaitingStartOKReply:
+    case BootloaderEraseProgramWaitingFinishReply:
+    case BootloaderEraseProgramWaitingWriteMoreReply:
+    case BootloaderEraseProgramWaitingWriteReply:
+        if (firmwareFile)
+        {
+            firmwareFile->close();
+            delete firmwareFile;
+            firmwareFile = NULL;
+        }
+        emit firmwareFlashStatusChanged(FirmwareFlashTimedOut);
+        break;
+
+    case ReadFWVersionAwaitingOKReply:
+    case ReadFWVersionWaitingData:
+    case ReadFWVersionAwaitingDoneReply:
+        emit readFirmwareVersionStatusChanged(ReadFirmwareVersionError, 0);
+        break;
+    }
 }
 
 void Programmer::handleChar(uint8_t c)
@@ -387,6 +1054,12 @@ void Programmer::handleChar(uint8_t c)
         // Not expecting anything. Ignore it.
         break;
 
+    // Left over from before we lost track of the board. Throw it away and
+    // keep waiting for the line to go quiet.
+    case ResyncDrainingInput:
+        drainTimer->start(RESYNC_QUIET_MS);
+        break;
+
     // Expecting reply after we told the programmer the sector layout to use.
     // Go ahead and send the sector layout even if we're doing a full erase.
     // It makes the code more maintainable and opens up possibilities for the future.
@@ -396,6 +1069,7 @@ void Programmer::handleChar(uint8_t c)
         {
         case CommandReplyOK:
             // We are talking with firmware that supports receiving sector layout data! Yay!
+            setupCapabilities |= SetupCapabilitySectorLayout;
             for (int i = 0; i < sectorGroups.count(); i++)
             {
                 // Send the count of sectors in this group
@@ -412,7 +1086,27 @@ void Programmer::handleChar(uint8_t c)
         case CommandReplyInvalid:
         case CommandReplyError:
         default:
-            // If this command fails, just silently ignore the error and move
+            // Older firmware doesn't know about sector layouts and always erases
+            // in BLOCK_ERASE_SIZE pieces, so a portion that was widened to the
+            // chips' real sectors has to line up with those instead.
+            if ((curState == WritePortionWaitingSetSectorLayoutReply) &&
+                ((writeOffset % BLOCK_ERASE_SIZE) || (writeLength % BLOCK_ERASE_SIZE)))
+            {
+                if (portionBlockAligned)
+                {
+                    // Already tried; it can't be lined up any better
+                    curState = WaitingForNextCommand;
+                    releasePort();
+                    emit writeStatusChanged(WriteEraseBlockWrongSize);
+                }
+                else
+                {
+                    replanPortionWriteForBlockErase();
+                }
+                break;
+            }
+
+            // Otherwise, just silently ignore the error and move
             // onto setting the SIMM address unlock pattern instead.
             uint8_t setLayoutCommand = (SIMMChip() == SIMM_TSOP_x8) ?
                     SetSIMMLayout_AddressShifted : SetSIMMLayout_AddressStraight;
@@ -442,7 +1136,7 @@ void Programmer::handleChar(uint8_t c)
             // so we need to return an error.
             qDebug() << "Error reply sending erase sector layout.";
             curState = WaitingForNextCommand;
-            closePort();
+            releasePort();
             emit writeStatusChanged(WriteError);
             break;
         }
@@ -457,6 +1151,7 @@ void Programmer::handleChar(uint8_t c)
         case CommandReplyOK:
             // If we got an OK reply, we're good to go. Next, check for the
             // "verify while writing" capability if needed...
+            setupCapabilities |= SetupCapabilitySIMMLayout;
 
             uint8_t verifyCommand;
             if (verifyMode() == VerifyWhileWriting)
@@ -490,7 +1185,7 @@ void Programmer::handleChar(uint8_t c)
                 // firmware update.
                 qDebug() << "Programmer board needs firmware update.";
                 curState = WaitingForNextCommand;
-                closePort();
+                releasePort();
                 emit writeStatusChanged(WriteNeedsFirmwareUpdateBiggerSIMM);
             }
             else
@@ -534,6 +1229,7 @@ void Programmer::handleChar(uint8_t c)
         {
         case CommandReplyOK:
             // If we got an OK reply, we're good. Now try to set the chip mask.
+            setupCapabilities |= SetupCapabilityVerifyMode;
             if (curState == WriteSIMMWaitingSetVerifyModeReply)
             {
                 sendByte(SetChipsMask);
@@ -557,7 +1253,7 @@ void Programmer::handleChar(uint8_t c)
                 // needs a firmware update.
                 qDebug() << "Programmer board needs firmware update.";
                 curState = WaitingForNextCommand;
-                closePort();
+                releasePort();
                 emit writeStatusChanged(WriteNeedsFirmwareUpdateVerifyWhileWrite);
             }
             else
@@ -608,19 +1304,7 @@ void Programmer::handleChar(uint8_t c)
             if (writeChipMask == 0x0F)
             {
                 // OK, erase the SIMM and get the ball rolling.
-                // Special case: Send out notification we are starting an erase command.
-                // I don't have any hooks into the process between now and the erase reply.
-                emit writeStatusChanged(WriteErasing);
-                if (curState == WriteSIMMWaitingSetChipMaskReply)
-                {
-                    sendByte(EraseChips);
-                    curState = WriteSIMMWaitingEraseReply;
-                }
-                else if (curState == WritePortionWaitingSetChipMaskReply)
-                {
-                    sendByte(ErasePortion);
-                    curState = WritePortionWaitingEraseReply;
-                }
+                startErase();
             }
             else
             {
@@ -629,7 +1313,7 @@ void Programmer::handleChar(uint8_t c)
                 // needs a firmware update.
                 qDebug() << "Programmer board needs firmware update.";
                 curState = WaitingForNextCommand;
-                closePort();
+                releasePort();
                 emit writeStatusChanged(WriteNeedsFirmwareUpdateIndividualChips);
             }
             break;
@@ -642,27 +1326,17 @@ void Programmer::handleChar(uint8_t c)
         switch (c)
         {
         case CommandReplyOK:
+            setupCapabilities |= SetupCapabilityChipMask;
+
             // OK, erase the SIMM and get the ball rolling.
-            // Special case: Send out notification we are starting an erase command.
-            // I don't have any hooks into the process between now and the erase reply.
-            emit writeStatusChanged(WriteErasing);
-            if (curState == WriteSIMMWaitingSetChipMaskValueReply)
-            {
-                sendByte(EraseChips);
-                curState = WriteSIMMWaitingEraseReply;
-            }
-            else if (curState == WritePortionWaitingSetChipMaskValueReply)
-            {
-                sendByte(ErasePortion);
-                curState = WritePortionWaitingEraseReply;
-            }
+            startErase();
             break;
         case CommandReplyInvalid:
         case CommandReplyError:
             // Error after trying to set the value.
             qDebug() << "Error reply setting chip mask.";
             curState = WaitingForNextCommand;
-            closePort();
+            releasePort();
             emit writeStatusChanged(WriteError);
             break;
         }
@@ -685,7 +1359,7 @@ void Programmer::handleChar(uint8_t c)
         case CommandReplyError:
             qDebug() << "Error erasing chips.";
             curState = WaitingForNextCommand;
-            closePort();
+            releasePort();
             emit writeStatusChanged(WriteEraseFailed);
             break;
         }
@@ -709,7 +1383,7 @@ void Programmer::handleChar(uint8_t c)
             // needs a firmware update.
             qDebug() << "Programmer board needs firmware update.";
             curState = WaitingForNextCommand;
-            closePort();
+            releasePort();
             emit writeStatusChanged(WriteNeedsFirmwareUpdateErasePortion);
             break;
         }
@@ -727,7 +1401,7 @@ void Programmer::handleChar(uint8_t c)
             // Programmer didn't like the position/length we gave it
             qDebug() << "Programmer didn't like erase pos/length.";
             curState = WaitingForNextCommand;
-            closePort();
+            releasePort();
             emit writeStatusChanged(WriteEraseFailed);
             break;
         }
@@ -751,7 +1425,7 @@ void Programmer::handleChar(uint8_t c)
             // Programmer failed to erase
             qDebug() << "Programmer had error erasing.";
             curState = WaitingForNextCommand;
-            closePort();
+            releasePort();
             emit writeStatusChanged(WriteEraseFailed);
             break;
         }
@@ -764,10 +1438,12 @@ void Programmer::handleChar(uint8_t c)
         switch (c)
         {
         case CommandReplyOK:
-            sendWord(writeOffset);
-            qDebug() << "Sending" << writeOffset;
+            // Normally this starts at the beginning of the range, but it
+            // might be picking up where an interrupted write left off
+            sendWord(writeOffset + lenWritten);
+            qDebug() << "Sending" << writeOffset + lenWritten;
             curState = WriteSIMMWaitingWriteReply;
-            emit writeTotalLengthChanged(writeLenRemaining);
+            emit writeTotalLengthChanged(lenWritten + writeLenRemaining);
             emit writeCompletionLengthChanged(lenWritten);
             qDebug() << "Partial write command accepted, sending offset...";
             break;
@@ -777,7 +1453,7 @@ void Programmer::handleChar(uint8_t c)
             // Programmer failed to erase
             qDebug() << "Programmer didn't accept 'write at' command.";
             curState = WaitingForNextCommand;
-            closePort();
+            releasePort();
             emit writeStatusChanged(WriteError);
             break;
         }
@@ -785,6 +1461,29 @@ void Programmer::handleChar(uint8_t c)
         break;
     }
 
+    // Expecting the replies to a write setup that was sent all at once
+    case WriteSetupWaitingPipelinedReplies:
+        if (c == CommandReplyOK)
+        {
+            if (--pipelinedRepliesRemaining == 0)
+            {
+                // Everything was accepted, so erase the SIMM and get the ball rolling
+                startErase();
+            }
+        }
+        else
+        {
+            // The board didn't accept something it accepted before. There's
+            // no telling what it made of the rest of what we sent, so start
+            // over with a clean connection and go one step at a time from now on.
+            qDebug() << "Pipelined write setup was rejected.";
+            curState = WaitingForNextCommand;
+            setupCapabilities = 0;
+            closePort();
+            emit writeStatusChanged(WriteError);
+        }
+        break;
+
     // Expecting reply from programmer after we sent a chunk of data to write
     // (or after we first told it we're going to start writing)
     case WriteSIMMWaitingWriteReply:
@@ -794,7 +1493,7 @@ void Programmer::handleChar(uint8_t c)
             _verifyBadChipMask = c & ~ProgrammerWriteVerificationError;
             qDebug() << "Verification error during write.";
             curState = WaitingForNextCommand;
-            closePort();
+            releasePort();
             emit writeStatusChanged(WriteVerificationFailure);
             break;
         }
@@ -803,12 +1502,19 @@ void Programmer::handleChar(uint8_t c)
             switch (c)
             {
             case CommandReplyOK:
+                // Everything we've sent so far has made it into the chips.
+                // Every so often, let whoever's keeping track know about it.
+                if (lenWritten / WRITE_CHECKPOINT_INTERVAL != writeLenAcknowledged / WRITE_CHECKPOINT_INTERVAL)
+                {
+                    emit writeCheckpoint(writeOffset + lenWritten);
+                }
+                writeLenAcknowledged = lenWritten;
+                refreshWriteLength();
+
                 // We're in write SIMM mode. Now ask to start writing
                 if (writeLenRemaining > 0)
                 {
-                    sendByte(ComputerWriteMore);
-                    curState = WriteSIMMWaitingWriteMoreReply;
-                    qDebug() << "Write more..." << writeLenRemaining << "remaining.";
+                    requestNextWriteChunk();
                 }
                 else
                 {
@@ -819,9 +1525,12 @@ void Programmer::handleChar(uint8_t c)
                 break;
             case CommandReplyError:
                 qDebug() << "Error entering write mode.";
-                curState = WaitingForNextCommand;
-                closePort();
-                emit writeStatusChanged(WriteError);
+                if (!retryWriteChunk())
+                {
+                    curState = WaitingForNextCommand;
+                    releasePort();
+                    emit writeStatusChanged(WriteError);
+                }
                 break;
             }
         }
@@ -839,6 +1548,7 @@ void Programmer::handleChar(uint8_t c)
             qDebug() << "Programmer replied OK to send 1024 bytes of data! Sending...";
             // Write the next chunk of data to the SIMM...
 
+            refreshWriteLength();
             int chunkSize = WRITE_CHUNK_SIZE;
             if (writeLenRemaining < WRITE_CHUNK_SIZE)
             {
@@ -847,6 +1557,16 @@ void Programmer::handleChar(uint8_t c)
 
             // Read the chunk from the file!
             QByteArray thisChunk = writeDevice->read(chunkSize);
+            if (thisChunk.size() != chunkSize)
+            {
+                // The board is expecting a full chunk, and there's no good
+                // way to make one up
+                qDebug() << "Couldn't read the next chunk to write.";
+                curState = WaitingForNextCommand;
+                releasePort();
+                emit writeStatusChanged(WriteError);
+                break;
+            }
 
             // If it isn't a WRITE_CHUNK_SIZE chunk, pad the rest of it with 0xFFs (unprogrammed bytes)
             // so the total chunk size is WRITE_CHUNK_SIZE, since that's what the programmer board expects.
@@ -869,9 +1589,12 @@ void Programmer::handleChar(uint8_t c)
         case ProgrammerWriteError:
         default:
             qDebug() << "Error writing to chips.";
-            curState = WaitingForNextCommand;
-            closePort();
-            emit writeStatusChanged(WriteError);
+            if (!retryWriteChunk())
+            {
+                curState = WaitingForNextCommand;
+                releasePort();
+                emit writeStatusChanged(WriteError);
+            }
             break;
         }
         break;
@@ -884,22 +1607,22 @@ void Programmer::handleChar(uint8_t c)
         case ProgrammerWriteOK:
             if (verifyMode() == VerifyAfterWrite)
             {
-                isReadVerifying = true;
+                readPurpose = ReadPurposeVerify;
 
                 // Ensure the verify buffer is empty
                 verifyArray->clear();
                 verifyBuffer->seek(0);
                 verifyLength = lenWritten;
 
-                // Start reading from the SIMM now!
+                // Start reading back what we just wrote from the SIMM now!
                 emit writeStatusChanged(WriteVerifying);
-                internalReadSIMM(verifyBuffer, writeDevice->size());
+                internalReadSIMM(verifyBuffer, lenWritten, writeOffset);
             }
             else
             {
                 curState = WaitingForNextCommand;
                 qDebug() << "Write success at end";
-                closePort();
+                releasePort();
 
                 // Emit the correct signal based on how we finished
                 if (verifyMode() == NoVerification)
@@ -917,7 +1640,7 @@ void Programmer::handleChar(uint8_t c)
         default:
             qDebug() << "Write failure at end";
             curState = WaitingForNextCommand;
-            closePort();
+            releasePort();
             emit writeStatusChanged(WriteError);
             break;
         }
@@ -939,7 +1662,7 @@ void Programmer::handleChar(uint8_t c)
         case CommandReplyInvalid:
         default:
             curState = WaitingForNextCommand;
-            closePort();
+            releasePort();
             emit electricalTestStatusChanged(ElectricalTestCouldntStart);
         }
         break;
@@ -951,7 +1674,7 @@ void Programmer::handleChar(uint8_t c)
         {
         case ProgrammerElectricalTestDone:
             curState = WaitingForNextCommand;
-            closePort();
+            releasePort();
             if (electricalTestErrorCounter > 0)
             {
                 emit electricalTestStatusChanged(ElectricalTestFailed);
@@ -987,41 +1710,34 @@ void Programmer::handleChar(uint8_t c)
         {
         case CommandReplyOK:
 
-            if (!isReadVerifying)
+            if (readPurpose == ReadPurposeDump)
             {
                 emit readStatusChanged(ReadStarting);
             }
-            else
+            else if (readPurpose == ReadPurposeVerify)
             {
                 emit writeStatusChanged(WriteVerifyStarting);
             }
 
-            curState = ReadSIMMWaitingLengthReply;
-
-            // Send the length requesting to be read (and offset if needed)
-            if (c == ReadSIMMWaitingStartOffsetReply)
+            // Send the length requesting to be read (and offset if needed).
+            // Check which command this was before moving onto the next state.
+            if (curState == ReadSIMMWaitingStartOffsetReply)
             {
-                sendWord(readOffset);
+                sendWord(readOffset + lenRead);
             }
-            sendWord(lenRemaining);
+            sendWord(lenRemaining - lenRead);
 
             // Now wait for the go-ahead from the programmer's side
+            curState = ReadSIMMWaitingLengthReply;
             break;
         case CommandReplyError:
         case CommandReplyInvalid:
         default:
-            curState = WaitingForNextCommand;
-            closePort();
-            if (!isReadVerifying)
-            {
-                emit readStatusChanged(ReadError);
-            }
-            else
+            if (!retryReadChunk())
             {
-                // Ensure the verify buffer is empty if we were verifying
-                verifyArray->clear();
-                verifyBuffer->seek(0);
-                emit writeStatusChanged(WriteVerifyError);
+                curState = WaitingForNextCommand;
+                releasePort();
+                emitReadError();
             }
             break;
         }
@@ -1033,32 +1749,31 @@ void Programmer::handleChar(uint8_t c)
         {
         case ProgrammerReadOK:
             curState = ReadSIMMWaitingData;
-            if (!isReadVerifying)
+            if (readPurpose == ReadPurposeDump)
             {
                 emit readTotalLengthChanged(lenRemaining);
-                emit readCompletionLengthChanged(0);
+                emit readCompletionLengthChanged(lenRead);
             }
-            else
+            else if (readPurpose == ReadPurposeVerify)
             {
                 emit writeVerifyTotalLengthChanged(lenRemaining);
-                emit writeVerifyCompletionLengthChanged(0);
+                emit writeVerifyCompletionLengthChanged(lenRead);
+            }
+            else if (readPurpose == ReadPurposePreserve)
+            {
+                emit writeTotalLengthChanged(lenRemaining);
+                emit writeCompletionLengthChanged(lenRead);
             }
+            readChunk.clear();
             readChunkLenRemaining = READ_CHUNK_SIZE;
             break;
         case ProgrammerReadError:
         default:
-            curState = WaitingForNextCommand;
-            closePort();
-            if (!isReadVerifying)
-            {
-                emit readStatusChanged(ReadError);
-            }
-            else
+            if (!retryReadChunk())
             {
-                // Ensure the verify buffer is empty if we were verifying
-                verifyArray->clear();
-                verifyBuffer->seek(0);
-                emit writeStatusChanged(WriteVerifyError);
+                curState = WaitingForNextCommand;
+                releasePort();
+                emitReadError();
             }
             break;
         }
@@ -1066,23 +1781,36 @@ void Programmer::handleChar(uint8_t c)
 
     // Expecting a chunk of data back from the programmer
     case ReadSIMMWaitingData:
-        // Only keep adding to the readback if we need to
-        if (lenRead < trueLenToRead)
-        {
-            readDevice->write((const char *)&c, 1);
-        }
-
-        lenRead++;
+        // Hang onto the chunk until all of it arrives. That way if something
+        // goes wrong partway through, we can ask for the whole chunk again.
+        readChunk.append(static_cast<char>(c));
         if (--readChunkLenRemaining == 0)
         {
-            if (!isReadVerifying)
+            // Only keep adding to the readback if we need to
+            if (lenRead < trueLenToRead)
+            {
+                const int keep = static_cast<int>(qMin<uint32_t>(readChunk.size(), trueLenToRead - lenRead));
+                readDevice->write(readChunk.constData(), keep);
+                if (readPurpose == ReadPurposeDump)
+                {
+                    _readChecksum.addData(readChunk.constData(), keep);
+                }
+            }
+            lenRead += readChunk.size();
+            readChunk.clear();
+
+            if (readPurpose == ReadPurposeDump)
             {
                 emit readCompletionLengthChanged(lenRead);
             }
-            else
+            else if (readPurpose == ReadPurposeVerify)
             {
                 emit writeVerifyCompletionLengthChanged(lenRead);
             }
+            else if (readPurpose == ReadPurposePreserve)
+            {
+                emit writeCompletionLengthChanged(lenRead);
+            }
             qDebug() << "Received a chunk of data";
             sendByte(ComputerReadOK);
             curState = ReadSIMMWaitingStatusReply;
@@ -1096,33 +1824,51 @@ void Programmer::handleChar(uint8_t c)
         {
         case ProgrammerReadFinished:
             curState = WaitingForNextCommand;
-            closePort();
-            if (!isReadVerifying)
+            releasePort();
+            if (readPurpose == ReadPurposeDump)
             {
                 emit readStatusChanged(ReadComplete);
             }
-            else
+            else if (readPurpose == ReadPurposeVerify)
             {
                 doVerifyAfterWriteCompare();
             }
+            else if (readPurpose == ReadPurposePreserve)
+            {
+                // Saved that piece; move onto the next one (or the write itself)
+                readNextPreserveRegion();
+            }
+            else if (readPurpose == ReadPurposeResumeCheck)
+            {
+                finishResumeCheck();
+            }
+            else
+            {
+                resumeWriteAfterCheck();
+            }
             break;
         case ProgrammerReadConfirmCancel:
             curState = WaitingForNextCommand;
-            closePort();
-            if (!isReadVerifying)
+            releasePort();
+            if (readPurpose == ReadPurposeDump)
             {
                 emit readStatusChanged(ReadCancelled);
             }
-            else
+            else if (readPurpose == ReadPurposeVerify)
             {
                 // Ensure the verify buffer is empty if we were verifying
                 verifyArray->clear();
                 verifyBuffer->seek(0);
                 emit writeStatusChanged(WriteVerifyCancelled);
             }
+            else
+            {
+                emit writeStatusChanged(WriteCancelled);
+            }
             break;
         case ProgrammerReadMoreData:
             curState = ReadSIMMWaitingData;
+            readChunk.clear();
             readChunkLenRemaining = READ_CHUNK_SIZE;
             break;
         }
@@ -1167,9 +1913,9 @@ void Programmer::handleChar(uint8_t c)
             // So change to the next state and send out the next command
             // to begin whatever sequence of events we expected.
             qDebug() << "Already in programmer. Good! Do the command now...";
+            sessionBoardState = SessionBoardInProgrammer;
             emit startStatusChanged(ProgrammerInitialized);
-            curState = nextState;
-            sendByte(nextSendByte);
+            sendNextCommand();
             break;
             // TODO: Otherwise, raise an error?
         }
@@ -1211,9 +1957,9 @@ void Programmer::handleChar(uint8_t c)
             // So change to the next state and send out the next command
             // to begin whatever sequence of events we expected.
             qDebug() << "Already in bootloader. Good! Do the command now...";
+            sessionBoardState = SessionBoardInBootloader;
             emit startStatusChanged(ProgrammerInitialized);
-            curState = nextState;
-            sendByte(nextSendByte);
+            sendNextCommand();
             break;
             // TODO: Otherwise, raise an error?
         }
@@ -1244,7 +1990,7 @@ void Programmer::handleChar(uint8_t c)
                     // firmware update.
                     qDebug() << "Programmer board needs firmware update.";
                     curState = WaitingForNextCommand;
-                    closePort();
+                    releasePort();
                     emit identificationStatusChanged(IdentificationNeedsFirmwareUpdate);
                 }
                 else
@@ -1252,14 +1998,8 @@ void Programmer::handleChar(uint8_t c)
                     // Don't inhibit writes if we failed to identify. Just assume an empty/unknown
                     // sector layout and continue on
                     sectorGroups.clear();
-                    if (identifyWriteIsEntireSIMM)
-                    {
-                        startProgrammerCommand(SetSectorLayout, WriteSIMMWaitingSetSectorLayoutReply);
-                    }
-                    else
-                    {
-                        startProgrammerCommand(SetSectorLayout, WritePortionWaitingSetSectorLayoutReply);
-                    }
+                    sectorLayoutWidth = 0;
+                    startWriteAfterIdentification();
                 }
             }
             else
@@ -1290,7 +2030,8 @@ void Programmer::handleChar(uint8_t c)
         else
         {
             // Error -- close the port, we're done!
-            closePort();
+            identificationCacheValid = false;
+            releasePort();
             if (!identifyIsForWriteAttempt)
             {
                 emit identificationStatusChanged(IdentificationError);
@@ -1323,12 +2064,30 @@ void Programmer::handleChar(uint8_t c)
 
     // Expecting final done confirmation after receiving all device/manufacturer info
     case IdentificationAwaitingDoneReply:
-        if (++identificationShiftCounter >= 2)
+    {
+        bool finished = (++identificationShiftCounter >= 2);
+        if (!finished && identificationIsProbe)
+        {
+            // If the chips answered the same way as last time, it's the same
+            // SIMM, so the shifted pass would match too. No need to do it.
+            finished = (c == ProgrammerIdentifyDone) &&
+                    (memcmp(probeManufacturerIDs, chipManufacturerIDs[0], sizeof(probeManufacturerIDs)) == 0) &&
+                    (memcmp(probeDeviceIDs, chipDeviceIDs[0], sizeof(probeDeviceIDs)) == 0);
+            identificationIsProbe = false;
+        }
+
+        if (finished)
         {
+            identificationCacheValid = (c == ProgrammerIdentifyDone);
+            if (c == ProgrammerIdentifyDone)
+            {
+                noteIdentity();
+            }
+
             if (!identifyIsForWriteAttempt)
             {
                 curState = WaitingForNextCommand;
-                closePort();
+                releasePort();
                 if (c == ProgrammerIdentifyDone)
                 {
                     emit identificationStatusChanged(IdentificationComplete);
@@ -1341,49 +2100,11 @@ void Programmer::handleChar(uint8_t c)
             else
             {
                 // This was for a write attempt and we got the ID data. Now parse it
-                // to try to figure out the erase sector layout. If we can't find anything,
-                // fall back to empty erase sector info.
-                sectorGroups.clear();
-
-                // We have to convert the ID info into a format that is usable by ChipID
-                QList<uint8_t> manufacturersStraight;
-                QList<uint8_t> devicesStraight;
-                QList<uint8_t> manufacturersShifted;
-                QList<uint8_t> devicesShifted;
-                for (int i = 0; i < 4; i++)
-                {
-                    manufacturersStraight << chipManufacturerIDs[0][i];
-                    devicesStraight << chipDeviceIDs[0][i];
-                    manufacturersShifted << chipManufacturerIDs[1][i];
-                    devicesShifted << chipDeviceIDs[1][i];
-                }
-
-                // Now ask ChipID to tell us what we have
-                QList<ChipID::ChipInfo> chipInfo;
-                if (_chipID.findChips(manufacturersStraight, devicesStraight,
-                                      manufacturersShifted, devicesShifted,
-                                      chipInfo))
-                {
-                    // Use the sector info of the first valid chip we find in the info returned
-                    foreach (ChipID::ChipInfo const &info, chipInfo)
-                    {
-                        if (info.capacity != 0)
-                        {
-                            sectorGroups = info.sectors;
-                            break;
-                        }
-                    }
-                }
+                // to try to figure out the erase sector layout.
+                updateSectorLayoutFromIdentity();
 
                 // OK, we have the sector info saved. Now, let's do it!
-                if (identifyWriteIsEntireSIMM)
-                {
-                    startProgrammerCommand(SetSectorLayout, WriteSIMMWaitingSetSectorLayoutReply);
-                }
-                else
-                {
-                    startProgrammerCommand(SetSectorLayout, WritePortionWaitingSetSectorLayoutReply);
-                }
+                startWriteAfterIdentification();
             }
         }
         else
@@ -1394,6 +2115,7 @@ void Programmer::handleChar(uint8_t c)
             sendByte(SetSIMMLayout_AddressShifted);
         }
         break;
+    }
 
     // WRITE BOOTLOADER PROGRAM STATE HANDLERS
 
@@ -1408,7 +2130,7 @@ void Programmer::handleChar(uint8_t c)
         else
         {
             curState = WaitingForNextCommand;
-            closePort();
+            releasePort();
             firmwareFile->close();
             delete firmwareFile;
             firmwareFile = NULL;
@@ -1421,7 +2143,7 @@ void Programmer::handleChar(uint8_t c)
         if (c == BootloaderWriteOK)
         {
             curState = WaitingForNextCommand;
-            closePort();
+            releasePort();
             firmwareFile->close();
             delete firmwareFile;
             firmwareFile = NULL;
@@ -1430,7 +2152,7 @@ void Programmer::handleChar(uint8_t c)
         else
         {
             curState = WaitingForNextCommand;
-            closePort();
+            releasePort();
             firmwareFile->close();
             delete firmwareFile;
             firmwareFile = NULL;
@@ -1473,7 +2195,7 @@ void Programmer::handleChar(uint8_t c)
         else
         {
             curState = WaitingForNextCommand;
-            closePort();
+            releasePort();
             firmwareFile->close();
             delete firmwareFile;
             firmwareFile = NULL;
@@ -1500,7 +2222,7 @@ void Programmer::handleChar(uint8_t c)
         else
         {
             curState = WaitingForNextCommand;
-            closePort();
+            releasePort();
             firmwareFile->close();
             delete firmwareFile;
             firmwareFile = NULL;
@@ -1523,14 +2245,14 @@ void Programmer::handleChar(uint8_t c)
         {
             // This is an older firmware not supported
             curState = WaitingForNextCommand;
-            closePort();
+            releasePort();
             emit readFirmwareVersionStatusChanged(ReadFirmwareVersionCommandNotSupported, 0);
         }
         else
         {
             // Error occurred
             curState = WaitingForNextCommand;
-            closePort();
+            releasePort();
             emit readFirmwareVersionStatusChanged(ReadFirmwareVersionError, 0);
         }
         break;
@@ -1548,10 +2270,12 @@ void Programmer::handleChar(uint8_t c)
 
     // Waiting for the final OK reply
     case ReadFWVersionAwaitingDoneReply:
-        closePort();
+        releasePort();
         curState = WaitingForNextCommand;
         if (c == ProgrammerGetFWVersionDone)
         {
+            sessionFirmwareVersion = firmwareVersionBeingAssembled;
+            sessionFirmwareVersionKnown = true;
             emit readFirmwareVersionStatusChanged(ReadFirmwareVersionSucceeded, firmwareVersionBeingAssembled);
         }
         else
@@ -1632,12 +2356,30 @@ QString Programmer::electricalTestPinName(uint8_t index)
 
 void Programmer::identifySIMMChips()
 {
-    // Start with straight addresses
+    // Start with straight addresses. This always does a full identification.
     identifyIsForWriteAttempt = false;
     identificationShiftCounter = 0;
+    identificationIsProbe = false;
     startProgrammerCommand(SetSIMMLayout_AddressStraight, IdentificationWaitingSetSizeReply);
 }
 
+void Programmer::noteIdentity()
+{
+    // Anything that remembers what it put on the SIMM needs to know if it's
+    // now looking at a different one
+    const bool changed = previousIdentityKnown &&
+            (memcmp(previousManufacturerIDs, chipManufacturerIDs, sizeof(previousManufacturerIDs)) != 0 ||
+             memcmp(previousDeviceIDs, chipDeviceIDs, sizeof(previousDeviceIDs)) != 0);
+    memcpy(previousManufacturerIDs, chipManufacturerIDs, sizeof(previousManufacturerIDs));
+    memcpy(previousDeviceIDs, chipDeviceIDs, sizeof(previousDeviceIDs));
+    previousIdentityKnown = true;
+
+    if (changed)
+    {
+        emit identifiedChipsChanged();
+    }
+}
+
 void Programmer::getChipIdentity(int chipIndex, uint8_t *manufacturer, uint8_t *device, bool shiftedUnlock)
 {
     if ((chipIndex >= 0) && (chipIndex < 4))
@@ -1654,11 +2396,21 @@ void Programmer::getChipIdentity(int chipIndex, uint8_t *manufacturer, uint8_t *
 
 void Programmer::requestFirmwareVersion()
 {
+    // The version can't change without the board going through the
+    // bootloader, which ends the session, so there's no need to ask again
+    if (_sessionMode && sessionFirmwareVersionKnown)
+    {
+        emit readFirmwareVersionStatusChanged(ReadFirmwareVersionSucceeded, sessionFirmwareVersion);
+        return;
+    }
+
     startProgrammerCommand(GetFirmwareVersion, ReadFWVersionAwaitingOKReply);
 }
 
 void Programmer::flashFirmware(QByteArray firmware)
 {
+    sessionFirmwareVersionKnown = false;
+    setupCapabilities = 0;
     firmwareFile = new QBuffer();
     firmwareFile->setData(firmware);
     if (!firmwareFile->open(QFile::ReadOnly))
@@ -1681,14 +2433,22 @@ void Programmer::flashFirmware(QByteArray firmware)
 // TODO: When it fails, this needs to carry errors over somehow.
 // newState is really just a ProgrammerCommandState but in order to keep
 // ProgrammerCommandState private, I did it this way.
-void Programmer::startProgrammerCommand(uint8_t commandByte, uint32_t newState)
+void Programmer::startProgrammerCommand(uint8_t commandByte, uint32_t newState, QByteArray const &payload)
 {
     nextState = (ProgrammerCommandState)newState;
     nextSendByte = commandByte;
+    nextSendPayload = payload;
 
-    curState = BootloaderStateAwaitingOKReply;
-    openPort();
-    sendByte(GetBootloaderState);
+    // If the port was left open and we already know the board is running
+    // the programmer firmware, there's no need to ask again. Go right ahead.
+    if (_sessionMode && serialPort->isOpen() &&
+        (sessionBoardState == SessionBoardInProgrammer))
+    {
+        sendNextCommand();
+        return;
+    }
+
+    startHandshake(BootloaderStateAwaitingOKReply);
 }
 
 // Begins a command by opening the serial port, making sure we're in the BOOTLOADER
@@ -1700,10 +2460,63 @@ void Programmer::startBootloaderCommand(uint8_t commandByte, uint32_t newState)
 {
     nextState = (ProgrammerCommandState)newState;
     nextSendByte = commandByte;
+    nextSendPayload.clear();
+
+    if (_sessionMode && serialPort->isOpen() &&
+        (sessionBoardState == SessionBoardInBootloader))
+    {
+        sendNextCommand();
+        return;
+    }
+
+    startHandshake(BootloaderStateAwaitingOKReplyToBootloader);
+}
 
-    curState = BootloaderStateAwaitingOKReplyToBootloader;
+// Opens the port and asks the board whether it's in the bootloader or the
+// programmer. If we lost track of the board, it might still be sending
+// whatever it was in the middle of, and that would get taken as the answer.
+// So in that case, wait for the line to go quiet first.
+void Programmer::startHandshake(uint32_t handshakeState)
+{
     openPort();
+    if (drainBeforeHandshake)
+    {
+        handshakeAfterDrain = (ProgrammerCommandState)handshakeState;
+        curState = ResyncDrainingInput;
+        drainTimer->start(RESYNC_QUIET_MS);
+        watchdogTimer->stop();
+        restartWatchdog();
+        return;
+    }
+
+    curState = (ProgrammerCommandState)handshakeState;
     sendByte(GetBootloaderState);
+    restartWatchdog();
+}
+
+void Programmer::drainFinished()
+{
+    if (curState != ResyncDrainingInput)
+    {
+        return;
+    }
+
+    drainBeforeHandshake = false;
+    startHandshake(handshakeAfterDrain);
+}
+
+// Sends the command that was waiting for the board to be in the right mode,
+// along with anything that was queued up to go out right behind it
+void Programmer::sendNextCommand()
+{
+    curState = nextState;
+    sendByte(nextSendByte);
+    if (!nextSendPayload.isEmpty())
+    {
+        serialPort->write(nextSendPayload);
+        nextSendPayload.clear();
+    }
+    restartWatchdog();
 }
 
 void Programmer::portDiscovered(const QextPortInfo &info)
@@ -1742,6 +2555,8 @@ void Programmer::portDiscovered_internal()
     sender()->deleteLater();
 
     closePort();
+    setupCapabilities = 0;
+    identificationCacheValid = false;
     serialPort->setPortName(programmerBoardPortName);
 
     // Don't show the "control" screen if we intentionally
@@ -1750,14 +2565,12 @@ void Programmer::portDiscovered_internal()
     if (curState == BootloaderStateAwaitingPlug)
     {
         openPort();
-        curState = nextState;
-        sendByte(nextSendByte);
+        sendNextCommand();
     }
     else if (curState == BootloaderStateAwaitingPlugToBootloader)
     {
         openPort();
-        curState = nextState;
-        sendByte(nextSendByte);
+        sendNextCommand();
     }
     else
     {
@@ -1775,6 +2588,8 @@ void Programmer::portRemoved(const QextPortInfo &info)
         programmerBoardPortName = "";
         foundState = ProgrammerBoardNotFound;
         detectedDeviceRevision = 0;
+        setupCapabilities = 0;
+        identificationCacheValid = false;
 
         // Don't show the "no programmer connected" screen if we intentionally
         // disconnected the USB port because we are changing from bootloader
@@ -1782,10 +2597,12 @@ void Programmer::portRemoved(const QextPortInfo &info)
         if (curState == BootloaderStateAwaitingUnplug)
         {
             curState = BootloaderStateAwaitingPlug;
+            restartWatchdog();
         }
         else if (curState == BootloaderStateAwaitingUnplugToBootloader)
         {
             curState = BootloaderStateAwaitingPlugToBootloader;
+            restartWatchdog();
         }
         else
         {
@@ -1796,6 +2613,7 @@ void Programmer::portRemoved(const QextPortInfo &info)
                 // This means they unplugged while we were in the middle
                 // of an operation. Reset state, and let them know.
                 curState = WaitingForNextCommand;
+                watchdogTimer->stop();
                 emit programmerBoardDisconnectedDuringOperation();
             }
             else
@@ -1816,16 +2634,91 @@ void Programmer::startCheckingPorts()
 
 void Programmer::openPort()
 {
-    serialPort->open(QextSerialPort::ReadWrite);
+    if (!serialPort->isOpen())
+    {
+        serialPort->open();
+    }
 }
 
 void Programmer::closePort()
 {
     serialPort->close();
+
+    // Whatever we knew about the board is stale once the port is closed.
+    // It might be reset or replugged before we open it again.
+    sessionBoardState = SessionBoardUnknown;
+    sessionFirmwareVersionKnown = false;
+}
+
+// Called when an operation is done with the port. In session mode the port
+// stays open so the next operation can start without reopening it and
+// checking the bootloader state all over again.
+void Programmer::releasePort()
+{
+    if (!_sessionMode)
+    {
+        closePort();
+    }
+}
+
+void Programmer::setSessionMode(bool enabled)
+{
+    _sessionMode = enabled;
+    if (!enabled && (curState == WaitingForNextCommand))
+    {
+        closePort();
+    }
+}
+
+bool Programmer::sessionMode() const
+{
+    return _sessionMode;
+}
+
+void Programmer::setIdentificationProbe(bool enabled)
+{
+    _identificationProbe = enabled;
+}
+
+bool Programmer::identificationProbe() const
+{
+    return _identificationProbe;
+}
+
+void Programmer::invalidateIdentification()
+{
+    identificationCacheValid = false;
+}
+
+// Forgets everything we knew about the board, so the next operation starts
+// over by opening the port, waiting for anything still on its way from the
+// board to stop, and checking the bootloader state. In session mode that's
+// also how we find out about a board that reset without being replugged:
+// commands stop getting answers, the watchdog ends up here, and the next
+// operation goes through the whole handshake again.
+void Programmer::resyncSession()
+{
+    setupCapabilities = 0;
+    drainBeforeHandshake = true;
+    if (curState == WaitingForNextCommand)
+    {
+        closePort();
+    }
+    else
+    {
+        sessionBoardState = SessionBoardUnknown;
+        sessionFirmwareVersionKnown = false;
+    }
 }
 
 void Programmer::setSIMMType(uint32_t bytes, uint32_t chip_type)
 {
+    // A different kind of SIMM means whatever we identified before is gone
+    if ((bytes != _simmCapacity) || (chip_type != _simmChip))
+    {
+        identificationCacheValid = false;
+    }
+
     _simmCapacity = bytes;
     _simmChip = chip_type;
 }
@@ -1860,12 +2753,270 @@ bool Programmer::selectedSIMMTypeUsesShiftedUnlock() const
     return SIMMChip() == SIMM_TSOP_x8;
 }
 
+void Programmer::resetTelemetry()
+{
+    chunkRetriesRemaining = MAX_CHUNK_RETRIES;
+    _telemetry.readRetries = 0;
+    _telemetry.writeRetries = 0;
+    _telemetry.retryOffsets.clear();
+}
+
+// Picks a read back up at the first chunk we didn't completely receive.
+// Returns false if we're out of retries.
+bool Programmer::retryReadChunk()
+{
+    if (chunkRetriesRemaining == 0)
+    {
+        return false;
+    }
+    chunkRetriesRemaining--;
+
+    qDebug() << "Retrying read at" << readOffset + lenRead;
+    _telemetry.readRetries++;
+    _telemetry.retryOffsets.append(readOffset + lenRead);
+
+    // Start over with a clean connection, and throw away any partial chunk
+    curState = WaitingForNextCommand;
+    closePort();
+    readChunk.clear();
+    readDevice->seek(readDeviceStart + qMin(lenRead, trueLenToRead));
+    startReadCommand();
+    return true;
+}
+
+// After a write error, reads back the chunk that was in flight to find out
+// whether it made it into the chips before picking the write back up.
+// Returns false if we're out of retries.
+bool Programmer::retryWriteChunk()
+{
+    if (chunkRetriesRemaining == 0)
+    {
+        return false;
+    }
+    chunkRetriesRemaining--;
+
+    qDebug() << "Retrying write at" << writeOffset + writeLenAcknowledged;
+    _telemetry.writeRetries++;
+    _telemetry.retryOffsets.append(writeOffset + writeLenAcknowledged);
+
+    // Forget about anything that wasn't acknowledged
+    writeLenRemaining += lenWritten - writeLenAcknowledged;
+    lenWritten = writeLenAcknowledged;
+
+    if (writeLenRemaining == 0)
+    {
+        // Nothing was in flight, so there's nothing to check
+        resumeWriteAfterCheck();
+        return true;
+    }
+
+    curState = WaitingForNextCommand;
+    closePort();
+    readPurpose = ReadPurposeRetryCheck;
+    retryCheckArray->clear();
+    retryCheckBuffer->seek(0);
+    internalReadSIMM(retryCheckBuffer, qMin<uint32_t>(writeLenRemaining, WRITE_CHUNK_SIZE),
+                     writeOffset + lenWritten);
+    return true;
+}
+
+void Programmer::resumeWriteAfterCheck()
+{
+    const uint32_t chunkStart = writeOffset + lenWritten;
+    const uint32_t checkLength = qMin<uint32_t>(writeLenRemaining, WRITE_CHUNK_SIZE);
+
+    if (checkLength > 0 && (uint32_t)retryCheckArray->size() >= checkLength)
+    {
+        // Compare what landed with what we meant to write there
+        writeDevice->seek(chunkStart - writeDeviceOffset);
+        QByteArray intended = writeDevice->read(checkLength);
+        while ((uint32_t)intended.size() < checkLength)
+        {
+            intended.append(static_cast<char>(0xFF));
+        }
+
+        bool landed = true;
+        for (uint32_t i = 0; i < checkLength; i++)
+        {
+            // Skip chips we aren't writing to (see doVerifyAfterWriteCompare
+            // for how byte lanes match up to the chip mask)
+            if ((writeChipMask & (1 << ((chunkStart + i) % 4))) == 0)
+            {
+                continue;
+            }
+
+            const uint8_t actual = static_cast<uint8_t>(retryCheckArray->at(i));
+            const uint8_t wanted = static_cast<uint8_t>(intended.at(i));
+            if (~actual & wanted)
+            {
+                // A bit that should be 1 was already programmed to 0. Writing
+                // the chunk again can't fix that without an erase.
+                qDebug() << "Interrupted write left unrecoverable data at" << chunkStart + i;
+                curState = WaitingForNextCommand;
+                releasePort();
+                emit writeStatusChanged(WriteError);
+                return;
+            }
+            if (actual != wanted)
+            {
+                landed = false;
+            }
+        }
+
+        // If the whole chunk is already there, there's no need to send it again.
+        // Otherwise, programming the same data over it again is harmless.
+        if (landed)
+        {
+            lenWritten += checkLength;
+            writeLenRemaining -= checkLength;
+            writeLenAcknowledged = lenWritten;
+        }
+    }
+
+    // Now pick the write back up where it left off
+    writeDevice->seek(writeOffset + lenWritten - writeDeviceOffset);
+    startProgrammerCommand(WriteChipsAt, WritePortionWaitingWriteAtReply);
+}
+
+// Asks the board for room for the next chunk, but only once the chunk can be
+// read without waiting. A ROM that's still being built in the background may
+// not have gotten that far yet; it says so with readyRead() when it has.
+void Programmer::requestNextWriteChunk()
+{
+    const qint64 needed = qMin<qint64>(WRITE_CHUNK_SIZE, writeLenRemaining);
+    if (writeDevice->bytesAvailable() < needed)
+    {
+        connect(writeDevice, SIGNAL(readyRead()), SLOT(writeDataReady()), Qt::UniqueConnection);
+        curState = WriteSIMMWaitingForData;
+        restartWatchdog();
+        qDebug() << "Waiting for the next chunk to be ready...";
+        return;
+    }
+
+    disconnect(writeDevice, SIGNAL(readyRead()), this, SLOT(writeDataReady()));
+    sendByte(ComputerWriteMore);
+    curState = WriteSIMMWaitingWriteMoreReply;
+    qDebug() << "Write more..." << writeLenRemaining << "remaining.";
+}
+
+void Programmer::writeDataReady()
+{
+    if (curState == WriteSIMMWaitingForData)
+    {
+        requestNextWriteChunk();
+        restartWatchdog();
+    }
+}
+
+void Programmer::startErase()
+{
+    // Resuming a write means the SIMM was already erased; we just need to
+    // make sure what's on it so far is what we think it is
+    if (writeResumeOffset > 0)
+    {
+        const uint32_t checkLength = qMin<uint32_t>(writeResumeOffset, RESUME_CHECK_SIZE);
+        emit writeStatusChanged(WriteResumeChecking);
+        readPurpose = ReadPurposeResumeCheck;
+        retryCheckArray->clear();
+        retryCheckBuffer->seek(0);
+        internalReadSIMM(retryCheckBuffer, checkLength, writeResumeOffset - checkLength);
+        return;
+    }
+
+    // Special case: Send out notification we are starting an erase command.
+    // I don't have any hooks into the process between now and the erase reply.
+    emit writeStatusChanged(WriteErasing);
+    if (identifyWriteIsEntireSIMM)
+    {
+        sendByte(EraseChips);
+        curState = WriteSIMMWaitingEraseReply;
+    }
+    else
+    {
+        sendByte(ErasePortion);
+        curState = WritePortionWaitingEraseReply;
+    }
+}
+
+// A write device that's still being produced (like a combined ROM whose disk
+// image is still compressing) can start out claiming more than it'll end up
+// with, and settle on its real size partway through the write. This only
+// ever shortens the write.
+void Programmer::refreshWriteLength()
+{
+    const qint64 deviceRemaining = writeDevice->size() - writeDevice->pos();
+    if (deviceRemaining < static_cast<qint64>(writeLenRemaining))
+    {
+        writeLenRemaining = deviceRemaining > 0 ? static_cast<uint32_t>(deviceRemaining) : 0;
+        emit writeTotalLengthChanged(lenWritten + writeLenRemaining);
+    }
+}
+
+void Programmer::finishResumeCheck()
+{
+    const uint32_t checkLength = qMin<uint32_t>(writeResumeOffset, RESUME_CHECK_SIZE);
+    const uint32_t checkStart = writeResumeOffset - checkLength;
+
+    writeDevice->seek(checkStart - writeDeviceOffset);
+    QByteArray intended = writeDevice->read(checkLength);
+    bool matches = ((uint32_t)intended.size() == checkLength) &&
+                   ((uint32_t)retryCheckArray->size() >= checkLength);
+    for (uint32_t i = 0; matches && i < checkLength; i++)
+    {
+        // Chips we aren't writing to can have anything in them
+        if ((writeChipMask & (1 << ((checkStart + i) % 4))) &&
+            retryCheckArray->at(i) != intended.at(i))
+        {
+            qDebug() << "Data already on the SIMM doesn't match at" << checkStart + i;
+            matches = false;
+        }
+    }
+
+    if (!matches)
+    {
+        curState = WaitingForNextCommand;
+        writeResumeOffset = 0;
+        releasePort();
+        emit writeStatusChanged(WriteResumeMismatch);
+        return;
+    }
+
+    // Carry on as if the write had just gotten here by itself
+    lenWritten = writeResumeOffset - writeOffset;
+    writeLenAcknowledged = lenWritten;
+    writeLenRemaining = writeDevice->size() - writeResumeOffset;
+    writeResumeOffset = 0;
+    writeDevice->seek(writeOffset + lenWritten - writeDeviceOffset);
+    startProgrammerCommand(WriteChipsAt, WritePortionWaitingWriteAtReply);
+}
+
+void Programmer::emitReadError()
+{
+    if (readPurpose == ReadPurposeDump)
+    {
+        emit readStatusChanged(ReadError);
+    }
+    else if (readPurpose == ReadPurposeVerify)
+    {
+        // Ensure the verify buffer is empty if we were verifying
+        verifyArray->clear();
+        verifyBuffer->seek(0);
+        emit writeStatusChanged(WriteVerifyError);
+    }
+    else
+    {
+        // Reads done as part of a write
+        emit writeStatusChanged(WriteError);
+    }
+}
+
 void Programmer::doVerifyAfterWriteCompare()
 {
     // Do the comparison, emit the correct signal
 
-    // Read the entire file we just wrote into a QByteArray
-    writeDevice->seek(readOffset);
+    // Read the entire file we just wrote into a QByteArray. The device
+    // might only hold the part of the SIMM starting at writeDeviceOffset.
+    writeDevice->seek(readOffset - writeDeviceOffset);
     QByteArray originalFileContents = writeDevice->read(verifyLength);
     qDebug() << "Read" << originalFileContents.length() << "bytes, asked for" << verifyLength;
 
@@ -1896,7 +3047,7 @@ void Programmer::doVerifyAfterWriteCompare()
                     // MSB, so IC4 is the first chip, IC3 second, and
                     // so on. That's why I subtract it from 3 --
                     // 0 through 3 get mapped to 3 through 0.
-                    _verifyBadChipMask |= (1 << (3 - (x % 4)));
+                    _verifyBadChipMask |= (1 << (3 - ((readOffset + x) % 4)));
                 }
             }
 
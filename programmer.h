@@ -23,11 +23,15 @@
 #include <QObject>
 #include <QFile>
 #include <QIODevice>
-#include <qextserialport.h>
 #include <qextserialenumerator.h>
+#include "programmertransport.h"
 #include "chipid.h"
+#include "sectorindex.h"
+#include "romchecksum.h"
 #include <stdint.h>
 #include <QBuffer>
+#include <QElapsedTimer>
+#include <QTimer>
 
 typedef enum StartStatus
 {
@@ -65,7 +69,10 @@ typedef enum WriteStatus
     WriteCompleteVerifyOK,
     WriteEraseBlockWrongSize,
     WriteNeedsFirmwareUpdateErasePortion,
-    WriteNeedsFirmwareUpdateIndividualChips
+    WriteNeedsFirmwareUpdateIndividualChips,
+    WritePreservingData,
+    WriteResumeChecking,
+    WriteResumeMismatch
 } WriteStatus;
 
 typedef enum ElectricalTestStatus
@@ -133,15 +140,25 @@ typedef enum ReadFirmwareVersionStatus
 #define SIMM_TSOP_x8    0x01
 #define SIMM_TSOP_x16   0x02
 
+// Things that went wrong (and were recovered from) during the most
+// recent read or write
+struct OperationTelemetry
+{
+    int readRetries;
+    int writeRetries;
+    QList<uint32_t> retryOffsets;
+};
+
 class Programmer : public QObject
 {
     Q_OBJECT
 public:
     explicit Programmer(QObject *parent = 0);
     virtual ~Programmer();
-    void readSIMM(QIODevice *device, uint32_t len = 0);
+    void readSIMM(QIODevice *device, uint32_t len = 0, uint32_t offset = 0);
     void writeToSIMM(QIODevice *device, uint8_t chipsMask = 0x0F);
     void writeToSIMM(QIODevice *device, uint32_t startOffset, uint32_t length, uint8_t chipsMask = 0x0F);
+    void resumeWriteToSIMM(QIODevice *device, uint32_t resumeOffset, uint8_t chipsMask = 0x0F);
     void runElectricalTest();
     QString electricalTestPinName(uint8_t index);
     void identifySIMMChips();
@@ -158,6 +175,20 @@ public:
     ProgrammerRevision programmerRevision() const;
     bool selectedSIMMTypeUsesShiftedUnlock() const;
     ChipID &chipID() { return _chipID; }
+    ROMChecksum const &readChecksum() const { return _readChecksum; }
+    void setSessionMode(bool enabled);
+    bool sessionMode() const;
+    void resyncSession();
+    void setIdentificationProbe(bool enabled);
+    bool identificationProbe() const;
+    void invalidateIdentification();
+    bool identificationCached() const { return identificationCacheValid; }
+    OperationTelemetry const &operationTelemetry() const { return _telemetry; }
+    // Erase sectors of the chips that were last identified. Not valid if
+    // they haven't been identified or their layout isn't known, in which
+    // case portion writes go by fallbackEraseSize() instead.
+    SectorIndex sectorIndex() const;
+    static uint32_t fallbackEraseSize();
 signals:
     void startStatusChanged(StartStatus status);
 
@@ -170,11 +201,15 @@ signals:
     void writeCompletionLengthChanged(uint32_t len);
     void writeVerifyTotalLengthChanged(uint32_t total);
     void writeVerifyCompletionLengthChanged(uint32_t total);
+    void writeCheckpoint(uint32_t offset);
 
     void electricalTestStatusChanged(ElectricalTestStatus status);
     void electricalTestFailLocation(uint8_t loc1, uint8_t loc2);
 
     void identificationStatusChanged(IdentificationStatus status);
+    // An identification found different chips than the one before it, so
+    // the SIMM has been swapped since then
+    void identifiedChipsChanged();
 
     void firmwareFlashStatusChanged(FirmwareFlashStatus status);
     void firmwareFlashTotalLengthChanged(uint32_t total);
@@ -188,13 +223,41 @@ signals:
 public slots:
 
 private:
+    // What a read from the SIMM is being done for
+    enum ReadPurpose
+    {
+        ReadPurposeDump,
+        ReadPurposeVerify,
+        ReadPurposePreserve,
+        ReadPurposeRetryCheck,
+        ReadPurposeResumeCheck
+    };
+
+    // What we last saw the board running, while the port stays open
+    enum SessionBoardState
+    {
+        SessionBoardUnknown,
+        SessionBoardInProgrammer,
+        SessionBoardInBootloader
+    };
+
+    // Write setup commands this board's firmware is known to accept
+    enum SetupCapability
+    {
+        SetupCapabilitySectorLayout = (1 << 0),
+        SetupCapabilitySIMMLayout = (1 << 1),
+        SetupCapabilityVerifyMode = (1 << 2),
+        SetupCapabilityChipMask = (1 << 3),
+        SetupCapabilityAll = 0x0F
+    };
+
     //QFile *readFile;
     //QFile *writeFile;
     QIODevice *readDevice;
     QIODevice *writeDevice;
     QBuffer *firmwareFile;
 
-    QextSerialPort *serialPort;
+    ProgrammerTransport *serialPort;
     void sendByte(uint8_t b);
     void sendWord(uint32_t w);
     uint8_t readByte();
@@ -212,6 +275,8 @@ private:
     uint32_t trueLenToRead;
     uint32_t lenRemaining;
     uint32_t readOffset;
+    qint64 readDeviceStart;
+    QByteArray readChunk;
 
     int identificationShiftCounter;
     int identificationReadCounter;
@@ -219,6 +284,14 @@ private:
     uint8_t chipDeviceIDs[2][4];
     bool identifyIsForWriteAttempt;
     bool identifyWriteIsEntireSIMM;
+    bool identificationCacheValid;
+    bool identificationIsProbe;
+    bool _identificationProbe;
+    uint8_t probeManufacturerIDs[4];
+    uint8_t probeDeviceIDs[4];
+    bool previousIdentityKnown;
+    uint8_t previousManufacturerIDs[2][4];
+    uint8_t previousDeviceIDs[2][4];
     QList<QPair<uint16_t, uint32_t> > sectorGroups;
 
     uint16_t detectedDeviceRevision;
@@ -227,30 +300,97 @@ private:
 
     VerificationOption _verifyMode;
     uint8_t _verifyBadChipMask;
-    bool isReadVerifying;
+    ReadPurpose readPurpose;
     QBuffer *verifyBuffer;
     QByteArray *verifyArray;
     uint32_t verifyLength;
 
     uint32_t writeOffset;
     uint32_t writeLength;
+    uint32_t writeDeviceOffset;
+    uint32_t writeLenAcknowledged;
+    uint32_t writeResumeOffset;
     uint8_t writeChipMask;
 
+    // Read-modify-write of the parts of erase sectors outside a portion write
+    uint8_t sectorLayoutWidth;
+    QByteArray *portionArray;
+    QBuffer *portionBuffer;
+    uint32_t portionEraseStart;
+    // Set once the firmware has turned out to only erase in
+    // BLOCK_ERASE_SIZE pieces, with what was planned before that
+    bool portionBlockAligned;
+    QByteArray *replanArray;
+    QBuffer *replanBuffer;
+    QList<QPair<uint32_t, uint32_t> > preserveRegions;
+
+    // Recovering from transfer errors partway through a read or write
+    int chunkRetriesRemaining;
+    QByteArray *retryCheckArray;
+    QBuffer *retryCheckBuffer;
+    OperationTelemetry _telemetry;
+
     uint32_t firmwareVersionBeingAssembled;
     uint8_t firmwareVersionNextExpectedByte;
 
     ChipID _chipID;
+    ROMChecksum _readChecksum;
+
+    bool _sessionMode;
+    SessionBoardState sessionBoardState;
+    bool sessionFirmwareVersionKnown;
+    uint32_t sessionFirmwareVersion;
+    uint8_t setupCapabilities;
+    int pipelinedRepliesRemaining;
+
+    // Watches for the programmer going quiet in the middle of an operation
+    QTimer *watchdogTimer;
+    QTimer *drainTimer;
+    bool drainBeforeHandshake;
+    QElapsedTimer replyTimer;
+    bool awaitingReply;
+    double smoothedReplyTime;
+    double replyTimeVariance;
 
     void openPort();
     void closePort();
+    void releasePort();
 
     void internalReadSIMM(QIODevice *device, uint32_t len, uint32_t offset = 0);
-    void startProgrammerCommand(uint8_t commandByte, uint32_t newState);
+    void startReadCommand();
+    void startProgrammerCommand(uint8_t commandByte, uint32_t newState, QByteArray const &payload = QByteArray());
+    void sendNextCommand();
     void startBootloaderCommand(uint8_t commandByte, uint32_t newState);
+    void startHandshake(uint32_t handshakeState);
     void doVerifyAfterWriteCompare();
+    void resetTelemetry();
+    bool retryReadChunk();
+    bool retryWriteChunk();
+    void requestNextWriteChunk();
+    void resumeWriteAfterCheck();
+    void startErase();
+    void finishResumeCheck();
+    void refreshWriteLength();
+    void emitReadError();
+    void startWriteIdentification();
+    void updateSectorLayoutFromIdentity();
+    void noteIdentity();
+    void startWriteAfterIdentification();
+    void planPortionWrite();
+    void replanPortionWriteForBlockErase();
+    void readNextPreserveRegion();
+    void startWriteSetup();
+    void sampleReplyTime(qint64 ms);
+    int watchdogTimeoutForState(bool &adaptive) const;
+    int expectedEraseTimeout() const;
+    void restartWatchdog();
+    void emitTimedOut(uint32_t state);
 
 private slots:
     void dataReady();
+    void watchdogTimeout();
+    void drainFinished();
+    void writeDataReady();
 
     void portDiscovered(const QextPortInfo &info);
     void portDiscovered_internal();
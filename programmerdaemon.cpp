@@ -0,0 +1,282 @@
+#include "programmerdaemon.h"
+#include "simmtable.h"
+#include <QDebug>
+#include <QLocalServer>
+#include <QLocalSocket>
+
+// Nobody has any business sending us more than a full 8 MB SIMM's worth
+#define MAX_MESSAGE_SIZE    (16 * 1024 * 1024)
+
+// SubmitJob: type, job type, capacity, chip type, chip mask, verify mode, length
+#define SUBMIT_JOB_HEADER_SIZE  (1 + 1 + 4 + 1 + 1 + 1 + 4)
+
+static void appendWord(QByteArray &buffer, uint32_t w)
+{
+    buffer.append(static_cast<char>((w >> 0)  & 0xFF));
+    buffer.append(static_cast<char>((w >> 8)  & 0xFF));
+    buffer.append(static_cast<char>((w >> 16) & 0xFF));
+    buffer.append(static_cast<char>((w >> 24) & 0xFF));
+}
+
+// The biggest SIMM there is, for checking jobs that don't pick one
+static uint32_t largestSIMMCapacity()
+{
+    uint32_t largest = 0;
+    for (size_t i = 0; i < simmTableCount; i++)
+    {
+        largest = qMax(largest, simmTable[i].size * 1024);
+    }
+    return largest;
+}
+
+static uint32_t wordAt(QByteArray const &buffer, int offset)
+{
+    return static_cast<uint32_t>(static_cast<uint8_t>(buffer.at(offset + 0))) << 0 |
+           static_cast<uint32_t>(static_cast<uint8_t>(buffer.at(offset + 1))) << 8 |
+           static_cast<uint32_t>(static_cast<uint8_t>(buffer.at(offset + 2))) << 16 |
+           static_cast<uint32_t>(static_cast<uint8_t>(buffer.at(offset + 3))) << 24;
+}
+
+ProgrammerDaemon::ProgrammerDaemon(Programmer *programmer, QObject *parent) :
+    QObject(parent),
+    server(new QLocalServer(this)),
+    runner(new JobRunner(programmer, this))
+{
+    connect(server, SIGNAL(newConnection()), SLOT(newConnection()));
+    connect(runner, SIGNAL(jobStarted(int)), SLOT(jobStarted(int)));
+    connect(runner, SIGNAL(jobProgress(int,uint32_t,uint32_t)), SLOT(jobProgress(int,uint32_t,uint32_t)));
+    connect(runner, SIGNAL(jobFinished(int,bool,QString,QByteArray)), SLOT(jobFinished(int,bool,QString,QByteArray)));
+
+    // Jobs run back to back, so don't bother closing the port in between
+    programmer->setSessionMode(true);
+}
+
+QString ProgrammerDaemon::defaultSocketName()
+{
+    return "SIMMProgrammer";
+}
+
+bool ProgrammerDaemon::listen(QString const &name)
+{
+    if (!server->listen(name))
+    {
+        // A previous daemon that crashed may have left its socket behind
+        QLocalServer::removeServer(name);
+        if (!server->listen(name))
+        {
+            qWarning() << "Unable to listen on" << name << server->errorString();
+            return false;
+        }
+    }
+    return true;
+}
+
+void ProgrammerDaemon::newConnection()
+{
+    while (server->hasPendingConnections())
+    {
+        QLocalSocket *client = server->nextPendingConnection();
+        receiveBuffers.insert(client, QByteArray());
+        connect(client, SIGNAL(readyRead()), SLOT(clientReadyRead()));
+        connect(client, SIGNAL(disconnected()), SLOT(clientDisconnected()));
+    }
+}
+
+void ProgrammerDaemon::clientReadyRead()
+{
+    QLocalSocket *client = qobject_cast<QLocalSocket *>(sender());
+    if (!client || !receiveBuffers.contains(client))
+    {
+        return;
+    }
+
+    QByteArray &buffer = receiveBuffers[client];
+    buffer.append(client->readAll());
+
+    // Handle every complete message we've got so far
+    while (buffer.size() >= 4)
+    {
+        const uint32_t len = wordAt(buffer, 0);
+        if (len == 0 || len > MAX_MESSAGE_SIZE)
+        {
+            QByteArray error;
+            error.append(static_cast<char>(ProtocolError));
+            error.append("Bad message length");
+            sendMessage(client, error);
+            client->disconnectFromServer();
+            return;
+        }
+        if ((uint32_t)buffer.size() < 4 + len)
+        {
+            break;
+        }
+
+        const QByteArray message = buffer.mid(4, len);
+        buffer.remove(0, 4 + len);
+        handleMessage(client, message);
+    }
+}
+
+void ProgrammerDaemon::handleMessage(QLocalSocket *client, QByteArray const &message)
+{
+    QByteArray reply;
+    const uint8_t type = static_cast<uint8_t>(message.at(0));
+    if (type == SubmitJob && message.size() >= SUBMIT_JOB_HEADER_SIZE)
+    {
+        ProgrammerJob job;
+        const uint8_t jobType = static_cast<uint8_t>(message.at(1));
+        const uint8_t verifyMode = static_cast<uint8_t>(message.at(8));
+        job.simmCapacity = wordAt(message, 2);
+        job.simmChip = static_cast<uint8_t>(message.at(6));
+        job.chipMask = static_cast<uint8_t>(message.at(7));
+        job.length = wordAt(message, 9);
+        job.data = message.mid(SUBMIT_JOB_HEADER_SIZE);
+
+        // Nothing from a client goes to the programmer without being
+        // checked. Job types past ChecksumVerify (WritePortion) need fields
+        // this message doesn't have, so they're refused too.
+        const uint32_t capacity = job.simmCapacity ? job.simmCapacity : largestSIMMCapacity();
+        QString error;
+        if (jobType > ProgrammerJob::ChecksumVerify)
+        {
+            error = "Unsupported job type";
+        }
+        else if (verifyMode > VerifyAfterWrite)
+        {
+            error = "Unsupported verify mode";
+        }
+        else if (job.simmCapacity && !isKnownSIMMType(job.simmCapacity, job.simmChip))
+        {
+            error = "Unknown SIMM capacity and chip type";
+        }
+        else if (jobType == ProgrammerJob::Write && (job.chipMask == 0 || job.chipMask > 0x0F))
+        {
+            error = "Chip mask has to pick some of the four chips";
+        }
+        else if (job.length > capacity || static_cast<uint32_t>(job.data.size()) > capacity)
+        {
+            error = "Bigger than the SIMM";
+        }
+
+        if (error.isEmpty())
+        {
+            job.type = static_cast<ProgrammerJob::Type>(jobType);
+            job.verifyMode = static_cast<VerificationOption>(verifyMode);
+
+            const int id = runner->enqueue(job);
+            jobClients.insert(id, client);
+
+            reply.append(static_cast<char>(JobQueued));
+            appendWord(reply, id);
+        }
+        else
+        {
+            reply.append(static_cast<char>(ProtocolError));
+            reply.append(error.toUtf8());
+        }
+    }
+    else if (type == CancelJob && message.size() >= 5)
+    {
+        const int id = static_cast<int>(wordAt(message, 1));
+        if (jobClients.value(id) == client && runner->cancel(id))
+        {
+            jobClients.remove(id);
+            reply.append(static_cast<char>(JobFinished));
+            appendWord(reply, id);
+            reply.append(static_cast<char>(0));
+            const QByteArray text = QString("The job was cancelled.").toUtf8();
+            appendWord(reply, text.size());
+            reply.append(text);
+        }
+        else
+        {
+            reply.append(static_cast<char>(ProtocolError));
+            reply.append("That job can't be cancelled");
+        }
+    }
+    else
+    {
+        reply.append(static_cast<char>(ProtocolError));
+        reply.append("Unrecognized message");
+    }
+
+    sendMessage(client, reply);
+}
+
+void ProgrammerDaemon::clientDisconnected()
+{
+    QLocalSocket *client = qobject_cast<QLocalSocket *>(sender());
+    if (!client)
+    {
+        return;
+    }
+
+    // Nobody is around to hear about their jobs anymore. Anything that
+    // hasn't started yet doesn't need to happen; anything running has
+    // to finish, but the result goes nowhere.
+    QHash<int, QLocalSocket *>::iterator it = jobClients.begin();
+    while (it != jobClients.end())
+    {
+        if (it.value() == client)
+        {
+            runner->cancel(it.key());
+            it = jobClients.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+
+    receiveBuffers.remove(client);
+    client->deleteLater();
+}
+
+void ProgrammerDaemon::sendMessage(QLocalSocket *client, QByteArray const &message)
+{
+    QByteArray framed;
+    appendWord(framed, message.size());
+    framed.append(message);
+    client->write(framed);
+}
+
+void ProgrammerDaemon::sendJobMessage(int id, QByteArray const &message)
+{
+    QLocalSocket *client = jobClients.value(id);
+    if (client)
+    {
+        sendMessage(client, message);
+    }
+}
+
+void ProgrammerDaemon::jobStarted(int id)
+{
+    QByteArray message;
+    message.append(static_cast<char>(JobStarted));
+    appendWord(message, id);
+    sendJobMessage(id, message);
+}
+
+void ProgrammerDaemon::jobProgress(int id, uint32_t done, uint32_t total)
+{
+    QByteArray message;
+    message.append(static_cast<char>(JobProgress));
+    appendWord(message, id);
+    appendWord(message, done);
+    appendWord(message, total);
+    sendJobMessage(id, message);
+}
+
+void ProgrammerDaemon::jobFinished(int id, bool success, QString message, QByteArray data)
+{
+    const QByteArray text = message.toUtf8();
+    QByteArray reply;
+    reply.append(static_cast<char>(JobFinished));
+    appendWord(reply, id);
+    reply.append(static_cast<char>(success ? 1 : 0));
+    appendWord(reply, text.size());
+    reply.append(text);
+    reply.append(data);
+    sendJobMessage(id, reply);
+    jobClients.remove(id);
+}
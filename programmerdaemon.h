@@ -0,0 +1,83 @@
+#ifndef PROGRAMMERDAEMON_H
+#define PROGRAMMERDAEMON_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QHash>
+#include <QString>
+#include "jobrunner.h"
+
+class QLocalServer;
+class QLocalSocket;
+
+// Owns the programmer and takes jobs from other programs over a local socket
+// (a Unix domain socket, or a named pipe on Windows), so several tools can
+// share one programmer board without fighting over the serial port.
+//
+// Every message in either direction is a 32-bit length followed by that many
+// bytes of payload. The first byte of the payload says what kind of message
+// it is. All multi-byte numbers are little-endian.
+//
+// Client to daemon:
+//   SubmitJob:     type, job type (ProgrammerJob::Type, up to ChecksumVerify;
+//                  there's no offset field, so WritePortion isn't accepted),
+//                  u32 SIMM capacity in bytes (0 = don't change it), chip
+//                  type, chip mask, verify mode, u32 read length (0 = entire
+//                  SIMM), then the image to write or verify against (if any).
+//                  The capacity and chip type have to be a pair from the SIMM
+//                  table, a write's chip mask has to be 0x01-0x0F, and neither
+//                  the length nor the image can be bigger than the SIMM.
+//   CancelJob:     type, u32 job ID. Only works if it hasn't started yet.
+//
+// Daemon to client:
+//   JobQueued:     type, u32 job ID
+//   JobStarted:    type, u32 job ID
+//   JobProgress:   type, u32 job ID, u32 bytes done, u32 bytes total
+//   JobFinished:   type, u32 job ID, success (0/1), u32 message length,
+//                  UTF-8 message, then any data (what was read, or the
+//                  chip IDs for an identification)
+//   ProtocolError: type, UTF-8 message
+class ProgrammerDaemon : public QObject
+{
+    Q_OBJECT
+public:
+    enum MessageType
+    {
+        SubmitJob = 0x01,
+        CancelJob = 0x02,
+
+        JobQueued = 0x81,
+        JobStarted = 0x82,
+        JobProgress = 0x83,
+        JobFinished = 0x84,
+        ProtocolError = 0xFF
+    };
+
+    explicit ProgrammerDaemon(Programmer *programmer, QObject *parent = 0);
+
+    bool listen(QString const &name = defaultSocketName());
+    static QString defaultSocketName();
+
+private slots:
+    void newConnection();
+    void clientReadyRead();
+    void clientDisconnected();
+
+    void jobStarted(int id);
+    void jobProgress(int id, uint32_t done, uint32_t total);
+    void jobFinished(int id, bool success, QString message, QByteArray data);
+
+private:
+    void handleMessage(QLocalSocket *client, QByteArray const &message);
+    void sendMessage(QLocalSocket *client, QByteArray const &message);
+    void sendJobMessage(int id, QByteArray const &message);
+
+    QLocalServer *server;
+    JobRunner *runner;
+
+    // Who asked for each job that hasn't finished yet
+    QHash<int, QLocalSocket *> jobClients;
+    QHash<QLocalSocket *, QByteArray> receiveBuffers;
+};
+
+#endif // PROGRAMMERDAEMON_H
@@ -0,0 +1,17 @@
+#include "programmertransport.h"
+#include "qextserialtransport.h"
+#ifdef Q_OS_LINUX
+#include "linuxserialtransport.h"
+#endif
+
+ProgrammerTransport *ProgrammerTransport::create(QObject *parent)
+{
+#ifdef Q_OS_LINUX
+    if (qgetenv("SIMMPROGRAMMER_TRANSPORT") != "qextserialport")
+    {
+        return new LinuxSerialTransport(parent);
+    }
+#endif
+
+    return new QextSerialTransport(parent);
+}
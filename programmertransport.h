@@ -0,0 +1,38 @@
+#ifndef PROGRAMMERTRANSPORT_H
+#define PROGRAMMERTRANSPORT_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QString>
+
+// The byte pipe between us and the programmer board. The board shows up as a
+// USB CDC serial port, but there's more than one way to talk to that, so
+// Programmer only deals with this interface.
+class ProgrammerTransport : public QObject
+{
+    Q_OBJECT
+public:
+    explicit ProgrammerTransport(QObject *parent = 0) : QObject(parent) {}
+    virtual ~ProgrammerTransport() {}
+
+    virtual void setPortName(QString const &name) = 0;
+    virtual bool open() = 0;
+    virtual void close() = 0;
+    virtual bool isOpen() const = 0;
+
+    // Writes never block; whatever can't go out right away is queued up
+    virtual qint64 write(const char *data, qint64 len) = 0;
+    qint64 write(QByteArray const &data) { return write(data.constData(), data.size()); }
+    virtual qint64 read(char *data, qint64 maxLen) = 0;
+    virtual bool atEnd() const = 0;
+
+    // Picks the best transport for this platform. On Linux, setting the
+    // SIMMPROGRAMMER_TRANSPORT environment variable to "qextserialport"
+    // forces the generic one.
+    static ProgrammerTransport *create(QObject *parent = 0);
+
+signals:
+    void readyRead();
+};
+
+#endif // PROGRAMMERTRANSPORT_H
@@ -0,0 +1,47 @@
+#include "qextserialtransport.h"
+
+QextSerialTransport::QextSerialTransport(QObject *parent) :
+    ProgrammerTransport(parent),
+    port(new QextSerialPort(QextSerialPort::EventDriven, this))
+{
+    connect(port, SIGNAL(readyRead()), SIGNAL(readyRead()));
+}
+
+void QextSerialTransport::setPortName(QString const &name)
+{
+    port->setPortName(name);
+}
+
+bool QextSerialTransport::open()
+{
+    if (port->isOpen())
+    {
+        return true;
+    }
+    return port->open(QextSerialPort::ReadWrite);
+}
+
+void QextSerialTransport::close()
+{
+    port->close();
+}
+
+bool QextSerialTransport::isOpen() const
+{
+    return port->isOpen();
+}
+
+qint64 QextSerialTransport::write(const char *data, qint64 len)
+{
+    return port->write(data, len);
+}
+
+qint64 QextSerialTransport::read(char *data, qint64 maxLen)
+{
+    return port->read(data, maxLen);
+}
+
+bool QextSerialTransport::atEnd() const
+{
+    return port->atEnd();
+}
@@ -0,0 +1,27 @@
+#ifndef QEXTSERIALTRANSPORT_H
+#define QEXTSERIALTRANSPORT_H
+
+#include "programmertransport.h"
+#include <qextserialport.h>
+
+// Talks to the programmer through QextSerialPort. Works everywhere.
+class QextSerialTransport : public ProgrammerTransport
+{
+    Q_OBJECT
+public:
+    explicit QextSerialTransport(QObject *parent = 0);
+
+    void setPortName(QString const &name);
+    bool open();
+    void close();
+    bool isOpen() const;
+
+    qint64 write(const char *data, qint64 len);
+    qint64 read(char *data, qint64 maxLen);
+    bool atEnd() const;
+
+private:
+    QextSerialPort *port;
+};
+
+#endif // QEXTSERIALTRANSPORT_H
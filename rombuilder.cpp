@@ -0,0 +1,187 @@
+#include "rombuilder.h"
+#include "bigendian.h"
+#include "fc8compressor.h"
+#include <QCryptographicHash>
+#include <QFile>
+#include <string.h>
+
+// Where each known ROM disk driver keeps the size of the disk image
+#define BBRAUN_8MB_IMAGE_SIZE_OFFSET        0x52500
+#define GARRETTS_WORKSHOP_IMAGE_SIZE_OFFSET 0x51DAC
+
+// The ROMs are identified by a byte pattern in the driver, which is here
+#define DRIVER_SIGNATURE_OFFSET             0x51DC0
+#define MIN_IDENTIFIABLE_LENGTH             0x51DC4
+
+ROMBuilder::ROMBuilder() :
+    _type(BaseROMUnknown),
+    _supportsCompression(false)
+{
+
+}
+
+bool ROMBuilder::loadBaseROM(const QString &fileName)
+{
+    QFile f(fileName);
+    if (!f.open(QFile::ReadOnly))
+    {
+        setBaseROM(QByteArray());
+        return false;
+    }
+    setBaseROM(f.readAll());
+    f.close();
+    return !_baseROM.isEmpty();
+}
+
+void ROMBuilder::setBaseROM(const QByteArray &baseROM)
+{
+    _baseROM = baseROM;
+    _type = identify(_baseROM);
+    _supportsCompression = supportsCompression(_baseROM);
+}
+
+bool ROMBuilder::loadDiskImage(const QString &fileName)
+{
+    QFile f(fileName);
+    if (!f.open(QFile::ReadOnly))
+    {
+        setDiskImage(QByteArray());
+        return false;
+    }
+    setDiskImage(f.readAll());
+    f.close();
+    return !_diskImage.isEmpty();
+}
+
+void ROMBuilder::setDiskImage(const QByteArray &diskImage)
+{
+    _diskImage = diskImage;
+    _diskImageHash.clear();
+}
+
+QByteArray ROMBuilder::diskImageHash() const
+{
+    if (_diskImageHash.isEmpty())
+    {
+        _diskImageHash = FC8Compressor::hashOf(_diskImage);
+    }
+    return _diskImageHash;
+}
+
+QByteArray ROMBuilder::patchedBaseROM() const
+{
+    QByteArray rom;
+    rom.resize(_baseROM.length());
+    memcpy(rom.data(), _baseROM.constData(), _baseROM.length());
+    patch(rom.data());
+    return rom;
+}
+
+QByteArray ROMBuilder::build(const QByteArray &imageToWrite) const
+{
+    if (_baseROM.isEmpty() || imageToWrite.isEmpty())
+    {
+        return QByteArray();
+    }
+
+    // resize() doesn't fill in anything, and everything gets copied over
+    QByteArray rom;
+    rom.resize(combinedSize(imageToWrite.length()));
+    memcpy(rom.data(), _baseROM.constData(), _baseROM.length());
+    patch(rom.data());
+    memcpy(rom.data() + _baseROM.length(), imageToWrite.constData(), imageToWrite.length());
+    return rom;
+}
+
+void ROMBuilder::patch(char *rom) const
+{
+    const uint32_t imageSize = _diskImage.length();
+
+    // If we find a base ROM that we know how to modify for the correct disk image size,
+    // perform the modification here.
+    switch (_type)
+    {
+    case BaseROMbbraun8MB:
+    {
+        // Identifying it only guarantees it's long enough for the signature
+        if (_baseROM.length() < BBRAUN_8MB_IMAGE_SIZE_OFFSET + 4)
+        {
+            break;
+        }
+        putBE32(rom + BBRAUN_8MB_IMAGE_SIZE_OFFSET, imageSize);
+
+        // bbraun's 8 MB 0.9.6 base image has a bug that can cause a bus error when booting with R+A
+        // if a write is attempted before the ROM disk has been copied to RAM. Work around this
+        // bug if the driver exactly matches the known broken driver. The fix is, when deciding if
+        // a write operation is allowed or not, to look at origdisk instead of drvsts.writeProt.
+        // writeProt can say the drive is writable even though it hasn't been copied to RAM yet.
+        // When origdisk is non-null, we're guaranteed it's in RAM, so it's a safer check.
+        QCryptographicHash driverHash(QCryptographicHash::Md5);
+        driverHash.addData(rom + 0x51D40, 0x7BC);
+        if (driverHash.result() ==
+            QByteArray("\x0E\x12\x43\x36\x03\x48\x5C\xDE\x2E\x4C\x04\xE3\x30\xF9\xD2\x0B", 16))
+        {
+            // Change opcode from tst.b to tst.l
+            rom[0x521F1] = static_cast<char>(0xAA);
+            // Change tested data from drvsts.writeProt to origdisk
+            rom[0x521F3] = 0x22;
+            // Change bne to beq
+            rom[0x521F4] = 0x67;
+        }
+        break;
+    }
+    case BaseROMGarrettsWorkshop:
+        // The signature comes after this, so it's always there
+        putBE32(rom + GARRETTS_WORKSHOP_IMAGE_SIZE_OFFSET, imageSize);
+        break;
+    case BaseROMUnknown:
+    case BaseROMbbraun2MB:
+    case BaseROMBMOW:
+    default:
+        break;
+    }
+}
+
+ROMBuilder::KnownBaseROM ROMBuilder::identify(const QByteArray &baseROM)
+{
+    if (baseROM.length() < MIN_IDENTIFIABLE_LENGTH)
+    {
+        return BaseROMUnknown;
+    }
+
+    const char *signature = baseROM.constData() + DRIVER_SIGNATURE_OFFSET;
+    if (baseROM.contains("Garrett's Workshop ROM Disk"))
+    {
+        return BaseROMGarrettsWorkshop;
+    }
+    else if (supportsCompression(baseROM))
+    {
+        return BaseROMBMOW;
+    }
+    // Look for a known byte pattern in bbraun's ROM disk driver
+    else if (memcmp(signature, "\x4E\xBA\x04\xDC", 4) == 0)
+    {
+        return BaseROMbbraun8MB;
+    }
+    // The pattern is slightly different in the 2 MB version
+    else if (memcmp(signature, "\x4E\xBA\x03\x02", 4) == 0)
+    {
+        return BaseROMbbraun2MB;
+    }
+
+    return BaseROMUnknown;
+}
+
+bool ROMBuilder::supportsCompression(const QByteArray &baseROM)
+{
+    // This string shows up in custom ROMs that support compression
+    return baseROM.contains(" block-compressed disk image");
+}
+
+bool ROMBuilder::isCompressedDiskImage(const QByteArray &image)
+{
+    // Look for start of FC8b or FC8_
+    return image.length() >= 4 && image.at(0) == 'F' &&
+        image.at(1) == 'C' && image.at(2) == '8' &&
+        (image.at(3) == 'b' || image.at(3) == '_');
+}
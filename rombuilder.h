@@ -0,0 +1,60 @@
+#ifndef ROMBUILDER_H
+#define ROMBUILDER_H
+
+#include <QByteArray>
+#include <QString>
+#include <stdint.h>
+
+// Puts together a combined ROM: the base ROM, patched so its ROM disk driver
+// knows how big the disk image is, followed by the disk image (possibly
+// compressed). Each file is read once, the base ROM is identified once, and
+// the combined image is built in a single allocation of its final size with
+// the patches written in place.
+class ROMBuilder
+{
+public:
+    enum KnownBaseROM
+    {
+        BaseROMUnknown,
+        BaseROMbbraun2MB,
+        BaseROMbbraun8MB,
+        BaseROMBMOW,
+        BaseROMGarrettsWorkshop,
+    };
+
+    ROMBuilder();
+
+    bool loadBaseROM(QString const &fileName);
+    void setBaseROM(QByteArray const &baseROM);
+    QByteArray const &baseROM() const { return _baseROM; }
+    KnownBaseROM baseROMType() const { return _type; }
+    bool baseROMSupportsCompression() const { return _supportsCompression; }
+
+    // The disk image as chosen, which may or may not be compressed already
+    bool loadDiskImage(QString const &fileName);
+    void setDiskImage(QByteArray const &diskImage);
+    QByteArray const &diskImage() const { return _diskImage; }
+    // Calculated the first time it's needed, the same way FC8Compressor does
+    QByteArray diskImageHash() const;
+
+    // The ROM disk driver gets told the size of the chosen disk image, even
+    // if what's actually written after it is compressed
+    QByteArray patchedBaseROM() const;
+    qint64 combinedSize(qint64 imageToWriteLength) const { return _baseROM.length() + imageToWriteLength; }
+    QByteArray build(QByteArray const &imageToWrite) const;
+
+    static KnownBaseROM identify(QByteArray const &baseROM);
+    static bool supportsCompression(QByteArray const &baseROM);
+    static bool isCompressedDiskImage(QByteArray const &image);
+
+private:
+    void patch(char *rom) const;
+
+    QByteArray _baseROM;
+    KnownBaseROM _type;
+    bool _supportsCompression;
+    QByteArray _diskImage;
+    mutable QByteArray _diskImageHash;
+};
+
+#endif // ROMBUILDER_H
@@ -0,0 +1,237 @@
+#include "romchecksum.h"
+
+// Offsets of interesting fields in the Mac ROM header
+#define ROM_HEADER_CHECKSUM_OFFSET  0x00
+#define ROM_HEADER_VERSION_OFFSET   0x09
+#define ROM_HEADER_LENGTH_OFFSET    0x40
+#define ROM_HEADER_SIZE             0x44
+
+// The checksum is calculated starting after the checksum field itself
+#define ROM_CHECKSUM_START          4
+
+static const struct
+{
+    uint32_t checksum;
+    const char *model;
+} romChecksumsAndModels[] = {
+    {0x28BA61CEUL, "128k or 512k"},
+    {0x28BA4E50UL, "128k or 512k"},
+    {0x4D1EEEE1UL, "Plus"},
+    {0x4D1EEAE1UL, "Plus"},
+    {0x4D1F8172UL, "Plus"},
+    {0xB2E362A8UL, "SE"},
+    {0xB306E171UL, "SE FDHD"},
+    {0x9779D2C4UL, "II"},
+    {0x97851DB6UL, "II"},
+    {0x97221136UL, "IIx, IIcx, or SE/30"},
+    {0x368CADFEUL, "IIci"},
+    {0x36B7FB6CUL, "IIsi"},
+    {0x4147DD77UL, "IIfx"},
+    {0x4957EB49UL, "IIvx or IIvi"},
+    {0x49579803UL, "IIvx or IIvi"},
+    {0xA49F9914UL, "Classic"},
+    {0x3193670EUL, "Classic II"},
+    {0xECD99DC0UL, "Color Classic"},
+    {0xEDE66CBDUL, "Color Classic II, LC 550, or TV"},
+    {0xEAF1678DUL, "Color Classic II, LC 550, or TV"},
+    {0x350EACF0UL, "LC"},
+    {0x35C28F5FUL, "LC II"},
+    {0xEC904829UL, "LC III"},
+    {0xECBBC41CUL, "LC III"},
+    {0x064DC91DUL, "LC 580"},
+    {0xF1A6F343UL, "Quadra/Centris 610, 650, or 800"},
+    {0x420DBFF3UL, "Quadra 700 or 900"},
+    {0x3DC27823UL, "Quadra 950"},
+    {0xFF7439EEUL, "Quadra 605, LC 475, or LC 575"},
+    {0x06684214UL, "Quadra 630"},
+    {0x5BF10FD1UL, "Quadra 660av or 840av"},
+    {0x87D3C814UL, "Quadra 660av or 840av"},
+};
+
+ROMChecksum::ROMChecksum() :
+    // Preserve Qt 4 compatibility, just in case...
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 0, 0))
+    _hash(QCryptographicHash::Sha256)
+#else
+    _hash(QCryptographicHash::Sha1)
+#endif
+{
+    reset();
+}
+
+const char *ROMChecksum::hashName()
+{
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 0, 0))
+    return "SHA-256";
+#else
+    return "SHA-1";
+#endif
+}
+
+void ROMChecksum::reset()
+{
+    _header.clear();
+    _bytesProcessed = 0;
+    _runningChecksum = 0;
+    _pendingHighByte = 0;
+    _checksumSnapshots.clear();
+    _hash.reset();
+}
+
+void ROMChecksum::addData(const char *data, int len)
+{
+    if (len <= 0)
+    {
+        return;
+    }
+
+    _hash.addData(data, len);
+
+    // Hang onto the header so we can look at it when we're done
+    if (_header.length() < ROM_HEADER_SIZE)
+    {
+        _header.append(data, qMin(len, ROM_HEADER_SIZE - _header.length()));
+    }
+
+    for (int i = 0; i < len; i++)
+    {
+        const uint32_t pos = _bytesProcessed++;
+        const uint8_t b = static_cast<uint8_t>(data[i]);
+
+        // The checksum is a sum of big-endian 16-bit words, skipping the
+        // checksum field at the start of the ROM
+        if (pos >= ROM_CHECKSUM_START)
+        {
+            if ((pos & 1) == 0)
+            {
+                _pendingHighByte = b;
+            }
+            else
+            {
+                _runningChecksum += (static_cast<uint16_t>(_pendingHighByte) << 8) | b;
+            }
+        }
+
+        // Save the checksum at each possible ROM length boundary
+        if (_bytesProcessed % SnapshotInterval == 0)
+        {
+            _checksumSnapshots.append(_runningChecksum);
+        }
+    }
+}
+
+bool ROMChecksum::hasHeader() const
+{
+    return _header.length() >= ROM_HEADER_SIZE;
+}
+
+uint32_t ROMChecksum::checksumInHeader() const
+{
+    if (!hasHeader())
+    {
+        return 0;
+    }
+
+    return static_cast<uint32_t>(static_cast<uint8_t>(_header.at(ROM_HEADER_CHECKSUM_OFFSET + 0))) << 24 |
+           static_cast<uint32_t>(static_cast<uint8_t>(_header.at(ROM_HEADER_CHECKSUM_OFFSET + 1))) << 16 |
+           static_cast<uint32_t>(static_cast<uint8_t>(_header.at(ROM_HEADER_CHECKSUM_OFFSET + 2))) << 8 |
+           static_cast<uint32_t>(static_cast<uint8_t>(_header.at(ROM_HEADER_CHECKSUM_OFFSET + 3))) << 0;
+}
+
+uint32_t ROMChecksum::lengthInHeader() const
+{
+    if (!hasHeader())
+    {
+        return 0;
+    }
+
+    return static_cast<uint32_t>(static_cast<uint8_t>(_header.at(ROM_HEADER_LENGTH_OFFSET + 0))) << 24 |
+           static_cast<uint32_t>(static_cast<uint8_t>(_header.at(ROM_HEADER_LENGTH_OFFSET + 1))) << 16 |
+           static_cast<uint32_t>(static_cast<uint8_t>(_header.at(ROM_HEADER_LENGTH_OFFSET + 2))) << 8 |
+           static_cast<uint32_t>(static_cast<uint8_t>(_header.at(ROM_HEADER_LENGTH_OFFSET + 3))) << 0;
+}
+
+uint8_t ROMChecksum::romVersion() const
+{
+    if (!hasHeader())
+    {
+        return 0;
+    }
+
+    return static_cast<uint8_t>(_header.at(ROM_HEADER_VERSION_OFFSET));
+}
+
+bool ROMChecksum::checksumForLength(uint32_t len, uint32_t &checksum) const
+{
+    if (len > _bytesProcessed)
+    {
+        return false;
+    }
+
+    // We can answer for the full amount of data we've seen so far, or for
+    // any of the snapshot boundaries we've passed along the way
+    if (len == _bytesProcessed && (len & 1) == 0)
+    {
+        checksum = _runningChecksum;
+        return true;
+    }
+    else if (len > 0 && len % SnapshotInterval == 0)
+    {
+        checksum = _checksumSnapshots.at(len / SnapshotInterval - 1);
+        return true;
+    }
+
+    return false;
+}
+
+bool ROMChecksum::checksumMatchesHeader(uint32_t &romLength, uint32_t &actualChecksum) const
+{
+    if (!hasHeader())
+    {
+        return false;
+    }
+
+    const uint32_t checksumInROM = checksumInHeader();
+
+    // ROM versions up to 0x78 don't have the ROM length embedded.
+    // It's unclear whether ROM 0x79 has the ROM length embedded or not.
+    // For those, try a few possible lengths to see if any of them match.
+    if (romVersion() < 0x7A)
+    {
+        for (uint32_t tmpLen = 64*1024; tmpLen <= 512*1024; tmpLen *= 2)
+        {
+            if (checksumForLength(tmpLen, actualChecksum) && actualChecksum == checksumInROM)
+            {
+                romLength = tmpLen;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    romLength = lengthInHeader();
+    if (romLength > 4 * 1048576 || romLength % (64*1024))
+    {
+        return false;
+    }
+
+    return checksumForLength(romLength, actualChecksum) && actualChecksum == checksumInROM;
+}
+
+QByteArray ROMChecksum::hash() const
+{
+    return _hash.result();
+}
+
+const char *ROMChecksum::modelForChecksum(uint32_t checksum)
+{
+    for (size_t i = 0; i < sizeof(romChecksumsAndModels) / sizeof(romChecksumsAndModels[0]); i++)
+    {
+        if (romChecksumsAndModels[i].checksum == checksum)
+        {
+            return romChecksumsAndModels[i].model;
+        }
+    }
+
+    return NULL;
+}
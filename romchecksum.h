@@ -0,0 +1,47 @@
+#ifndef ROMCHECKSUM_H
+#define ROMCHECKSUM_H
+
+#include <QByteArray>
+#include <QCryptographicHash>
+#include <QVector>
+#include <stdint.h>
+
+// Incrementally calculates the standard Mac ROM checksum (and a hash of the
+// raw data) as data is streamed in, so a ROM can be validated while it's
+// being read rather than in a second pass afterward.
+class ROMChecksum
+{
+public:
+    ROMChecksum();
+
+    void reset();
+    void addData(const char *data, int len);
+
+    uint32_t bytesProcessed() const { return _bytesProcessed; }
+    bool hasHeader() const;
+    uint32_t checksumInHeader() const;
+    uint32_t lengthInHeader() const;
+    uint8_t romVersion() const;
+
+    bool checksumForLength(uint32_t len, uint32_t &checksum) const;
+    bool checksumMatchesHeader(uint32_t &romLength, uint32_t &actualChecksum) const;
+    QByteArray hash() const;
+    // Which hash that is; it depends on what the Qt version supports
+    static const char *hashName();
+
+    static const char *modelForChecksum(uint32_t checksum);
+
+private:
+    // The checksum is snapshotted at every multiple of this many bytes, which
+    // covers every ROM length we need to be able to check.
+    static const uint32_t SnapshotInterval = 64 * 1024;
+
+    QByteArray _header;
+    uint32_t _bytesProcessed;
+    uint32_t _runningChecksum;
+    uint8_t _pendingHighByte;
+    QVector<uint32_t> _checksumSnapshots;
+    QCryptographicHash _hash;
+};
+
+#endif // ROMCHECKSUM_H
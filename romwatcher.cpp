@@ -0,0 +1,243 @@
+#include "romwatcher.h"
+#include "rombuilder.h"
+#include <QFileInfo>
+#include <QFileSystemWatcher>
+#include <QStringList>
+#include <QThread>
+#include <QTimer>
+#include <string.h>
+
+// How long a file has to stop changing before it's rebuilt
+#define SETTLE_TIME_MS      500
+
+ROMWatchRebuilder::ROMWatchRebuilder(int blockSize, FC8Compressor::Mode mode) :
+    QObject(NULL),
+    _compressor(blockSize, mode)
+{
+
+}
+
+void ROMWatchRebuilder::rebuild(QString baseROMFile, QString diskImageFile)
+{
+    ROMBuilder builder;
+    if (!builder.loadBaseROM(baseROMFile) || !builder.loadDiskImage(diskImageFile))
+    {
+        emit rebuildFailed("Unable to read the base ROM or the disk image.");
+        return;
+    }
+
+    QByteArray imageToWrite;
+    QString summary;
+    const bool alreadyCompressed = ROMBuilder::isCompressedDiskImage(builder.diskImage());
+    if (builder.baseROMSupportsCompression() && !alreadyCompressed)
+    {
+        imageToWrite = _compressor.compress(builder.diskImage());
+        if (imageToWrite.isEmpty())
+        {
+            emit rebuildFailed("Unable to compress the disk image.");
+            return;
+        }
+        summary = QString("compressed %1 of %2 blocks")
+                .arg(_compressor.compressedBlockCount())
+                .arg(_compressor.totalBlockCount());
+    }
+    else if (!builder.baseROMSupportsCompression() && alreadyCompressed)
+    {
+        emit rebuildFailed("ROM doesn't support compression, but disk image is compressed");
+        return;
+    }
+    else
+    {
+        imageToWrite = builder.diskImage();
+        _compressor.reset();
+    }
+
+    emit rebuilt(builder.build(imageToWrite), summary);
+}
+
+ROMWatcher::ROMWatcher(QObject *parent) :
+    QObject(parent),
+    _watcher(new QFileSystemWatcher(this)),
+    _settleTimer(new QTimer(this)),
+    _thread(NULL),
+    _rebuilder(NULL),
+    _rebuilding(false),
+    _rebuildPending(false)
+{
+    _settleTimer->setSingleShot(true);
+    _settleTimer->setInterval(SETTLE_TIME_MS);
+    connect(_settleTimer, SIGNAL(timeout()), SLOT(startRebuild()));
+    connect(_watcher, SIGNAL(fileChanged(QString)), SLOT(fileChanged(QString)));
+}
+
+ROMWatcher::~ROMWatcher()
+{
+    stop();
+}
+
+void ROMWatcher::start(const QString &baseROMFile, const QString &diskImageFile,
+                       int blockSize, FC8Compressor::Mode mode)
+{
+    stop();
+
+    _baseROMFile = baseROMFile;
+    _diskImageFile = diskImageFile;
+
+    // The first rebuild compresses the whole disk image, which takes a
+    // while, so none of this happens on the GUI thread
+    _thread = new QThread();
+    _rebuilder = new ROMWatchRebuilder(blockSize, mode);
+    _rebuilder->moveToThread(_thread);
+    connect(this, SIGNAL(rebuildRequested(QString,QString)), _rebuilder, SLOT(rebuild(QString,QString)));
+    connect(_rebuilder, SIGNAL(rebuilt(QByteArray,QString)), SLOT(rebuilderFinished(QByteArray,QString)));
+    connect(_rebuilder, SIGNAL(rebuildFailed(QString)), SLOT(rebuilderFailed(QString)));
+    // Once the thread is told to stop, it cleans up after itself
+    connect(_thread, SIGNAL(finished()), _rebuilder, SLOT(deleteLater()));
+    connect(_thread, SIGNAL(finished()), _thread, SLOT(deleteLater()));
+    _thread->start();
+
+    watchFiles();
+    startRebuild();
+}
+
+void ROMWatcher::stop()
+{
+    _settleTimer->stop();
+    if (!_watcher->files().isEmpty())
+    {
+        _watcher->removePaths(_watcher->files());
+    }
+
+    if (_rebuilder)
+    {
+        // Don't wait for a rebuild that's still going; just make sure we
+        // don't hear about it
+        disconnect(this, SIGNAL(rebuildRequested(QString,QString)), _rebuilder, SLOT(rebuild(QString,QString)));
+        disconnect(_rebuilder, 0, this, 0);
+        _thread->quit();
+        _thread = NULL;
+        _rebuilder = NULL;
+    }
+
+    _rebuilding = false;
+    _rebuildPending = false;
+}
+
+void ROMWatcher::watchFiles()
+{
+    // Editors that save by writing a new file and renaming it over the old
+    // one make the watcher lose track of it, so keep adding them back
+    QStringList paths;
+    paths << _baseROMFile << _diskImageFile;
+    foreach (QString const &path, paths)
+    {
+        if (!_watcher->files().contains(path) && QFileInfo(path).exists())
+        {
+            _watcher->addPath(path);
+        }
+    }
+}
+
+void ROMWatcher::fileChanged(const QString &path)
+{
+    Q_UNUSED(path);
+    if (!isWatching())
+    {
+        return;
+    }
+
+    // Wait for it to settle down. Every change starts the wait over.
+    _settleTimer->start();
+}
+
+void ROMWatcher::startRebuild()
+{
+    if (!isWatching())
+    {
+        return;
+    }
+
+    watchFiles();
+
+    // One at a time; if something changes partway through, go again after
+    if (_rebuilding)
+    {
+        _rebuildPending = true;
+        return;
+    }
+
+    _rebuilding = true;
+    _rebuildPending = false;
+    emit rebuildRequested(_baseROMFile, _diskImageFile);
+}
+
+void ROMWatcher::rebuilderFinished(QByteArray combinedImage, QString summary)
+{
+    rebuildDone();
+    emit rebuilt(combinedImage, summary);
+}
+
+void ROMWatcher::rebuilderFailed(QString error)
+{
+    rebuildDone();
+    emit rebuildFailed(error);
+}
+
+void ROMWatcher::rebuildDone()
+{
+    _rebuilding = false;
+    if (_rebuildPending)
+    {
+        startRebuild();
+    }
+}
+
+QList<QPair<uint32_t, uint32_t> > ROMWatcher::changedRanges(const QByteArray &previous, const QByteArray &current,
+                                                            const SectorIndex &sectors, uint32_t fallbackEraseSize,
+                                                            uint32_t simmCapacity)
+{
+    QList<QPair<uint32_t, uint32_t> > ranges;
+    const uint32_t currentEnd = qMin(static_cast<uint32_t>(current.length()), simmCapacity);
+    const uint32_t previousEnd = previous.length();
+
+    uint32_t sectorStart = 0;
+    while (sectorStart < currentEnd)
+    {
+        // Go by the chips' own sectors if we know them, otherwise by the
+        // same fixed size the programmer assumes
+        uint32_t sectorLength = 0;
+        const int sector = sectors.isValid() ? sectors.sectorAt(sectorStart) : -1;
+        uint32_t boundsStart;
+        if (sector >= 0 && sectors.sectorBounds(sector, boundsStart, sectorLength) &&
+            boundsStart + sectorLength > sectorStart)
+        {
+            sectorLength = boundsStart + sectorLength - sectorStart;
+        }
+        else
+        {
+            sectorLength = fallbackEraseSize - (sectorStart % fallbackEraseSize);
+        }
+        const uint32_t sectorEnd = qMin(sectorStart + sectorLength, simmCapacity);
+
+        // Past the end of what was written before, who knows what's there
+        const uint32_t compareEnd = qMin(sectorEnd, currentEnd);
+        const bool changed = previous.isEmpty() || compareEnd > previousEnd ||
+                memcmp(previous.constData() + sectorStart, current.constData() + sectorStart,
+                       compareEnd - sectorStart) != 0;
+        if (changed)
+        {
+            if (!ranges.isEmpty() && ranges.last().first + ranges.last().second == sectorStart)
+            {
+                ranges.last().second += sectorEnd - sectorStart;
+            }
+            else
+            {
+                ranges.append(qMakePair(sectorStart, sectorEnd - sectorStart));
+            }
+        }
+
+        sectorStart = sectorEnd;
+    }
+
+    return ranges;
+}
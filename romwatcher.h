@@ -0,0 +1,90 @@
+#ifndef ROMWATCHER_H
+#define ROMWATCHER_H
+
+#include <QObject>
+#include <QList>
+#include <QPair>
+#include <QString>
+#include "fc8compressor.h"
+#include "fc8incrementalcompressor.h"
+#include "sectorindex.h"
+
+class QFileSystemWatcher;
+class QThread;
+class QTimer;
+
+// Does the actual rebuilding for ROMWatcher, on its thread. It holds on to
+// the compressed blocks from one rebuild to the next.
+class ROMWatchRebuilder : public QObject
+{
+    Q_OBJECT
+public:
+    ROMWatchRebuilder(int blockSize, FC8Compressor::Mode mode);
+
+public slots:
+    void rebuild(QString baseROMFile, QString diskImageFile);
+
+signals:
+    void rebuilt(QByteArray combinedImage, QString summary);
+    void rebuildFailed(QString error);
+
+private:
+    FC8IncrementalCompressor _compressor;
+};
+
+// Watches the base ROM and disk image that go into a combined ROM, and
+// rebuilds the combined ROM whenever either one changes. Changes are given a
+// moment to settle, since editors tend to save in several steps. Rebuilding
+// happens in the background and only compresses the parts of the disk image
+// that changed since the last rebuild.
+class ROMWatcher : public QObject
+{
+    Q_OBJECT
+public:
+    explicit ROMWatcher(QObject *parent = NULL);
+    ~ROMWatcher();
+
+    // Rebuilds once right away, then again after every change
+    void start(QString const &baseROMFile, QString const &diskImageFile,
+               int blockSize, FC8Compressor::Mode mode);
+    void stop();
+    bool isWatching() const { return _rebuilder != NULL; }
+
+    // The (offset, length) ranges that have to be written to get from the
+    // previous image to the current one on the SIMM, in whole erase sectors.
+    // Adjacent sectors are merged into one range. An empty previous image
+    // means nothing is known about what's on the SIMM, so all of it changed.
+    // Anything in a range past the end of the current image should be
+    // written as 0xFF, same as a full write would leave it.
+    static QList<QPair<uint32_t, uint32_t> > changedRanges(QByteArray const &previous, QByteArray const &current,
+                                                          SectorIndex const &sectors, uint32_t fallbackEraseSize,
+                                                          uint32_t simmCapacity);
+
+signals:
+    void rebuilt(QByteArray combinedImage, QString summary);
+    void rebuildFailed(QString error);
+
+    // Used to hand work to the rebuilder's thread
+    void rebuildRequested(QString baseROMFile, QString diskImageFile);
+
+private slots:
+    void fileChanged(QString const &path);
+    void startRebuild();
+    void rebuilderFinished(QByteArray combinedImage, QString summary);
+    void rebuilderFailed(QString error);
+
+private:
+    void watchFiles();
+    void rebuildDone();
+
+    QFileSystemWatcher *_watcher;
+    QTimer *_settleTimer;
+    QThread *_thread;
+    ROMWatchRebuilder *_rebuilder;
+    QString _baseROMFile;
+    QString _diskImageFile;
+    bool _rebuilding;
+    bool _rebuildPending;
+};
+
+#endif // ROMWATCHER_H
@@ -0,0 +1,159 @@
+#include "sectorindex.h"
+
+SectorIndex::SectorIndex() :
+    _length(0),
+    _sectorCount(0)
+{
+}
+
+SectorIndex::SectorIndex(ChipID::ChipInfo const &chip, uint32_t simmCapacity) :
+    _length(0),
+    _sectorCount(0)
+{
+    build(chip.sectors, chip.width, simmCapacity);
+}
+
+SectorIndex::SectorIndex(QList<QPair<uint16_t, uint32_t> > const &sectors, uint8_t chipWidth, uint32_t simmCapacity) :
+    _length(0),
+    _sectorCount(0)
+{
+    build(sectors, chipWidth, simmCapacity);
+}
+
+void SectorIndex::build(QList<QPair<uint16_t, uint32_t> > const &sectors, uint8_t chipWidth, uint32_t simmCapacity)
+{
+    // Each sector size in the layout is for a single chip. The SIMM has a
+    // 32-bit data bus, so a sector of one chip is spread across the same
+    // sector of every chip. With 8-bit chips there are four of them, and
+    // with 16-bit chips there are two, but their sector sizes are in words.
+    const uint32_t simmBytesPerSectorUnit = (chipWidth == 16) ? (2 * 2) : 4;
+
+    uint32_t offset = 0;
+    for (int i = 0; i < sectors.count() && offset < simmCapacity; i++)
+    {
+        Run run;
+        run.start = offset;
+        run.sectorSize = sectors[i].second * simmBytesPerSectorUnit;
+        run.firstSector = _sectorCount;
+        run.count = sectors[i].first;
+        if (run.sectorSize == 0 || run.count == 0)
+        {
+            continue;
+        }
+
+        // Chips like the MX29LV640 are bigger than the 8 MB the programmer
+        // can address at once. Their layouts in chipid.txt describe every
+        // chunk, so stop at the end of the addressable window.
+        const uint32_t sectorsThatFit = (simmCapacity - offset + run.sectorSize - 1) / run.sectorSize;
+        if (static_cast<uint32_t>(run.count) > sectorsThatFit)
+        {
+            run.count = static_cast<int>(sectorsThatFit);
+        }
+
+        _runs.append(run);
+        _sectorCount += run.count;
+        offset += run.sectorSize * run.count;
+    }
+
+    _length = qMin(offset, simmCapacity);
+}
+
+int SectorIndex::runContaining(uint32_t offset) const
+{
+    if (offset >= _length)
+    {
+        return -1;
+    }
+
+    // Find the last run that starts at or before the offset
+    int low = 0;
+    int high = _runs.count() - 1;
+    while (low < high)
+    {
+        const int mid = (low + high + 1) / 2;
+        if (_runs[mid].start <= offset)
+        {
+            low = mid;
+        }
+        else
+        {
+            high = mid - 1;
+        }
+    }
+
+    return low;
+}
+
+int SectorIndex::runContainingSector(int sector) const
+{
+    if (sector < 0 || sector >= _sectorCount)
+    {
+        return -1;
+    }
+
+    int low = 0;
+    int high = _runs.count() - 1;
+    while (low < high)
+    {
+        const int mid = (low + high + 1) / 2;
+        if (_runs[mid].firstSector <= sector)
+        {
+            low = mid;
+        }
+        else
+        {
+            high = mid - 1;
+        }
+    }
+
+    return low;
+}
+
+int SectorIndex::sectorAt(uint32_t offset) const
+{
+    const int runIndex = runContaining(offset);
+    if (runIndex < 0)
+    {
+        return -1;
+    }
+
+    Run const &run = _runs[runIndex];
+    return run.firstSector + static_cast<int>((offset - run.start) / run.sectorSize);
+}
+
+bool SectorIndex::sectorBounds(int sector, uint32_t &start, uint32_t &length) const
+{
+    const int runIndex = runContainingSector(sector);
+    if (runIndex < 0)
+    {
+        return false;
+    }
+
+    Run const &run = _runs[runIndex];
+    start = run.start + static_cast<uint32_t>(sector - run.firstSector) * run.sectorSize;
+    length = qMin(run.sectorSize, _length - start);
+    return true;
+}
+
+bool SectorIndex::span(uint32_t offset, uint32_t length, Span &result) const
+{
+    if (length == 0 || offset >= _length || length > _length - offset)
+    {
+        return false;
+    }
+
+    result.firstSector = sectorAt(offset);
+    result.lastSector = sectorAt(offset + length - 1);
+
+    uint32_t lastStart;
+    uint32_t lastLength;
+    uint32_t firstLength;
+    if (!sectorBounds(result.firstSector, result.start, firstLength) ||
+        !sectorBounds(result.lastSector, lastStart, lastLength))
+    {
+        return false;
+    }
+
+    result.end = lastStart + lastLength;
+    return true;
+}
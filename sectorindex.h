@@ -0,0 +1,55 @@
+#ifndef SECTORINDEX_H
+#define SECTORINDEX_H
+
+#include <QList>
+#include <QPair>
+#include <QVector>
+#include <stdint.h>
+#include "chipid.h"
+
+// Maps offsets in the SIMM's address space to erase sectors. The sector
+// layouts in ChipID are per chip; this takes care of the chips being
+// interleaved on the SIMM's 32-bit data bus, and of layouts that describe
+// more of the chip than the programmer can address at once.
+class SectorIndex
+{
+public:
+    struct Span
+    {
+        int firstSector;
+        int lastSector;
+        uint32_t start;     // offset of the beginning of firstSector
+        uint32_t end;       // offset just past the end of lastSector
+    };
+
+    SectorIndex();
+    SectorIndex(ChipID::ChipInfo const &chip, uint32_t simmCapacity);
+    SectorIndex(QList<QPair<uint16_t, uint32_t> > const &sectors, uint8_t chipWidth, uint32_t simmCapacity);
+
+    bool isValid() const { return _sectorCount > 0; }
+    int sectorCount() const { return _sectorCount; }
+    uint32_t length() const { return _length; }
+
+    int sectorAt(uint32_t offset) const;
+    bool sectorBounds(int sector, uint32_t &start, uint32_t &length) const;
+    bool span(uint32_t offset, uint32_t length, Span &result) const;
+
+private:
+    struct Run
+    {
+        uint32_t start;
+        uint32_t sectorSize;
+        int firstSector;
+        int count;
+    };
+
+    void build(QList<QPair<uint16_t, uint32_t> > const &sectors, uint8_t chipWidth, uint32_t simmCapacity);
+    int runContaining(uint32_t offset) const;
+    int runContainingSector(int sector) const;
+
+    QVector<Run> _runs;
+    uint32_t _length;
+    int _sectorCount;
+};
+
+#endif // SECTORINDEX_H
@@ -0,0 +1,29 @@
+#include "simmtable.h"
+#include "programmer.h"
+
+const SIMMDesc simmTable[] ={
+    {0, "128KB (4x 256Kb PLCC)", 128, SIMM_PLCC_x8 },
+    {1, "256KB (4x 512Kb PLCC)", 256, SIMM_PLCC_x8 },
+    {2, "512KB (4x 1Mb PLCC)",   512, SIMM_PLCC_x8 },
+    {3, "1MB (4x 2Mb PLCC)",    1024, SIMM_PLCC_x8 },
+    {4, "2MB (4x 4Mb PLCC)",    2048, SIMM_PLCC_x8 },
+    {8, "2MB (2x 8Mb TSOP)",    2048, SIMM_TSOP_x16},
+    {9, "4MB (4x 8Mb TSOP)",    4096, SIMM_TSOP_x8 },
+    {5, "4MB (2x 16Mb TSOP)",   4096, SIMM_TSOP_x16},
+    {6, "8MB (4x 16Mb TSOP)",   8192, SIMM_TSOP_x8 },
+    {7, "8MB (2x 32Mb TSOP)",   8192, SIMM_TSOP_x16},
+};
+
+const size_t simmTableCount = sizeof(simmTable) / sizeof(simmTable[0]);
+
+bool isKnownSIMMType(uint32_t capacity, uint32_t chipType)
+{
+    for (size_t i = 0; i < simmTableCount; i++)
+    {
+        if (simmTable[i].size * 1024 == capacity && simmTable[i].chipType == chipType)
+        {
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,21 @@
+#ifndef SIMMTABLE_H
+#define SIMMTABLE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// The kinds of SIMM the programmer knows how to handle
+struct SIMMDesc {
+    uint32_t saveValue;
+    const char *text;
+    uint32_t size;          // KB
+    uint32_t chipType;
+};
+
+extern const SIMMDesc simmTable[];
+extern const size_t simmTableCount;
+
+// Whether this capacity (in bytes) and chip type are one of the above
+bool isKnownSIMMType(uint32_t capacity, uint32_t chipType);
+
+#endif // SIMMTABLE_H
@@ -0,0 +1,130 @@
+#!/usr/bin/env python3
+#
+# Converts chipid.txt into a sorted table of chips that gets compiled directly
+# into the program, so nothing needs to be parsed at runtime. The format of
+# chipid.txt is described by the comment at the top of that file.
+#
+# Usage: chipid_gen.py <chipid.txt> <output header>
+
+import sys
+
+
+def decode_sector_size(size):
+    multiplier = 1
+    if size.endswith('K'):
+        multiplier = 1024
+        size = size[:-1]
+    elif size.endswith('M'):
+        multiplier = 1048576
+        size = size[:-1]
+    return int(size) * multiplier
+
+
+def decode_sectors(sectors):
+    runs = []
+    for group in sectors.split(','):
+        parts = group.split('*')
+        if len(parts) == 1:
+            count, size = 1, decode_sector_size(parts[0])
+        elif len(parts) == 2:
+            count, size = int(parts[0]), decode_sector_size(parts[1])
+        else:
+            raise ValueError('bad sector group "%s"' % group)
+        if count == 0 or size == 0:
+            raise ValueError('bad sector group "%s"' % group)
+        runs.append((count, size))
+    return runs
+
+
+def c_string(s):
+    return '"' + s.replace('\\', '\\\\').replace('"', '\\"') + '"'
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.stderr.write('usage: %s <chipid.txt> <output header>\n' % sys.argv[0])
+        return 1
+
+    chips = []
+    with open(sys.argv[1], 'r') as f:
+        for lineno, line in enumerate(f, 1):
+            line = line.strip()
+            if not line or line.startswith(';'):
+                continue
+
+            fields = line.split()
+            if len(fields) != 8:
+                sys.stderr.write('%s:%d: expected 8 fields\n' % (sys.argv[1], lineno))
+                return 1
+
+            manufacturer, product, width, capacity, sectors, mfg_id, prod_id, shifted = fields
+            width = int(width)
+            capacity = int(capacity) * 1024
+            runs = decode_sectors(sectors)
+
+            # Sanity-check the sector list against the total capacity.
+            # In 16-bit mode the sector sizes are in words.
+            total = sum(count * size for count, size in runs)
+            if width == 16:
+                total *= 2
+            if total != capacity:
+                sys.stderr.write('%s:%d: chip "%s %s" has mismatched sector sizes\n' %
+                                 (sys.argv[1], lineno, manufacturer, product))
+                return 1
+
+            chips.append({
+                'manufacturer': manufacturer,
+                'product': product,
+                'width': width,
+                'capacity': capacity,
+                'runs': runs,
+                'manufacturerID': int(mfg_id, 16),
+                'productID': int(prod_id, 16),
+                'unlockShifted': shifted.upper() == 'YES',
+                'lineno': lineno,
+            })
+
+    # Sort by lookup key so the program can binary search the table
+    def key(c):
+        return (c['manufacturerID'], c['productID'], c['width'], c['unlockShifted'])
+    chips.sort(key=key)
+    for a, b in zip(chips, chips[1:]):
+        if key(a) == key(b):
+            sys.stderr.write('%s:%d: duplicate of chip on line %d\n' %
+                             (sys.argv[1], b['lineno'], a['lineno']))
+            return 1
+
+    out = []
+    out.append('// Generated by tools/chipid_gen.py from chipid.txt. Do not edit.')
+    out.append('')
+    # Chips with identical sector layouts share a single run list
+    out.append('static const ChipSectorRun builtinSectorRuns[] = {')
+    first_runs = {}
+    first_run = 0
+    for c in chips:
+        runs = tuple(c['runs'])
+        if runs not in first_runs:
+            first_runs[runs] = first_run
+            for count, size in runs:
+                out.append('    {%d, %d},' % (count, size))
+            first_run += len(runs)
+        c['firstRun'] = first_runs[runs]
+    out.append('};')
+    out.append('')
+    out.append('static const BuiltinChip builtinChips[] = {')
+    for c in chips:
+        out.append('    {0x%04X, 0x%04X, %d, %s, %s, %s, %d, %d, %d},' % (
+            c['manufacturerID'], c['productID'], c['width'],
+            'true' if c['unlockShifted'] else 'false',
+            c_string(c['manufacturer']), c_string(c['product']),
+            c['capacity'], c['firstRun'], len(c['runs'])))
+    out.append('};')
+    out.append('')
+
+    with open(sys.argv[2], 'w') as f:
+        f.write('\n'.join(out))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
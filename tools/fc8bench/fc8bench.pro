@@ -0,0 +1,24 @@
+# Compares the fast and high-ratio FC8 encoders on real disk images:
+#   fc8bench image1.dsk [image2.dsk ...]
+
+QT       += core
+QT       -= gui
+
+TARGET = fc8bench
+CONFIG += console
+CONFIG -= app_bundle
+TEMPLATE = app
+
+INCLUDEPATH += ../..
+
+SOURCES += main.cpp \
+    ../../3rdparty/fc8-compression.c \
+    ../../fc8compressor.cpp \
+    ../../fc8decoder.cpp \
+    ../../fc8optimalencoder.cpp
+
+HEADERS += ../../bigendian.h \
+    ../../fc8compressor.h \
+    ../../fc8decoder.h \
+    ../../fc8optimalencoder.h \
+    ../../fc8tokens.h
@@ -0,0 +1,120 @@
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QStringList>
+#include <stdio.h>
+#include "fc8compressor.h"
+#include "fc8decoder.h"
+
+// Same block size the ROM creator uses
+#define BLOCK_SIZE          65536
+
+// The machines these ROMs go in, slowest first
+static const FC8Decoder::CycleModel *cycleModels[] = {
+    &FC8Decoder::mc68020_16MHz,
+    &FC8Decoder::mc68030_16MHz,
+    &FC8Decoder::mc68030_25MHz
+};
+#define NUM_CYCLE_MODELS    (sizeof(cycleModels) / sizeof(cycleModels[0]))
+
+struct Result
+{
+    int compressedSize;
+    qint64 elapsedMs;
+    int reusedBlocks;
+    bool roundTripOK;
+    double blockDecodeMs[NUM_CYCLE_MODELS];
+};
+
+static Result runMode(QByteArray const &image, FC8Compressor::Mode mode)
+{
+    FC8Compressor compressor(image, BLOCK_SIZE, mode);
+    QElapsedTimer timer;
+    timer.start();
+
+    Result result;
+    const QByteArray compressed = compressor.compress();
+    result.compressedSize = compressed.length();
+    result.elapsedMs = timer.elapsed();
+    result.reusedBlocks = compressor.reusedBlockCount();
+
+    // Check the output with the host decoder, and see what the ROM would
+    // have to do to decompress it
+    QList<FC8Decoder::BlockStats> stats;
+    result.roundTripOK = FC8Decoder::roundTrip(compressed, image, &stats);
+    for (size_t m = 0; m < NUM_CYCLE_MODELS; m++)
+    {
+        result.blockDecodeMs[m] = 0;
+        foreach (FC8Decoder::BlockStats const &s, stats)
+        {
+            result.blockDecodeMs[m] += FC8Decoder::estimateMicroseconds(s, *cycleModels[m]) / 1000.0;
+        }
+        if (!stats.isEmpty())
+        {
+            result.blockDecodeMs[m] /= stats.count();
+        }
+    }
+    return result;
+}
+
+static void printResult(const char *name, int originalSize, Result const &r)
+{
+    const double ratio = r.compressedSize ? static_cast<double>(originalSize) / r.compressedSize : 0.0;
+    const double mbPerSec = r.elapsedMs ? (originalSize / 1048576.0) / (r.elapsedMs / 1000.0) : 0.0;
+    printf("  %-10s %10d bytes  ratio %5.2f  %7lld ms  %7.2f MB/s  %d repeated blocks\n",
+           name, r.compressedSize, ratio, static_cast<long long>(r.elapsedMs), mbPerSec, r.reusedBlocks);
+    printf("  %-10s round trip %s\n", "", r.roundTripOK ? "OK" : "FAILED");
+    for (size_t m = 0; m < NUM_CYCLE_MODELS; m++)
+    {
+        printf("  %-10s about %.1f ms per block on a %s\n", "", r.blockDecodeMs[m], cycleModels[m]->name);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QStringList files = app.arguments().mid(1);
+    if (files.isEmpty())
+    {
+        fprintf(stderr, "usage: fc8bench image1.dsk [image2.dsk ...]\n");
+        return 1;
+    }
+
+    qint64 totalFast = 0;
+    qint64 totalHigh = 0;
+    foreach (QString const &fileName, files)
+    {
+        QFile f(fileName);
+        if (!f.open(QFile::ReadOnly))
+        {
+            fprintf(stderr, "%s: can't open\n", qPrintable(fileName));
+            continue;
+        }
+        QByteArray image = f.readAll();
+        f.close();
+
+        printf("%s (%d bytes)\n", qPrintable(QFileInfo(fileName).fileName()), image.length());
+        Result fast = runMode(image, FC8Compressor::FastMode);
+        Result high = runMode(image, FC8Compressor::HighRatioMode);
+        printResult("fast", image.length(), fast);
+        printResult("high", image.length(), high);
+        if (fast.compressedSize > 0)
+        {
+            printf("  high ratio saves %d bytes (%.1f%%)\n",
+                   fast.compressedSize - high.compressedSize,
+                   100.0 * (fast.compressedSize - high.compressedSize) / fast.compressedSize);
+        }
+
+        totalFast += fast.compressedSize;
+        totalHigh += high.compressedSize;
+    }
+
+    if (files.count() > 1)
+    {
+        printf("total: fast %lld bytes, high %lld bytes\n",
+               static_cast<long long>(totalFast), static_cast<long long>(totalHigh));
+    }
+
+    return 0;
+}
@@ -0,0 +1,208 @@
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QThread>
+#include <QTimer>
+#include <QVector>
+#include <algorithm>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <unistd.h>
+#include "qextserialtransport.h"
+#include "linuxserialtransport.h"
+
+// What the emulated board understands
+#define PING_REQUEST        0x01
+#define CHUNK_REQUEST       0x02
+#define CHUNK_SIZE          1024
+
+#define PING_COUNT          2000
+#define CHUNK_COUNT         1024
+
+// Sits on the master side of a pty and answers like a (very simple)
+// programmer board: a one byte reply to a ping, and a 1 KB chunk of data
+// when asked for one, just like a SIMM read.
+class BoardEmulator : public QThread
+{
+public:
+    explicit BoardEmulator(int masterFD) : masterFD(masterFD), stopRequested(0) {}
+    void stop() { stopRequested = 1; }
+
+protected:
+    void run()
+    {
+        QByteArray chunk(CHUNK_SIZE, 0x5A);
+        while (!stopRequested)
+        {
+            struct pollfd pfd;
+            pfd.fd = masterFD;
+            pfd.events = POLLIN;
+            pfd.revents = 0;
+            if (poll(&pfd, 1, 100) <= 0)
+            {
+                continue;
+            }
+
+            char request[256];
+            const ssize_t len = ::read(masterFD, request, sizeof(request));
+            for (ssize_t i = 0; i < len; i++)
+            {
+                if (request[i] == PING_REQUEST)
+                {
+                    writeAll(request + i, 1);
+                }
+                else if (request[i] == CHUNK_REQUEST)
+                {
+                    writeAll(chunk.constData(), chunk.size());
+                }
+            }
+        }
+    }
+
+private:
+    void writeAll(const char *data, int len)
+    {
+        while (len > 0)
+        {
+            const ssize_t result = ::write(masterFD, data, len);
+            if (result > 0)
+            {
+                data += result;
+                len -= result;
+            }
+            else if (result < 0 && errno != EINTR && errno != EAGAIN)
+            {
+                return;
+            }
+        }
+    }
+
+    int masterFD;
+    volatile int stopRequested;
+};
+
+// Waits (while running the event loop, like the real program does) until
+// at least len bytes have been read from the transport
+static bool receive(ProgrammerTransport *transport, int len)
+{
+    QEventLoop loop;
+    QTimer timeout;
+    timeout.setSingleShot(true);
+    QObject::connect(transport, SIGNAL(readyRead()), &loop, SLOT(quit()));
+    QObject::connect(&timeout, SIGNAL(timeout()), &loop, SLOT(quit()));
+    timeout.start(5000);
+
+    char buf[CHUNK_SIZE];
+    while (len > 0)
+    {
+        if (transport->atEnd())
+        {
+            loop.exec();
+            if (!timeout.isActive())
+            {
+                return false;
+            }
+        }
+        const qint64 got = transport->read(buf, qMin(len, CHUNK_SIZE));
+        if (got > 0)
+        {
+            len -= got;
+        }
+    }
+    return true;
+}
+
+static void benchmark(const char *name, ProgrammerTransport *transport, QString const &slaveName)
+{
+    transport->setPortName(slaveName);
+    if (!transport->open())
+    {
+        printf("%-16s unable to open %s\n", name, qPrintable(slaveName));
+        return;
+    }
+
+    // Round trip latency: one byte out, one byte back, like most of the
+    // command/reply exchanges with the board
+    QVector<qint64> latencies;
+    latencies.reserve(PING_COUNT);
+    QElapsedTimer timer;
+    const char ping = PING_REQUEST;
+    for (int i = 0; i < PING_COUNT; i++)
+    {
+        timer.start();
+        transport->write(&ping, 1);
+        if (!receive(transport, 1))
+        {
+            printf("%-16s timed out waiting for ping reply\n", name);
+            transport->close();
+            return;
+        }
+        latencies.append(timer.nsecsElapsed());
+    }
+    std::sort(latencies.begin(), latencies.end());
+    qint64 total = 0;
+    foreach (qint64 l, latencies)
+    {
+        total += l;
+    }
+
+    // Throughput: request a chunk at a time, the same way a SIMM read does
+    const char chunkRequest = CHUNK_REQUEST;
+    timer.start();
+    for (int i = 0; i < CHUNK_COUNT; i++)
+    {
+        transport->write(&chunkRequest, 1);
+        if (!receive(transport, CHUNK_SIZE))
+        {
+            printf("%-16s timed out waiting for chunk\n", name);
+            transport->close();
+            return;
+        }
+    }
+    const double seconds = timer.nsecsElapsed() / 1e9;
+
+    printf("%-16s latency mean %7.1f us  median %7.1f us  p99 %7.1f us   throughput %7.2f MB/s\n",
+           name,
+           total / 1000.0 / latencies.size(),
+           latencies.at(latencies.size() / 2) / 1000.0,
+           latencies.at(latencies.size() * 99 / 100) / 1000.0,
+           (double)CHUNK_COUNT * CHUNK_SIZE / 1048576.0 / seconds);
+
+    transport->close();
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+
+    const int masterFD = posix_openpt(O_RDWR | O_NOCTTY);
+    if (masterFD < 0 || grantpt(masterFD) != 0 || unlockpt(masterFD) != 0)
+    {
+        perror("Unable to create pty");
+        return 1;
+    }
+
+    // The board side doesn't do any tty processing either
+    struct termios tio;
+    tcgetattr(masterFD, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(masterFD, TCSANOW, &tio);
+
+    const QString slaveName = QString::fromLocal8Bit(ptsname(masterFD));
+    BoardEmulator emulator(masterFD);
+    emulator.start();
+
+    QextSerialTransport qext;
+    benchmark("qextserialport", &qext, slaveName);
+    LinuxSerialTransport native;
+    benchmark("native", &native, slaveName);
+
+    emulator.stop();
+    emulator.wait();
+    ::close(masterFD);
+    return 0;
+}
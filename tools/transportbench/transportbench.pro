@@ -0,0 +1,25 @@
+# Compares round-trip latency and throughput of the programmer transports,
+# using a pseudo-terminal that pretends to be the programmer board.
+# Linux only, since that's where there's more than one transport.
+
+QT       += core
+QT       -= gui
+
+TARGET = transportbench
+CONFIG += console
+CONFIG -= app_bundle
+TEMPLATE = app
+
+INCLUDEPATH += ../..
+
+SOURCES += main.cpp \
+    ../../programmertransport.cpp \
+    ../../qextserialtransport.cpp \
+    ../../linuxserialtransport.cpp
+
+HEADERS += ../../programmertransport.h \
+    ../../qextserialtransport.h \
+    ../../linuxserialtransport.h
+
+CONFIG += qesp_linux_udev
+include(../../3rdparty/qextserialport/src/qextserialport.pri)
@@ -0,0 +1,116 @@
+#include "writejournal.h"
+#include "appdatapath.h"
+#include <QCryptographicHash>
+#include <QFile>
+#include <QSettings>
+
+#define JOURNAL_FILE_NAME       "writejournal.ini"
+
+#define sourcePathKey           "sourcePath"
+#define imageHashKey            "imageHash"
+#define simmCapacityKey         "simmCapacity"
+#define simmChipKey             "simmChip"
+#define chipMaskKey             "chipMask"
+#define checkpointOffsetKey     "checkpointOffset"
+
+WriteJournal::WriteJournal() :
+    _active(false),
+    _simmCapacity(0),
+    _simmChip(0),
+    _chipMask(0x0F),
+    _checkpointOffset(0)
+{
+}
+
+bool WriteJournal::load()
+{
+    _active = false;
+    if (!QFile::exists(appDataFilePath(JOURNAL_FILE_NAME)))
+    {
+        return false;
+    }
+
+    QSettings journal(appDataFilePath(JOURNAL_FILE_NAME), QSettings::IniFormat);
+    _sourcePath = journal.value(sourcePathKey).toString();
+    _imageHash = QByteArray::fromHex(journal.value(imageHashKey).toByteArray());
+    _simmCapacity = journal.value(simmCapacityKey, 0).toUInt();
+    _simmChip = journal.value(simmChipKey, 0).toUInt();
+    _chipMask = static_cast<uint8_t>(journal.value(chipMaskKey, 0x0F).toUInt());
+    _checkpointOffset = journal.value(checkpointOffsetKey, 0).toUInt();
+
+    _active = !_sourcePath.isEmpty() && !_imageHash.isEmpty() && _simmCapacity > 0;
+    return _active;
+}
+
+void WriteJournal::begin(QString const &sourcePath, QByteArray const &imageHash,
+                         uint32_t simmCapacity, uint32_t simmChip, uint8_t chipMask)
+{
+    _active = true;
+    _sourcePath = sourcePath;
+    _imageHash = imageHash;
+    _simmCapacity = simmCapacity;
+    _simmChip = simmChip;
+    _chipMask = chipMask;
+    _checkpointOffset = 0;
+    save();
+}
+
+void WriteJournal::checkpoint(uint32_t offset)
+{
+    if (!_active)
+    {
+        return;
+    }
+
+    _checkpointOffset = offset;
+    QSettings journal(appDataFilePath(JOURNAL_FILE_NAME), QSettings::IniFormat);
+    journal.setValue(checkpointOffsetKey, _checkpointOffset);
+
+    // The whole point is surviving the programmer (or us) going away, so
+    // don't leave this sitting around in memory
+    journal.sync();
+}
+
+void WriteJournal::clear()
+{
+    _active = false;
+    _checkpointOffset = 0;
+    QFile::remove(appDataFilePath(JOURNAL_FILE_NAME));
+}
+
+QByteArray WriteJournal::hashDevice(QIODevice *device)
+{
+    // Preserve Qt 4 compatibility, just in case...
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 0, 0))
+    QCryptographicHash hash(QCryptographicHash::Sha256);
+#else
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+#endif
+
+    const qint64 originalPos = device->pos();
+    device->seek(0);
+    while (!device->atEnd())
+    {
+        const QByteArray block = device->read(64 * 1024);
+        if (block.isEmpty())
+        {
+            break;
+        }
+        hash.addData(block);
+    }
+    device->seek(originalPos);
+
+    return hash.result();
+}
+
+void WriteJournal::save()
+{
+    QSettings journal(appDataFilePath(JOURNAL_FILE_NAME), QSettings::IniFormat);
+    journal.setValue(sourcePathKey, _sourcePath);
+    journal.setValue(imageHashKey, _imageHash.toHex());
+    journal.setValue(simmCapacityKey, _simmCapacity);
+    journal.setValue(simmChipKey, _simmChip);
+    journal.setValue(chipMaskKey, _chipMask);
+    journal.setValue(checkpointOffsetKey, _checkpointOffset);
+    journal.sync();
+}
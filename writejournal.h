@@ -0,0 +1,45 @@
+#ifndef WRITEJOURNAL_H
+#define WRITEJOURNAL_H
+
+#include <QByteArray>
+#include <QIODevice>
+#include <QString>
+#include <stdint.h>
+
+// Keeps track of how far a write to the SIMM has gotten in a file on disk,
+// so if the programmer gets unplugged partway through, the write can be
+// picked back up where it left off instead of starting over.
+class WriteJournal
+{
+public:
+    WriteJournal();
+
+    bool load();
+    void begin(QString const &sourcePath, QByteArray const &imageHash,
+               uint32_t simmCapacity, uint32_t simmChip, uint8_t chipMask);
+    void checkpoint(uint32_t offset);
+    void clear();
+
+    bool isActive() const { return _active; }
+    QString const &sourcePath() const { return _sourcePath; }
+    QByteArray const &imageHash() const { return _imageHash; }
+    uint32_t simmCapacity() const { return _simmCapacity; }
+    uint32_t simmChip() const { return _simmChip; }
+    uint8_t chipMask() const { return _chipMask; }
+    uint32_t checkpointOffset() const { return _checkpointOffset; }
+
+    static QByteArray hashDevice(QIODevice *device);
+
+private:
+    void save();
+
+    bool _active;
+    QString _sourcePath;
+    QByteArray _imageHash;
+    uint32_t _simmCapacity;
+    uint32_t _simmChip;
+    uint8_t _chipMask;
+    uint32_t _checkpointOffset;
+};
+
+#endif // WRITEJOURNAL_H